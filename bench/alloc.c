@@ -0,0 +1,90 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+
+// The operations that are benchmarked.
+typedef enum {
+  OP_INSERT,
+  OP_DELETE,
+  OP_SPLIT,
+} Op;
+
+static const char *op_names[] = {"insert", "delete", "split"};
+
+// runs one operation at random indices, keeping the previous version of the
+// rope alive as a snapshot if shared is true
+static RopeNode *run(RopeNode *root, int *length, Op op, bool shared, int ops)
+{
+  RopeNode *snapshot = NULL;
+  PoolStats before = pool_stats();
+  uint64_t t = bench_now();
+  for (int i = 0; i < ops; i++) {
+    int idx = rand() % *length;
+    RopeNode *next = NULL;
+    if (op == OP_INSERT) {
+      next = rope_insert(root, 'x', idx - 1);
+      (*length)++;
+    } else if (op == OP_DELETE) {
+      next = rope_delete(root, idx);
+      (*length)--;
+    } else {
+      rope_arr_free(rope_split(root, idx), 2);
+      continue;
+    }
+    if (next == NULL) {
+      fprintf(stderr, "%s failed at %d\n", op_names[op], i);
+      exit(1);
+    }
+    if (shared) {
+      rope_deref(snapshot);
+      snapshot = root;
+    } else {
+      rope_deref(root);
+    }
+    root = next;
+  }
+  t = bench_now() - t;
+  PoolStats after = pool_stats();
+  rope_deref(snapshot);
+  printf("%-6s %-6s %.1fns/op allocs/op=%.2f mallocs/op=%.4f\n", op_names[op],
+         shared ? "shared" : "owned", (double)t / ops,
+         (double)(after.allocs - before.allocs) / ops,
+         (double)(after.mallocs - before.mallocs) / ops);
+  return root;
+}
+
+/*
+ * Runs random inserts, deletes and splits against a rope, and reports the
+ * time taken and the number of allocations made per operation. Allocations
+ * count every node and leaf handed out by the pool, while mallocs count only
+ * the ones that reach the system allocator. Each operation is run once on a
+ * rope that is only referenced by the benchmark, and once while the previous
+ * version is kept as a snapshot, like the history of a buffer.
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 1000000;
+  int ops = argc > 2 ? atoi(argv[2]) : 1000000;
+  srand(1);
+
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) text[i] = 'a' + i % 26;
+  RopeNode *root = rope_build(text, length);
+  free(text);
+
+  for (int shared = 0; shared <= 1; shared++) {
+    for (Op op = OP_INSERT; op <= OP_SPLIT; op++) {
+      root = run(root, &length, op, shared, ops);
+    }
+  }
+
+  rope_deref(root);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+/*
+ * Types characters into a single line one codepoint at a time, the same way
+ * buffer_insert() does, and reports the height of the final rope along with
+ * the average and worst latency of each edit. The "append" workload types at
+ * the end of the line, while the "middle" workload types at a cursor that
+ * starts in the middle of an existing line.
+ */
+static RopeNode *type_line(RopeNode *root, int count, int start, const char *name)
+{
+  uint64_t total = 0, worst = 0;
+  for (int i = 0; i < count; i++) {
+    uint64_t t = bench_now();
+    RopeNode *next = rope_insert(root, 'a' + i % 26, start + i);
+    t = bench_now() - t;
+    if (next == NULL) {
+      fprintf(stderr, "rope_insert failed at %d\n", i);
+      exit(1);
+    }
+    rope_deref(root);
+    root = next;
+    total += t;
+    if (t > worst) worst = t;
+  }
+
+  // sample indexing throughout the final rope
+  int length = rope_length(root);
+  uint64_t t = bench_now();
+  uint32_t sum = 0;
+  for (int i = 0; i < 100000; i++) {
+    sum += rope_index(root, (int)((uint64_t)i * 7919 % length)).c;
+  }
+  t = bench_now() - t;
+
+  printf("%-6s edits=%d height=%d avg=%.1fns worst=%.1fus index=%.1fns (%u)\n",
+         name, count, rope_height(root, 0), (double)total / count,
+         worst / 1000.0, t / 100000.0, sum % 10);
+  return root;
+}
+
+int main(int argc, char **argv)
+{
+  int count = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  // type at the end of an empty line
+  RopeNode *root = rope_build(NULL, 0);
+  root = type_line(root, count, -1, "append");
+  rope_deref(root);
+
+  // type in the middle of a line that already holds count characters
+  uint32_t *text = malloc(count * sizeof(uint32_t));
+  for (int i = 0; i < count; i++) text[i] = 'a' + i % 26;
+  root = rope_build(text, count);
+  root = type_line(root, count, count / 2 - 1, "middle");
+  rope_deref(root);
+  free(text);
+  return 0;
+}
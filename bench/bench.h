@@ -0,0 +1,70 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// The rope layout and leaf storage that the benchmark was built for, which
+// starts every line of results.
+#ifdef ROPE_BTREE
+#define LAYOUT "btree"
+#elif defined(ROPE_UTF8)
+#define LAYOUT "utf8"
+#else
+#define LAYOUT "utf32"
+#endif
+
+/**
+ * bench_now() - Returns a monotonic timestamp in nanoseconds.
+ *
+ * This function is used by the benchmark programs to time individual
+ * operations as well as whole workloads.
+ */
+static inline uint64_t bench_now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * bench_rss() - Returns the resident set size of the process in mebibytes.
+ *
+ * This function reads /proc/self/statm, so it returns 0 on systems without
+ * it. It is used by the benchmarks that measure memory outside of the pool,
+ * such as mapped files and the history of a buffer.
+ */
+static inline double bench_rss(void)
+{
+  long pages = 0;
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (file != NULL) {
+    if (fscanf(file, "%*s %ld", &pages) != 1) pages = 0;
+    fclose(file);
+  }
+  return pages * (double)sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+/**
+ * check() - Fails the benchmark if a condition does not hold.
+ *
+ * @ok: Whether the operation succeeded or its result was right.
+ * @what: The name of the operation, which is printed if it failed.
+ *
+ * This function exits the benchmark after printing the name of the operation
+ * if the condition does not hold, so that a broken edit or a wrong result is
+ * not timed as if it were right.
+ */
+static inline void check(bool ok, const char *what)
+{
+  if (!ok) {
+    fprintf(stderr, "%s failed\n", what);
+    exit(1);
+  }
+}
+
+#endif // BENCH_H
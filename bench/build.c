@@ -0,0 +1,53 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL_cpuinfo.h>
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+/*
+ * Builds ropes from 100MB and 2GB of text, counted as four bytes per
+ * codepoint, with rope_build_threads() on one thread, four threads and one
+ * thread per logical CPU core. Sizes in megabytes can be given instead. Each
+ * large rope is allocated in runs that are returned to the system when it is
+ * freed, so every build faults in fresh memory, as opening a file would.
+ */
+int main(int argc, char **argv)
+{
+  int sizes[8] = {100, 2048};
+  int count = 2;
+  if (argc > 1) {
+    count = argc - 1 < 8 ? argc - 1 : 8;
+    for (int i = 0; i < count; i++) sizes[i] = atoi(argv[i + 1]);
+  }
+  int cores = SDL_GetNumLogicalCPUCores();
+  int threads[] = {1, 4, cores};
+
+  for (int i = 0; i < count; i++) {
+    int length = (int)((int64_t)sizes[i] * 1024 * 1024 / sizeof(uint32_t));
+    uint32_t *text = malloc(length * sizeof(uint32_t));
+    if (text == NULL) {
+      printf("%-6s %dMB does not fit in memory\n", LAYOUT, sizes[i]);
+      continue;
+    }
+    for (int j = 0; j < length; j++) text[j] = 'a' + j % 26;
+
+    for (int j = 0; j < 3; j++) {
+      uint64_t t = bench_now();
+      RopeNode *root = rope_build_threads(text, length, threads[j]);
+      t = bench_now() - t;
+      if (root == NULL) {
+        printf("%-6s %dMB threads=%d failed\n", LAYOUT, sizes[i], threads[j]);
+        continue;
+      }
+      printf("%-6s %dMB threads=%d%s %.1fms\n", LAYOUT, sizes[i], threads[j],
+             j == 2 ? " (all)" : "", t / 1e6);
+      rope_deref(root);
+    }
+    free(text);
+  }
+  return 0;
+}
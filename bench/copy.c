@@ -0,0 +1,70 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include <SDL3/SDL_stdinc.h>
+#include "bench.h"
+#include "rope.h"
+
+/*
+ * Copies windows of text out of random positions in a large document with
+ * rope_copy_out() and with one rope_index() per character, and saves the whole
+ * document as UTF-8 with rope_copy_out_utf8() and with rope_text() followed by
+ * encoding each codepoint.
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 50 * 1024 * 1024;
+  int window = argc > 2 ? atoi(argv[2]) : 100 * 80;
+  int copies = 1000;
+
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) text[i] = i % 64 == 63 ? 0x3b1 : 'a' + i % 26;
+  RopeNode *root = rope_build(text, length);
+  free(text);
+
+  uint32_t *dst = malloc(window * sizeof(uint32_t));
+  int *starts = malloc(copies * sizeof(int));
+  srand(1);
+  for (int i = 0; i < copies; i++) starts[i] = rand() % (length - window);
+
+  uint64_t t = bench_now();
+  for (int i = 0; i < copies; i++) rope_copy_out(root, starts[i], window, dst);
+  uint64_t t_copy = bench_now() - t;
+  t = bench_now();
+  for (int i = 0; i < copies; i++) {
+    for (int j = 0; j < window; j++) dst[j] = rope_index(root, starts[i] + j).c;
+  }
+  uint64_t t_index = bench_now() - t;
+  printf("%-6s window=%d rope_copy_out=%.2fus rope_index=%.2fus\n", LAYOUT, window,
+         t_copy / 1e3 / copies, t_index / 1e3 / copies);
+
+  // save through a fixed buffer, as a file would be written
+  int block = 64 * 1024;
+  char *out = malloc(4 * block);
+  uint64_t bytes = 0;
+  t = bench_now();
+  for (int start = 0; start < length; start += block) {
+    int len = length - start < block ? length - start : block;
+    bytes += rope_copy_out_utf8(root, start, len, out);
+  }
+  uint64_t t_utf8 = bench_now() - t;
+  t = bench_now();
+  uint32_t *all = rope_text(root);
+  char *encoded = malloc(4 * (size_t)length);
+  char *end = encoded;
+  for (int i = 0; i < length; i++) end = SDL_UCS4ToUTF8(all[i], end);
+  uint64_t t_text = bench_now() - t;
+  printf("%-6s save %.0fMB rope_copy_out_utf8=%.1fms rope_text+encode=%.1fms\n", LAYOUT,
+         bytes / 1e6, t_utf8 / 1e6, t_text / 1e6);
+
+  arrfree(all);
+  free(encoded);
+  free(out);
+  free(starts);
+  free(dst);
+  rope_deref(root);
+  return 0;
+}
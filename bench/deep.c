@@ -0,0 +1,90 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+
+// reports the time taken since the given timestamp
+static void report(const char *name, uint64_t start)
+{
+  printf("%-8s %10.3fms\n", name, (bench_now() - start) / 1e6);
+}
+
+/*
+ * Builds a pathologically deep rope by stacking single codepoint leaves with
+ * rope_set() into a left-leaning chain, the shape that typing at the end of a
+ * line used to produce before ropes were balanced. It then runs every rope
+ * operation on it, which must finish without overflowing the C stack, and
+ * reports how long each one took.
+ */
+int main(int argc, char **argv)
+{
+  int depth = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  // stack the leaves into a chain
+  uint64_t t = bench_now();
+  RopeNode *root = NULL;
+  for (int i = 0; i < depth; i++) {
+    uint32_t c = 'a' + i % 26;
+    RopeNode *leaf = rope_build(&c, 1);
+    if (root == NULL) {
+      root = leaf;
+      continue;
+    }
+    RopeNode *node = pool_alloc(sizeof(RopeNode));
+    if (leaf == NULL || node == NULL) {
+      fprintf(stderr, "failed to build the chain at %d\n", i);
+      return 1;
+    }
+    rope_set(node, rope_length(root), 1, NULL, root, leaf);
+    rope_deref(root);
+    rope_deref(leaf);
+    root = node;
+  }
+  report("build", t);
+  printf("height=%d\n", rope_height(root, 0));
+
+  t = bench_now();
+  int length = rope_length(root);
+  report("length", t);
+
+  t = bench_now();
+  uint32_t c = rope_index(root, 0).c;
+  report("index", t);
+
+  t = bench_now();
+  uint32_t *text = rope_text(root);
+  report("text", t);
+
+  t = bench_now();
+  RopeNode **halves = rope_split(root, length / 2);
+  report("split", t);
+
+  t = bench_now();
+  RopeNode *joined = rope_concat(halves[1], halves[0]);
+  report("concat", t);
+
+  t = bench_now();
+  RopeNode *inserted = rope_insert(root, c, -1);
+  report("insert", t);
+
+  t = bench_now();
+  RopeNode *deleted = rope_delete(root, 0);
+  report("delete", t);
+
+  t = bench_now();
+  rope_deref(root);
+  rope_deref(inserted);
+  rope_deref(deleted);
+  rope_deref(joined);
+  rope_arr_free(halves, 2);
+  report("deref", t);
+
+  printf("length=%d text=%d\n", length, (int)arrlen(text));
+  arrfree(text);
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+// finds where two texts differ by copying both out of their ropes and
+// comparing them from either end, as re-rendering did without rope_diff()
+static long flat_diff(RopeNode *old_root, RopeNode *new_root)
+{
+  uint32_t *a = rope_text(old_root);
+  uint32_t *b = rope_text(new_root);
+  long n = arrlen(a);
+  long m = arrlen(b);
+  long head = 0;
+  while (head < n && head < m && a[head] == b[head]) head++;
+  long tail = 0;
+  while (tail < n - head && tail < m - head && a[n - 1 - tail] == b[m - 1 - tail]) tail++;
+  arrfree(a);
+  arrfree(b);
+  return n - head - tail;
+}
+
+// checks that applying the changes to the old text gives the new text
+static void verify(RopeNode *old_root, RopeNode *new_root, RopeChange *changes)
+{
+  uint32_t *a = rope_text(old_root);
+  uint32_t *b = rope_text(new_root);
+  uint32_t *patched = NULL;
+  int at = 0;
+  for (int i = 0; i < arrlen(changes); i++) {
+    RopeChange c = changes[i];
+    check(c.old_start >= at && c.old_start - at == c.new_start - (int)arrlen(patched), "order");
+    for (; at < c.old_start; at++) arrput(patched, a[at]);
+    for (int j = 0; j < c.new_len; j++) arrput(patched, b[c.new_start + j]);
+    at += c.old_len;
+  }
+  for (; at < arrlen(a); at++) arrput(patched, a[at]);
+  check(arrlen(patched) == arrlen(b) &&
+            memcmp(patched, b, arrlen(b) * sizeof(uint32_t)) == 0,
+        "diff");
+  arrfree(a);
+  arrfree(b);
+  arrfree(patched);
+}
+
+/*
+ * Builds a document of the given number of mebi-codepoints, makes a growing
+ * number of scattered edits to a new version of it while keeping the old one,
+ * and compares finding the changed ranges with rope_diff() against copying
+ * both versions out and comparing their text.
+ */
+int main(int argc, char **argv)
+{
+  int length = (argc > 1 ? atoi(argv[1]) : 64) * 1024 * 1024;
+  int runs = 100;
+
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) text[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+  RopeNode *root = rope_build(text, length);
+  check(root != NULL, "build");
+  free(text);
+
+  uint32_t typed[12];
+  for (int i = 0; i < 12; i++) typed[i] = 'A' + i;
+  srand(1);
+  for (int edits = 1; edits <= 1024; edits *= 8) {
+    // replace a few characters at scattered places, as typing would
+    RopeNode *version = root;
+    rope_ref(version);
+    for (int i = 0; i < edits; i++) {
+      int at = rand() % (rope_length(version) - 8);
+      RopeNode *next = rope_delete_range(version, at, 8);
+      check(next != NULL, "delete");
+      rope_deref(version);
+      version = rope_insert_text(next, typed, 12, at - 1);
+      check(version != NULL, "insert");
+      rope_deref(next);
+    }
+
+    RopeChange *changes = NULL;
+    uint64_t t = bench_now();
+    for (int i = 0; i < runs; i++) {
+      arrfree(changes);
+      rope_diff(root, version, &changes);
+    }
+    uint64_t t_diff = (bench_now() - t) / runs;
+    verify(root, version, changes);
+
+    t = bench_now();
+    long changed = flat_diff(root, version);
+    uint64_t t_flat = bench_now() - t;
+
+    printf("%-6s edits=%-5d changes=%-5d diff=%9.1fus flatten+compare=%8.1fms (%ld)\n", LAYOUT,
+           edits, (int)arrlen(changes), t_diff / 1e3, t_flat / 1e6, changed);
+    arrfree(changes);
+    rope_deref(version);
+  }
+
+  rope_deref(root);
+  rope_reclaim(0);
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+// the number of codepoints built into the rope at a time
+#define CHUNK (16 * 1024 * 1024)
+
+static const char *names[] = {"scalar", "sse2", "avx2"};
+
+// reports how fast a search went over the given number of codepoints, counting
+// the text as UTF-8 the way a file of it would be on disk
+static void report(const char *search, const char *kernel, long bytes, uint64_t t, long found)
+{
+  double ns = (double)(bench_now() - t);
+  printf("%-6s %-14s %-6s %6.2f GB/s %7.1fms (%ld)\n", LAYOUT, search, kernel, bytes / ns,
+         ns / 1e6, found);
+}
+
+// finds the needle after the start by copying the text out of the rope and comparing it at
+// every position where its first codepoint is, as searching did without ropes
+static long naive_find(RopeNode *root, const uint32_t *needle, int len)
+{
+  uint32_t *text = rope_text(root);
+  long length = arrlen(text);
+  long found = -1;
+  for (long i = 1; i + len <= length; i++) {
+    if (text[i] == needle[0] && memcmp(text + i, needle, len * sizeof(uint32_t)) == 0) {
+      found = i;
+      break;
+    }
+  }
+  arrfree(text);
+  return found;
+}
+
+/*
+ * Builds a document of the given number of mebi-codepoints out of lines of
+ * source code, with a rare identifier only at its start and end, and searches
+ * it for that identifier forwards and backwards, for every occurrence of a
+ * common one, and with the text copied out of the rope for comparison.
+ * Throughput is measured against the size of the document as UTF-8.
+ */
+int main(int argc, char **argv)
+{
+  long length = (argc > 1 ? atol(argv[1]) : 256) << 20;
+
+  static const char code[] = "  for (int i = 0; i < count; i++) total += values[i];\n";
+  static const char rare[] = "needle_in_a_haystack";
+  uint32_t needle[sizeof(rare) - 1];
+  for (size_t i = 0; i < sizeof(rare) - 1; i++) needle[i] = (unsigned char)rare[i];
+  int len = sizeof(rare) - 1;
+  uint32_t common[] = {'v', 'a', 'l', 'u', 'e', 's'};
+
+  uint32_t *text = malloc(CHUNK * sizeof(uint32_t));
+  for (int i = 0; i < CHUNK; i++) text[i] = (unsigned char)code[i % (sizeof(code) - 1)];
+  memcpy(text, needle, sizeof(needle));
+  RopeNode *root = NULL;
+  uint64_t t = bench_now();
+  for (long built = 0; built < length; built += CHUNK) {
+    int chunk = length - built < CHUNK ? length - built : CHUNK;
+    if (built + chunk >= length) memcpy(text + chunk - len, needle, sizeof(needle));
+    RopeNode *next = root == NULL ? rope_build(text, chunk)
+                                  : rope_insert_text(root, text, chunk, rope_length(root) - 1);
+    check(next != NULL, "build");
+    rope_deref(root);
+    root = next;
+    for (int i = 0; i < len; i++) text[i] = (unsigned char)code[i % (sizeof(code) - 1)];
+  }
+  free(text);
+  long bytes = rope_summary(root).bytes;
+  int last = rope_length(root) - len;
+  printf("%-6s build %ldMB %.0fms\n", LAYOUT, bytes >> 20, (bench_now() - t) / 1e6);
+
+  RopeKernels widest = rope_kernels(ROPE_KERNELS_AVX2);
+  for (RopeKernels level = ROPE_KERNELS_SCALAR; level <= widest; level++) {
+    rope_kernels(level);
+
+    t = bench_now();
+    int found = rope_find(root, needle, len, 1);
+    report("find", names[level], bytes, t, found);
+    check(found == last, "find");
+
+    t = bench_now();
+    found = rope_rfind(root, needle, len, last - 1);
+    report("rfind", names[level], bytes, t, found);
+    check(found == 0, "rfind");
+
+    int *matches = NULL;
+    t = bench_now();
+    found = rope_find_all(root, common, 6, &matches);
+    report("find_all", names[level], bytes, t, found);
+    check(found > 0, "find_all");
+    arrfree(matches);
+  }
+  rope_kernels(ROPE_KERNELS_AVX2);
+
+  t = bench_now();
+  long found = naive_find(root, needle, len);
+  report("flatten+naive", "scalar", bytes, t, found);
+
+  rope_deref(root);
+  rope_reclaim(0);
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+// types characters one after another at the cursor, followed by as many
+// backspaces, either descending from the root or using a finger for each edit
+static RopeNode *run(RopeNode *root, int cursor, int ops, bool finger)
+{
+  RopeFinger f = {0};
+  uint64_t t = bench_now();
+  for (int i = 0; i < ops; i++) {
+    RopeNode *next = finger ? rope_finger_insert(&f, root, 'x', cursor + i - 1)
+                            : rope_insert(root, 'x', cursor + i - 1);
+    rope_deref(root);
+    root = next;
+  }
+  uint64_t insert = bench_now() - t;
+
+  t = bench_now();
+  for (int i = ops - 1; i >= 0; i--) {
+    RopeNode *next = finger ? rope_finger_delete(&f, root, cursor + i)
+                            : rope_delete(root, cursor + i);
+    rope_deref(root);
+    root = next;
+  }
+  rope_finger_flush(&f);
+  uint64_t delete = bench_now() - t;
+
+  printf("%-6s %-6s insert=%.1fns/op delete=%.1fns/op\n", LAYOUT,
+         finger ? "finger" : "root", (double)insert / ops, (double)delete / ops);
+  return root;
+}
+
+/*
+ * Types N characters in the middle of a large document and then deletes them
+ * again with backspace, comparing edits that descend from the root of the rope
+ * with edits made through a RopeFinger.
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 50 * 1024 * 1024;
+  int ops = argc > 2 ? atoi(argv[2]) : 100000;
+
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) text[i] = 'a' + i % 26;
+  RopeNode *root = rope_build(text, length);
+  free(text);
+
+  root = run(root, length / 2, ops, false);
+  root = run(root, length / 2, ops, true);
+  rope_deref(root);
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+
+// Determines how long rope_reclaim() may spend freeing nodes in each frame.
+#define FRAME_BUDGET 2000000
+
+/*
+ * Builds a 500MB rope, counted as four bytes per codepoint, then runs frames
+ * that each make a few edits to a small rope and call rope_reclaim() with a
+ * 2ms budget, as the editor does. The large rope is dropped in the first
+ * frame, and the worst frame time is reported along with the number of
+ * frames it took to free it. A size in megabytes can be given instead.
+ */
+int main(int argc, char **argv)
+{
+  int size = argc > 1 ? atoi(argv[1]) : 500;
+  int length = (int)((size_t)size * 1024 * 1024 / sizeof(uint32_t));
+
+  uint32_t *text = malloc((size_t)length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) text[i] = 'a' + i % 26;
+  RopeNode *large = rope_build(text, length);
+  RopeNode *small = rope_build(text, 4096);
+  free(text);
+  if (large == NULL || small == NULL) {
+    fprintf(stderr, "build failed\n");
+    return 1;
+  }
+  PoolStats stats = pool_stats();
+  long live = stats.allocs - stats.frees;
+
+  uint64_t worst = 0;
+  uint64_t drop = 0;
+  int frames = 0;
+  for (bool done = false; !done; frames++) {
+    uint64_t t = bench_now();
+
+    // drop the large rope in the first frame, as closing a buffer would
+    if (frames == 0) {
+      rope_deref(large);
+      drop = bench_now() - t;
+    }
+
+    // make a few edits, which free the nodes they replace
+    for (int i = 0; i < 16; i++) {
+      RopeNode *next = rope_insert(small, 'x', rand() % rope_length(small) - 1);
+      rope_deref(small);
+      small = rope_delete(next, rand() % rope_length(next));
+      rope_deref(next);
+    }
+
+    done = rope_reclaim(FRAME_BUDGET);
+    t = bench_now() - t;
+    if (t > worst) worst = t;
+  }
+  rope_deref(small);
+  rope_reclaim(0);
+
+  stats = pool_stats();
+  printf("%-6s %dMB blocks=%ld deref=%.2fms worst frame=%.2fms frames=%d leaked=%ld\n", LAYOUT,
+         size, live, drop / 1e6, worst / 1e6, frames, stats.allocs - stats.frees);
+  return 0;
+}
@@ -0,0 +1,80 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "buffer.h"
+#include "cursor.h"
+#include "pool.h"
+#include "rope.h"
+
+/*
+ * Types the given number of millions of keystrokes into a buffer holding a
+ * document of 16K lines, as a long session would, and reports the resident
+ * set size, the number of versions kept and the memory they hold after every
+ * million. Most keystrokes type a character, some press backspace or Enter,
+ * and every so often the cursor jumps to another line. The dead nodes are
+ * freed every thousand keystrokes, as the editor does every frame. The limit
+ * on versions, the limit on the memory of the versions in mebibytes and the
+ * kind of storage may be given after the keystrokes, where a limit of 0 is no
+ * limit.
+ */
+int main(int argc, char **argv)
+{
+  long keystrokes = (argc > 1 ? atol(argv[1]) : 10) * 1000 * 1000;
+  int max_versions = argc > 2 ? atoi(argv[2]) : BUFFER_MAX_VERSIONS;
+  long max_bytes = argc > 3 ? atol(argv[3]) * 1024 * 1024 : BUFFER_MAX_BYTES;
+  StorageType type = argc > 4 && strcmp(argv[4], "gap") == 0 ? STORAGE_GAP : STORAGE_ROPE;
+  int lines = 16 * 1024;
+  int width = 64;
+
+  // lay the lines out as a file would be
+  int length = lines * (width + 1) - 1;
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) {
+    text[i] = i % (width + 1) == width ? '\n' : 'a' + i % 26;
+  }
+  Buffer *buffer = buffer_init(type);
+  check(buffer != NULL, "buffer_init");
+  buffer_set_history(buffer, max_versions > 0 ? max_versions : 1 << 30,
+                     max_bytes > 0 ? max_bytes : 1L << 62);
+  Cursor cursor = {.line = 0, .idx = -1};
+  check(buffer_insert_text(buffer, &cursor, text, length), "open");
+  free(text);
+
+  srand(1);
+  double base = bench_rss();
+  uint64_t t = bench_now();
+  for (long i = 1; i <= keystrokes; i++) {
+    // jump to another place in the document every so often
+    if (rand() % 32 == 0) {
+      cursor.line = rand() % buffer_lines(buffer);
+      cursor.idx = rand() % (buffer_line_length(buffer, cursor.line) + 1) - 1;
+    }
+    int key = rand() % 100;
+    if (key < 8 && (cursor.line > 0 || cursor.idx > -1)) {
+      check(buffer_delete(buffer, &cursor), "delete");
+    } else if (key < 10) {
+      check(buffer_newline(buffer, &cursor), "newline");
+    } else {
+      check(buffer_insert(buffer, &cursor, 'a' + key % 26), "insert");
+    }
+    if (i % 1000 == 0) rope_reclaim(0);
+    if (i % 1000000 == 0) {
+      printf("%-6s %-4s %5.1fM keys %7.1fns/key rss=%7.1fMiB (+%.1f) versions=%-7d "
+             "history=%7.1fMiB pool=%7.1fMiB\n",
+             LAYOUT, type == STORAGE_GAP ? "gap" : "rope", i / 1e6,
+             (double)(bench_now() - t) / i, bench_rss(), bench_rss() - base,
+             (int)arrlen(buffer->ropes),
+             buffer->history_bytes / 1048576.0, pool_stats().bytes / 1048576.0);
+      fflush(stdout);
+    }
+  }
+
+  buffer_free(buffer);
+  rope_reclaim(0);
+  return 0;
+}
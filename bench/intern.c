@@ -0,0 +1,126 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+
+#ifdef ROPE_INTERN
+#define MODE "intern"
+#else
+#define MODE "plain"
+#endif
+
+// fills the text with log lines, repeating the same block of lines if the
+// block is not 0, or numbering every line differently otherwise
+static void write_log(uint32_t *text, int length, int block)
+{
+  int at = 0;
+  for (long line = 0; at < length; line++) {
+    char entry[128];
+    long id = block != 0 ? line % 8 : line;
+    int n = snprintf(entry, sizeof(entry),
+                     "2026-10-16T%02ld:%02ld:%02ld WARN retrying request id=%08lx backend=%ld\n",
+                     id / 3600 % 24, id / 60 % 60, id % 60, id * 2654435761 % 0xffffffff,
+                     id % 7);
+    for (int i = 0; i < n && at < length; i++) text[at++] = entry[i];
+    // pad the block of eight lines so that it spans whole leaves
+    if (block != 0 && line % 8 == 7) {
+      while (at % block != 0 && at < length) text[at++] = ' ';
+      text[at - 1] = '\n';
+    }
+  }
+}
+
+#if defined(ROPE_INTERN) && defined(ROPE_ATOMIC)
+
+// builds a leaf again after its last reference is dropped but before it is
+// reclaimed, and checks that the new rope still reads back once it is
+static void check_retired(void)
+{
+  uint32_t text[64];
+  for (int i = 0; i < 64; i++) text[i] = 'a' + i % 26;
+  RopeNode *first = rope_build(text, 64);
+  check(first != NULL, "build");
+  rope_deref(first);
+  RopeNode *second = rope_build(text, 64);
+  check(second != NULL, "build");
+  rope_reclaim(0);
+  for (int i = 0; i < 64; i++) check(rope_index(second, i).c == text[i], "rope_index");
+  rope_deref(second);
+  rope_reclaim(0);
+}
+
+#endif
+
+// builds the log and reports how much memory its rope holds
+static RopeNode *build(const char *name, uint32_t *text, int length)
+{
+  long bytes = pool_stats().bytes;
+  uint64_t t = bench_now();
+  RopeNode *root = rope_build(text, length);
+  check(root != NULL, "build");
+  printf("%-6s %-6s build %-10s %8.1fms pool=%8.1fKiB\n", LAYOUT, MODE, name,
+         (bench_now() - t) / 1e6, (pool_stats().bytes - bytes) / 1024.0);
+  return root;
+}
+
+/*
+ * Builds a log of the given number of mebi-codepoints twice, once made of a
+ * block of lines that keeps repeating and once with every line different, and
+ * reports how much memory each rope holds. Then it times typing into the log
+ * and comparing two copies of it with rope_equal(). Building with ROPE_INTERN
+ * and without it shows what interning saves and what it costs. With
+ * ROPE_ATOMIC as well, it first checks that a leaf waiting to be reclaimed is
+ * not shared by a rope built after it died.
+ */
+int main(int argc, char **argv)
+{
+  int length = (argc > 1 ? atoi(argv[1]) : 16) * 1024 * 1024;
+  int edits = 100000;
+  int runs = 100;
+
+#if defined(ROPE_INTERN) && defined(ROPE_ATOMIC)
+  check_retired();
+#endif
+
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  check(text != NULL, "malloc");
+  write_log(text, length, LEAF_WEIGHT);
+  RopeNode *repeated = build("repeated", text, length);
+  write_log(text, length, 0);
+  RopeNode *unique = build("unique", text, length);
+
+  // type into the log one character at a time, keeping every version alive
+  // for the length of one edit as undo would
+  srand(1);
+  uint64_t t = bench_now();
+  for (int i = 0; i < edits; i++) {
+    RopeNode *next = rope_insert(unique, 'a' + i % 26, rand() % rope_length(unique) - 1);
+    check(next != NULL, "insert");
+    rope_deref(unique);
+    unique = next;
+  }
+  printf("%-6s %-6s insert %8.1fns/op\n", LAYOUT, MODE, (double)(bench_now() - t) / edits);
+
+  // compare two copies of the log built apart, so that they share no nodes
+  RopeNode *copy = rope_build(text, length);
+  RopeNode *other = rope_build(text, length);
+  check(copy != NULL && other != NULL, "build");
+  bool equal = false;
+  t = bench_now();
+  for (int i = 0; i < runs; i++) equal = rope_equal(copy, other);
+  check(equal, "rope_equal");
+  printf("%-6s %-6s rope_equal %10.1fns\n", LAYOUT, MODE, (double)(bench_now() - t) / runs);
+
+  rope_deref(repeated);
+  rope_deref(unique);
+  rope_deref(copy);
+  rope_deref(other);
+  rope_reclaim(0);
+  free(text);
+  return 0;
+}
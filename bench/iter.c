@@ -0,0 +1,71 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+// prints the throughput of reading the whole document in GB/s
+static void report(const char *shape, const char *name, int length, uint64_t ns)
+{
+  printf("%-6s %-7s %-10s %.2f GB/s (%.1fms)\n", LAYOUT, shape, name,
+         (double)length * sizeof(uint32_t) / ns, ns / 1e6);
+}
+
+// copies the whole document into a preallocated array by stepping a RopeIter
+// forward and backward, and compares it with allocating it with rope_text()
+static void run(RopeNode *root, const char *shape, uint32_t *dst)
+{
+  int length = rope_length(root);
+
+  uint64_t t = bench_now();
+  RopeIter iter;
+  rope_iter_init(&iter, root, 0);
+  do {
+    memcpy(dst + iter.start, iter.chunk, iter.len * sizeof(uint32_t));
+  } while (rope_iter_next(&iter));
+  report(shape, "next", length, bench_now() - t);
+
+  t = bench_now();
+  rope_iter_init(&iter, root, length);
+  while (rope_iter_prev(&iter)) {
+    memcpy(dst + iter.start, iter.chunk, iter.len * sizeof(uint32_t));
+  }
+  report(shape, "prev", length, bench_now() - t);
+
+  t = bench_now();
+  uint32_t *text = rope_text(root);
+  report(shape, "rope_text", length, bench_now() - t);
+  arrfree(text);
+}
+
+/*
+ * Reads a large document leaf by leaf with a RopeIter, both as freshly built
+ * and after scattered single character edits have split up its leaves.
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 50 * 1024 * 1024;
+  int edits = argc > 2 ? atoi(argv[2]) : 200000;
+
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) text[i] = 'a' + i % 26;
+  RopeNode *root = rope_build(text, length);
+  run(root, "built", text);
+
+  srand(1);
+  for (int i = 0; i < edits; i++) {
+    RopeNode *next = rope_insert(root, 'x', rand() % length);
+    rope_deref(root);
+    root = next;
+  }
+  text = realloc(text, rope_length(root) * sizeof(uint32_t));
+  run(root, "edited", text);
+
+  rope_deref(root);
+  free(text);
+  return 0;
+}
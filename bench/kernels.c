@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+static const char *names[] = {"scalar", "sse2", "avx2"};
+
+// reports the throughput of a kernel over the given number of input bytes
+static void report(const char *kernel, const char *text, RopeKernels level, long bytes,
+                   uint64_t t, long check)
+{
+  double ns = (double)(bench_now() - t);
+  printf("%-16s %-5s %-6s %6.2f GB/s (%ld)\n", kernel, text, names[level], bytes / ns, check);
+}
+
+// runs each kernel over the text with every instruction set the CPU has
+static void run(const char *name, const uint32_t *text, int length)
+{
+  char *utf8 = malloc((size_t)length * 4);
+  uint32_t *decoded = malloc((size_t)length * sizeof(uint32_t));
+  int bytes = rope_encode_utf8(text, length, utf8);
+  rope_decode_utf8(utf8, bytes, decoded, length);
+  RopeKernels widest = rope_kernels(ROPE_KERNELS_AVX2);
+  for (RopeKernels level = ROPE_KERNELS_SCALAR; level <= widest; level++) {
+    rope_kernels(level);
+
+    uint64_t t = bench_now();
+    RopeSummary summary = rope_summarize(text, length);
+    report("summarize", name, level, (long)length * 4, t, summary.newlines);
+
+    t = bench_now();
+    int count;
+    summary = rope_summarize_utf8(utf8, bytes, &count);
+    report("summarize_utf8", name, level, bytes, t, count);
+
+    t = bench_now();
+    long written = rope_encode_utf8(text, length, utf8);
+    report("encode_utf8", name, level, (long)length * 4, t, written);
+
+    t = bench_now();
+    written = rope_decode_utf8(utf8, bytes, decoded, length);
+    report("decode_utf8", name, level, bytes, t, written);
+  }
+  rope_kernels(ROPE_KERNELS_AVX2);
+  free(utf8);
+  free(decoded);
+}
+
+/*
+ * Measures the throughput of the kernels that scan text, for each instruction
+ * set the CPU has, over source code and over prose mixing CJK with ASCII.
+ * Throughput is measured against the input, which is 4 bytes per codepoint
+ * when summarizing and encoding codepoints, and the UTF-8 bytes otherwise.
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 64 * 1024 * 1024;
+  uint32_t *text = malloc((size_t)length * sizeof(uint32_t));
+
+  // lines of ASCII source code
+  static const char code[] = "  for (int i = 0; i < count; i++) total += values[i];\n";
+  for (int i = 0; i < length; i++) text[i] = (unsigned char)code[i % (sizeof(code) - 1)];
+  run("code", text, length);
+
+  // lines of CJK prose with ASCII markup and numbers
+  srand(1);
+  for (int i = 0; i < length; i++) {
+    int r = rand() % 10;
+    if (i % 41 == 40) text[i] = '\n';
+    else if (r < 6) text[i] = 0x4e00 + rand() % 0x5000;
+    else if (r < 7) text[i] = 0x3040 + rand() % 0x60;
+    else text[i] = "<p> 0123456789abcdef"[rand() % 20];
+  }
+  run("cjk", text, length);
+
+  free(text);
+  return 0;
+}
@@ -0,0 +1,66 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+/*
+ * Compares the rope layouts by building a single rope of N codepoints and
+ * timing random indexing, random single character inserts, and collecting the
+ * full text with rope_text(). Build with ROPE=binary and ROPE=btree to compare.
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 10 * 1024 * 1024;
+  int ops = argc > 2 ? atoi(argv[2]) : 1000000;
+  srand(1);
+
+  // build the document
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) text[i] = 'a' + i % 26;
+  uint64_t t = bench_now();
+  RopeNode *root = rope_build(text, length);
+  t = bench_now() - t;
+  printf("%-6s length=%d height=%d build=%.1fms\n", LAYOUT, length,
+         rope_height(root, 0), t / 1e6);
+  free(text);
+
+  // index random characters
+  uint32_t sum = 0;
+  t = bench_now();
+  for (int i = 0; i < ops; i++) {
+    sum += rope_index(root, rand() % length).c;
+  }
+  t = bench_now() - t;
+  printf("%-6s index:  %.1fns/op (%u)\n", LAYOUT, (double)t / ops, sum % 10);
+
+  // insert characters at random positions
+  t = bench_now();
+  for (int i = 0; i < ops; i++) {
+    RopeNode *next = rope_insert(root, 'x', rand() % (length + i) - 1);
+    if (next == NULL) {
+      fprintf(stderr, "rope_insert failed at %d\n", i);
+      return 1;
+    }
+    rope_deref(root);
+    root = next;
+  }
+  t = bench_now() - t;
+  printf("%-6s insert: %.1fns/op height=%d\n", LAYOUT, (double)t / ops,
+         rope_height(root, 0));
+
+  // collect the whole text
+  length = rope_length(root);
+  t = bench_now();
+  uint32_t *all = rope_text(root);
+  t = bench_now() - t;
+  printf("%-6s text:   %.1fms %.2fGB/s\n", LAYOUT, t / 1e6,
+         (double)length * sizeof(uint32_t) / t);
+  arrfree(all);
+
+  rope_deref(root);
+  return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+// counts the leaves and the bytes held by the nodes and text of a rope
+static void rope_usage(RopeNode *node, int *leaves, size_t *bytes)
+{
+  *bytes += sizeof(RopeNode);
+#ifdef ROPE_BTREE
+  if (node->height == 1) {
+    (*leaves)++;
+    return;
+  }
+  for (int i = 0; i < node->count; i++) rope_usage(node->children[i], leaves, bytes);
+#else
+  if (node->left == NULL) {
+    (*leaves)++;
+    *bytes += node->weight * sizeof(uint32_t);
+    return;
+  }
+  rope_usage(node->left, leaves, bytes);
+  rope_usage(node->right, leaves, bytes);
+#endif
+}
+
+/*
+ * Simulates typing a line by hand: most keystrokes insert a character at the
+ * cursor and advance it, some delete the character before the cursor, and
+ * some move the cursor somewhere else in the line. Reports the number of
+ * leaves and the bytes used per character of text in the final rope.
+ */
+int main(int argc, char **argv)
+{
+  int keystrokes = argc > 1 ? atoi(argv[1]) : 100000;
+  srand(1);
+
+  RopeNode *root = rope_build(NULL, 0);
+  int length = 0;
+  int cursor = -1;
+  uint64_t t = bench_now();
+  for (int i = 0; i < keystrokes; i++) {
+    int action = rand() % 100;
+    RopeNode *next = NULL;
+    if (action < 5 && length > 0) {
+      cursor = rand() % length - 1;
+      continue;
+    } else if (action < 10 && cursor > -1) {
+      next = rope_delete(root, cursor);
+      cursor--;
+      length--;
+    } else {
+      next = rope_insert(root, 'a' + i % 26, cursor);
+      cursor++;
+      length++;
+    }
+    if (next == NULL) {
+      fprintf(stderr, "edit failed at %d\n", i);
+      return 1;
+    }
+    rope_deref(root);
+    root = next;
+  }
+  t = bench_now() - t;
+
+  int leaves = 0;
+  size_t bytes = 0;
+  rope_usage(root, &leaves, &bytes);
+  printf("leaf=%d keystrokes=%d length=%d leaves=%d bytes/char=%.2f avg=%.1fns\n",
+         LEAF_WEIGHT, keystrokes, length, leaves, (double)bytes / length,
+         (double)t / keystrokes);
+  rope_deref(root);
+  return 0;
+}
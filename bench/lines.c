@@ -0,0 +1,74 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "buffer.h"
+#include "cursor.h"
+#include "rope.h"
+
+/*
+ * Opens a document of N lines by pasting it into a new buffer, then presses
+ * Enter and backspace in the middle of it, types on the new line, and looks up
+ * lines across the document, the way the editor does every frame.
+ */
+int main(int argc, char **argv)
+{
+  int lines = argc > 1 ? atoi(argv[1]) : 5 * 1000 * 1000;
+  int width = argc > 2 ? atoi(argv[2]) : 16;
+  int ops = 1000;
+
+  // lay the lines out as a file would be
+  int length = lines * (width + 1) - 1;
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) {
+    text[i] = i % (width + 1) == width ? '\n' : 'a' + i % 26;
+  }
+
+  uint64_t t = bench_now();
+  Buffer *buffer = buffer_init(STORAGE_ROPE);
+  Cursor cursor = {.line = 0, .idx = -1};
+  check(buffer != NULL && buffer_insert_text(buffer, &cursor, text, length), "open");
+  uint64_t open = bench_now() - t;
+  free(text);
+  printf("%-6s open   lines=%-8d %.1fms\n", LAYOUT, buffer_lines(buffer), open / 1e6);
+
+  // split the middle line in two and join it back, one keypress at a time
+  uint64_t enter = 0;
+  uint64_t join = 0;
+  for (int i = 0; i < ops; i++) {
+    cursor = (Cursor){.line = lines / 2, .idx = width / 2 - 1};
+    t = bench_now();
+    check(buffer_newline(buffer, &cursor), "newline");
+    enter += bench_now() - t;
+    t = bench_now();
+    check(buffer_delete(buffer, &cursor), "join");
+    join += bench_now() - t;
+  }
+  printf("%-6s enter  %.1fus/op\n", LAYOUT, enter / 1e3 / ops);
+  printf("%-6s join   %.1fus/op\n", LAYOUT, join / 1e3 / ops);
+
+  // type on the line, caching the lines on the screen after each character
+  cursor = (Cursor){.line = lines / 2, .idx = width - 1};
+  t = bench_now();
+  for (int i = 0; i < ops; i++) {
+    check(buffer_insert(buffer, &cursor, 'x'), "insert");
+    check(buffer_text(buffer, lines / 2 - 20, 40), "text");
+  }
+  printf("%-6s type   %.1fus/op\n", LAYOUT, (bench_now() - t) / 1e3 / ops);
+
+  // look up the length of lines spread across the document
+  srand(1);
+  t = bench_now();
+  long total = 0;
+  for (int i = 0; i < ops; i++) total += buffer_line_length(buffer, rand() % lines);
+  printf("%-6s lookup %.1fus/op (%ld)\n", LAYOUT, (bench_now() - t) / 1e3 / ops, total);
+
+  t = bench_now();
+  buffer_free(buffer);
+  rope_reclaim(0);
+  printf("%-6s close  %.1fms\n", LAYOUT, (bench_now() - t) / 1e6);
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+
+// writes a log file of about the given size, unless one of that size exists
+static void write_log(const char *path, long size)
+{
+  struct stat st;
+  if (stat(path, &st) == 0 && st.st_size >= size - 128 && st.st_size <= size) return;
+  FILE *file = fopen(path, "w");
+  check(file != NULL, "create");
+  long written = 0;
+  for (long line = 0;; line++) {
+    char entry[128];
+    int n = snprintf(entry, sizeof(entry),
+                     "2026-10-16T%02ld:%02ld:%02ld.%03ld INFO http request id=%08lx "
+                     "status=200 took=%ldms\n",
+                     line / 3600000 % 24, line / 60000 % 60, line / 1000 % 60, line % 1000,
+                     line * 2654435761 % 0xffffffff, line % 97);
+    if (written + n > size) break;
+    fwrite(entry, 1, n, file);
+    written += n;
+  }
+  fclose(file);
+}
+
+// opens the file by reading it into memory, decoding it and building a rope
+// out of the codepoints, as opening a file did before rope_map()
+static RopeNode *read_build(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  check(file != NULL, "open");
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *bytes = malloc(size);
+  uint32_t *text = malloc(size * sizeof(uint32_t));
+  check(bytes != NULL && text != NULL && fread(bytes, 1, size, file) == (size_t)size, "read");
+  fclose(file);
+  RopeNode *root = rope_build(text, rope_decode_utf8(bytes, size, text, size));
+  free(bytes);
+  free(text);
+  return root;
+}
+
+/*
+ * Opens a log file of the given number of mebibytes with rope_map(), then
+ * makes scattered edits to it and searches all of it, reporting how long each
+ * step takes and how much memory the rope holds. Opening the same file by
+ * reading and decoding it into rope_build() is timed for comparison.
+ */
+int main(int argc, char **argv)
+{
+  long size = (argc > 1 ? atol(argv[1]) : 256) * 1024 * 1024;
+  const char *path = argc > 2 ? argv[2] : "/tmp/ped-map.log";
+  int edits = 1000;
+  write_log(path, size);
+
+  double base = bench_rss();
+  long bytes = pool_stats().bytes;
+  uint64_t t = bench_now();
+  RopeNode *root = rope_map(path);
+  check(root != NULL, "rope_map");
+  printf("%-6s rope_map     %8.1fms  pool=%7.1fMiB rss=+%.1fMiB length=%d\n", LAYOUT,
+         (bench_now() - t) / 1e6, (pool_stats().bytes - bytes) / 1048576.0, bench_rss() - base,
+         rope_length(root));
+
+  // insert a word at scattered places, keeping only the newest version
+  srand(1);
+  uint32_t word[16];
+  for (int i = 0; i < 16; i++) word[i] = 'A' + i;
+  bytes = pool_stats().bytes;
+  t = bench_now();
+  for (int i = 0; i < edits; i++) {
+    RopeNode *next = rope_insert_text(root, word, 16, rand() % rope_length(root) - 1);
+    check(next != NULL, "insert");
+    rope_deref(root);
+    root = next;
+  }
+  printf("%-6s %d edits  %8.1fus/op pool=+%.1fMiB rss=+%.1fMiB\n", LAYOUT, edits,
+         (bench_now() - t) / 1e3 / edits, (pool_stats().bytes - bytes) / 1048576.0,
+         bench_rss() - base);
+
+  // read all of the text back through the mapping
+  uint32_t needle[] = {'i', 'd', '=', 'f', 'f', 'f', 'f', 'f', 'f', 'f', 'f'};
+  t = bench_now();
+  int found = rope_find(root, needle, 11, 0);
+  printf("%-6s find         %8.1fms  rss=+%.1fMiB (%d)\n", LAYOUT, (bench_now() - t) / 1e6,
+         bench_rss() - base, found);
+  rope_deref(root);
+  rope_reclaim(0);
+
+  bytes = pool_stats().bytes;
+  t = bench_now();
+  root = read_build(path);
+  check(root != NULL, "rope_build");
+  printf("%-6s read+build   %8.1fms  pool=%7.1fMiB\n", LAYOUT, (bench_now() - t) / 1e6,
+         (pool_stats().bytes - bytes) / 1048576.0);
+  rope_deref(root);
+  rope_reclaim(0);
+  return 0;
+}
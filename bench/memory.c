@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+
+// the number of codepoints built into a rope at a time, so that the text
+// itself never has to be held in memory all at once
+#define CHUNK (16 * 1024 * 1024)
+
+// fills a chunk with log lines, returning the number of codepoints written
+static int fill_log(uint32_t *text, int len, long *line)
+{
+  int i = 0;
+  char entry[128];
+  while (true) {
+    int n = snprintf(entry, sizeof(entry),
+                     "2026-10-16T%02ld:%02ld:%02ld.%03ld INFO http request id=%08lx "
+                     "status=200 took=%ldms\n",
+                     *line / 3600000 % 24, *line / 60000 % 60, *line / 1000 % 60,
+                     *line % 1000, *line * 2654435761 % 0xffffffff, *line % 97);
+    if (i + n > len) return i;
+    for (int j = 0; j < n; j++) text[i + j] = (unsigned char)entry[j];
+    i += n;
+    (*line)++;
+  }
+}
+
+// fills a chunk with lines of CJK prose mixed with ASCII markup and numbers
+static int fill_cjk(uint32_t *text, int len, long *line)
+{
+  for (int i = 0; i < len; i++) {
+    int r = rand() % 10;
+    if (i % 41 == 40) text[i] = '\n';
+    else if (r < 6) text[i] = 0x4e00 + rand() % 0x5000;
+    else if (r < 7) text[i] = 0x3040 + rand() % 0x60;
+    else text[i] = "<p> 0123456789abcdef"[rand() % 20];
+  }
+  *line += len / 41;
+  return len;
+}
+
+// builds a rope of about the given length a chunk at a time and reports how
+// much memory its nodes take up
+static void measure(const char *name, long length, int (*fill)(uint32_t*, int, long*))
+{
+  uint32_t *text = malloc(CHUNK * sizeof(uint32_t));
+  long before = pool_stats().bytes;
+  long line = 0;
+  RopeNode *root = NULL;
+
+  uint64_t t = bench_now();
+  for (long built = 0; built < length;) {
+    int len = fill(text, length - built < CHUNK ? length - built : CHUNK, &line);
+    if (len == 0) break;
+    RopeNode *next = root == NULL ? rope_build(text, len)
+                                  : rope_insert_text(root, text, len, rope_length(root) - 1);
+    if (next == NULL) {
+      fprintf(stderr, "%s: build failed\n", name);
+      exit(1);
+    }
+    rope_deref(root);
+    root = next;
+    built += len;
+  }
+  uint64_t build = bench_now() - t;
+  free(text);
+
+  long bytes = pool_stats().bytes - before;
+  RopeSummary summary = rope_summary(root);
+  int length_cp = rope_length(root);
+  printf("%-5s %-5s codepoints=%d utf8=%dMB nodes=%ldMB %.2fB/codepoint %.2fB/byte "
+         "build=%.0fms\n",
+         LAYOUT, name, length_cp, summary.bytes >> 20, bytes >> 20,
+         (double)bytes / length_cp, (double)bytes / summary.bytes, build / 1e6);
+
+  // copy the whole rope out as UTF-8, as saving the file would
+  char *out = malloc(summary.bytes);
+  t = bench_now();
+  int written = rope_copy_out_utf8(root, 0, length_cp, out);
+  printf("%-5s %-5s copy out %dMB %.0fms\n", LAYOUT, name, written >> 20,
+         (bench_now() - t) / 1e6);
+  free(out);
+
+  rope_deref(root);
+  rope_reclaim(0);
+}
+
+/*
+ * Builds an ASCII log of the given number of megabytes and a corpus of the
+ * given number of mebi-codepoints mixing CJK with ASCII, and reports how many
+ * bytes the nodes of each rope take up for every codepoint and for every byte
+ * of the text as UTF-8.
+ */
+int main(int argc, char **argv)
+{
+  long log_size = argc > 1 ? atol(argv[1]) : 1024;
+  long cjk_size = argc > 2 ? atol(argv[2]) : 64;
+
+  srand(1);
+  measure("log", log_size << 20, fill_log);
+  measure("cjk", cjk_size << 20, fill_cjk);
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "buffer.h"
+#include "cursor.h"
+#include "rope.h"
+
+// fills a clipboard with lines of the given width, or a single line if the
+// width is 0
+static uint32_t *clipboard(int size, int width)
+{
+  uint32_t *text = malloc(size * sizeof(uint32_t));
+  for (int i = 0; i < size; i++) {
+    text[i] = width > 0 && i % (width + 1) == width ? '\n' : 'a' + i % 26;
+  }
+  return text;
+}
+
+// inserts the clipboard into the middle of a rope
+static void insert(int size)
+{
+  uint32_t *text = clipboard(size, 0);
+  RopeNode *root = rope_build(text, 1000);
+  uint64_t t = bench_now();
+  RopeNode *new_root = rope_insert_text(root, text, size, 499);
+  t = bench_now() - t;
+  if (new_root == NULL) {
+    fprintf(stderr, "insert failed\n");
+    exit(1);
+  }
+  printf("%-6s insert size=%-10d rope_insert_text %.1fms\n", LAYOUT, size, t / 1e6);
+  rope_deref(new_root);
+  rope_deref(root);
+  free(text);
+}
+
+// pastes the clipboard into the middle of a line of a new buffer
+static void paste(int size, int width)
+{
+  uint32_t *text = clipboard(size, width);
+  uint32_t *line = clipboard(1000, 0);
+  Buffer *buffer = buffer_init(STORAGE_ROPE);
+  Cursor cursor = {.line = 0, .idx = -1};
+  buffer_insert_text(buffer, &cursor, line, 1000);
+  cursor.idx = 499;
+  free(line);
+
+  uint64_t t = bench_now();
+  if (!buffer_insert_text(buffer, &cursor, text, size)) {
+    fprintf(stderr, "paste failed\n");
+    exit(1);
+  }
+  t = bench_now() - t;
+  printf("%-6s paste size=%-10d width=%-3d lines=%-8d %.1fms\n", LAYOUT, size, width,
+         buffer_lines(buffer), t / 1e6);
+  buffer_free(buffer);
+  free(text);
+}
+
+/*
+ * Pastes clipboards of 1, 10 and 100 million codepoints into a buffer, both as
+ * lines of 80 characters and as a single line. Then compares inserting each
+ * clipboard into a rope at once with inserting the smallest one a character
+ * at a time.
+ */
+int main(int argc, char **argv)
+{
+  int max = argc > 1 ? atoi(argv[1]) : 100 * 1024 * 1024;
+
+  for (int size = 1024 * 1024; size <= max; size *= 10) {
+    paste(size, 80);
+    paste(size, 0);
+  }
+  for (int size = 1024 * 1024; size <= max; size *= 10) {
+    insert(size);
+  }
+
+  // insert the smallest clipboard one character at a time into a rope that
+  // keeps every version, like the history of a buffer
+  int size = 1024 * 1024;
+  uint32_t *text = clipboard(size, 0);
+  RopeNode **versions = NULL;
+  arrput(versions, rope_build(NULL, 0));
+  uint64_t t = bench_now();
+  for (int i = 0; i < size; i++) {
+    RopeNode *next = rope_insert(arrlast(versions), text[i], i - 1);
+    if (next == NULL) {
+      fprintf(stderr, "insert failed\n");
+      return 1;
+    }
+    arrput(versions, next);
+  }
+  t = bench_now() - t;
+  printf("%-6s insert size=%-10d one at a time %.1fms\n", LAYOUT, size, t / 1e6);
+  for (int i = 0; i < arrlen(versions); i++) rope_deref(versions[i]);
+  arrfree(versions);
+  free(text);
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+
+/*
+ * Deletes, extracts and replaces selections of growing size in the middle of a
+ * large document with the range functions, and compares deleting the largest
+ * selection with the same number of calls to rope_delete().
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 50 * 1024 * 1024;
+  int max = argc > 2 ? atoi(argv[2]) : 1024 * 1024;
+
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) text[i] = 'a' + i % 26;
+  RopeNode *root = rope_build(text, length);
+  RopeNode *insert = rope_build(text, 1000);
+  free(text);
+
+  for (int len = 1; len <= max; len *= 32) {
+    int start = (length - len) / 2;
+    PoolStats before = pool_stats();
+    uint64_t t = bench_now();
+    RopeNode *deleted = rope_delete_range(root, start, len);
+    uint64_t t_delete = bench_now() - t;
+    PoolStats after = pool_stats();
+    t = bench_now();
+    RopeNode *sub = rope_substr(root, start, len);
+    uint64_t t_substr = bench_now() - t;
+    t = bench_now();
+    RopeNode *replaced = rope_replace(root, start, len, insert);
+    uint64_t t_replace = bench_now() - t;
+    printf("%-6s len=%-8d delete_range=%.1fus allocs=%ld substr=%.1fus replace=%.1fus\n",
+           LAYOUT, len, t_delete / 1e3, after.allocs - before.allocs, t_substr / 1e3,
+           t_replace / 1e3);
+    rope_deref(deleted);
+    rope_deref(sub);
+    rope_deref(replaced);
+  }
+
+  // delete the largest selection one character at a time, keeping the
+  // original rope alive as a snapshot
+  RopeNode *curr = root;
+  rope_ref(root);
+  uint64_t t = bench_now();
+  for (int i = 0; i < max; i++) {
+    RopeNode *next = rope_delete(curr, (length - max) / 2);
+    rope_deref(curr);
+    curr = next;
+  }
+  t = bench_now() - t;
+  printf("%-6s len=%-8d rope_delete loop=%.1fms\n", LAYOUT, max, t / 1e6);
+
+  rope_deref(curr);
+  rope_deref(root);
+  rope_deref(insert);
+  return 0;
+}
@@ -0,0 +1,179 @@
+#include <regex.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "regexp.h"
+#include "rope.h"
+
+// the number of codepoints built into the rope at a time
+#define CHUNK (16 * 1024 * 1024)
+
+// a search that runs on a thread of its own until it is cancelled
+typedef struct Search {
+  Regexp *regex;
+  RopeNode *root;
+  _Atomic(bool) started;
+  _Atomic(bool) cancel;
+  int found;
+  uint64_t done;
+} Search;
+
+// reports how fast a search went over the text as UTF-8
+static void report(const char *search, const char *engine, long bytes, uint64_t t, long found)
+{
+  double ns = (double)(bench_now() - t);
+  printf("%-6s %-10s %-14s %6.2f GB/s %8.1fms (%ld)\n", LAYOUT, search, engine, bytes / ns,
+         ns / 1e6, found);
+}
+
+// compiles a pattern made of ASCII characters
+static Regexp *compile(const char *pattern)
+{
+  uint32_t codepoints[256];
+  int len = (int)strlen(pattern);
+  for (int i = 0; i < len; i++) codepoints[i] = (unsigned char)pattern[i];
+  Regexp *regex = regexp_compile(codepoints, len);
+  check(regex != NULL, pattern);
+  return regex;
+}
+
+// counts the matches of a pattern in text copied out of a rope, the way a
+// regex library would have to search it. The end of the text is passed with
+// REG_STARTEND so that it is not measured again for every match.
+static long flat_count(const char *text, long bytes, const char *pattern, bool all)
+{
+  regex_t regex;
+  check(regcomp(&regex, pattern, REG_EXTENDED | REG_NEWLINE) == 0, pattern);
+  regmatch_t match = {0, bytes};
+  long count = 0;
+  const char *at = text;
+  int flags = REG_STARTEND;
+  while (regexec(&regex, at, 1, &match, flags) == 0) {
+    count++;
+    if (!all) break;
+    at += match.rm_eo > match.rm_so ? match.rm_eo : match.rm_eo + 1;
+    if (at > text + bytes) break;
+    match = (regmatch_t){0, text + bytes - at};
+    flags = at[-1] == '\n' ? REG_STARTEND : REG_STARTEND | REG_NOTBOL;
+  }
+  regfree(&regex);
+  return count;
+}
+
+// runs a search until the main thread cancels it, first letting the main
+// thread know that it has started
+static int search_task(void *data)
+{
+  Search *search = data;
+  int end;
+  search->started = true;
+  search->found = regexp_find(search->regex, search->root, 0, &end, &search->cancel);
+  search->done = bench_now();
+  return 0;
+}
+
+/*
+ * Builds a log of the given number of mebi-codepoints, with a warning on
+ * every 64th line and a rare error only at its end, and searches it for the
+ * error, for every warning and for an alternation of words that are not in
+ * it, both streaming over the rope and with the text copied out as UTF-8 for
+ * the regex library of the C library. Then measures how long a search of the
+ * whole log takes to stop once it is cancelled from another thread.
+ * Throughput is measured against the size of the log as UTF-8.
+ */
+int main(int argc, char **argv)
+{
+  long length = (argc > 1 ? atol(argv[1]) : 256) << 20;
+
+  static const char info[] = "2024-05-17 12:34:56 INFO  worker 17 handled request in 12ms\n";
+  static const char warn[] = "2024-05-17 12:34:56 WARN  worker 17 request timeout after 30s\n";
+  static const char rare[] = "2024-05-17 12:34:56 ERROR disk 3 full\n";
+  int line = sizeof(info) - 1;
+
+  uint32_t *text = malloc(CHUNK * sizeof(uint32_t));
+  RopeNode *root = NULL;
+  uint64_t t = bench_now();
+  for (long built = 0; built < length; built += CHUNK) {
+    int chunk = length - built < CHUNK ? length - built : CHUNK;
+    for (int i = 0; i < chunk; i++) {
+      long l = (built + i) / line;
+      text[i] = (unsigned char)(l % 64 == 63 ? warn : info)[(built + i) % line];
+    }
+    if (built + chunk >= length) {
+      int len = sizeof(rare) - 1;
+      for (int i = 0; i < len; i++) text[chunk - len + i] = (unsigned char)rare[i];
+    }
+    RopeNode *next = root == NULL ? rope_build(text, chunk)
+                                  : rope_insert_text(root, text, chunk, rope_length(root) - 1);
+    check(next != NULL, "build");
+    rope_deref(root);
+    root = next;
+  }
+  free(text);
+  long bytes = rope_summary(root).bytes;
+  printf("%-6s build %ldMB %.0fms\n", LAYOUT, bytes >> 20, (bench_now() - t) / 1e6);
+
+  static const struct {
+    const char *name;
+    const char *pattern;
+    bool all;
+  } searches[] = {
+    {"find", "ERROR [a-z]+ [0-9]+ full$", false},
+    {"find_all", "^[0-9-]+ [0-9:]+ WARN .*timeout", true},
+    {"alternation", "panic|fatal|segfault|oom-killer", false},
+  };
+  for (size_t i = 0; i < sizeof(searches) / sizeof(searches[0]); i++) {
+    Regexp *regex = compile(searches[i].pattern);
+    RegexpMatch *matches = NULL;
+    t = bench_now();
+    long found;
+    if (searches[i].all) {
+      found = regexp_find_all(regex, root, &matches, NULL);
+    } else {
+      int end;
+      found = regexp_find(regex, root, 0, &end, NULL) >= 0;
+    }
+    report(searches[i].name, "rope", bytes, t, found);
+    arrfree(matches);
+    regexp_free(regex);
+
+    t = bench_now();
+    char *flat = malloc(bytes + 1);
+    flat[rope_copy_out_utf8(root, 0, rope_length(root), flat)] = '\0';
+    long expected = flat_count(flat, bytes, searches[i].pattern, searches[i].all);
+    free(flat);
+    report(searches[i].name, "flatten+libc", bytes, t, expected);
+    check(found == expected, searches[i].name);
+  }
+
+  // cancel a search for a pattern that is not in the log partway through. A
+  // small log may be searched before the cancel is seen, in which case there
+  // is no latency to report.
+  Search search = {.regex = compile("[0-9]+ disk [0-9]+ empty"), .root = root};
+  SDL_Thread *thread = SDL_CreateThread(search_task, "search", &search);
+  check(thread != NULL, "SDL_CreateThread");
+  while (!search.started) {}
+  SDL_Delay(20);
+  t = bench_now();
+  search.cancel = true;
+  SDL_WaitThread(thread, NULL);
+  check(search.found == -2 || search.found == -1, "cancel");
+  if (search.found == -2) {
+    printf("%-6s cancel %.1fus\n", LAYOUT, (search.done - t) / 1e3);
+  } else {
+    printf("%-6s cancel finished before it was cancelled\n", LAYOUT);
+  }
+  regexp_free(search.regex);
+
+  rope_deref(root);
+  rope_reclaim(0);
+  return 0;
+}
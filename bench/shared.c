@@ -0,0 +1,180 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL_thread.h>
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+
+#ifndef ROPE_ATOMIC
+#error "bench/shared needs ROPE_ATOMIC"
+#endif
+
+// The state shared between the editing thread and the reading threads.
+typedef struct Shared {
+  RopeShared rope;
+  int length;
+  uint64_t sum;
+  atomic_bool stop;
+  atomic_long reads;
+  atomic_long failures;
+} Shared;
+
+// reads snapshots of the published rope until told to stop, checking that
+// every snapshot has the length and sum of codepoints that every edit keeps
+static int reader(void *data)
+{
+  Shared *shared = data;
+  uint32_t seed = (uint32_t)(uintptr_t)&seed;
+  while (!atomic_load(&shared->stop)) {
+    RopeNode *root = rope_acquire(&shared->rope);
+    if (root == NULL) {
+      atomic_fetch_add(&shared->failures, 1);
+      continue;
+    }
+
+    uint64_t sum = 0;
+    RopeIter iter;
+    rope_iter_init(&iter, root, 0);
+    do {
+      for (int i = 0; i < iter.len; i++) sum += iter.chunk[i];
+    } while (rope_iter_next(&iter));
+    for (int i = 0; i < 16; i++) {
+      seed = seed * 1664525 + 1013904223;
+      if (rope_index(root, (int)(seed >> 8) % shared->length).c >= 128) sum = 0;
+    }
+    if (rope_length(root) != shared->length || sum != shared->sum) {
+      atomic_fetch_add(&shared->failures, 1);
+    }
+
+    rope_deref(root);
+    atomic_fetch_add(&shared->reads, 1);
+  }
+  return 0;
+}
+
+// makes the given number of edits that each keep the length and sum of the
+// rope, publishing every few edits, and returns the edited rope
+static RopeNode *edit(Shared *shared, RopeNode *root, int edits, int publish)
+{
+  uint32_t segment[64];
+  for (int i = 0; i < edits; i++) {
+    RopeNode *next = NULL;
+    if (i % 2 == 0) {
+      // reverse a short segment in place
+      int len = 2 + rand() % 63;
+      int start = rand() % (shared->length - len);
+      rope_copy_out(root, start, len, segment);
+      for (int j = 0; j < len / 2; j++) {
+        uint32_t c = segment[j];
+        segment[j] = segment[len - 1 - j];
+        segment[len - 1 - j] = c;
+      }
+      RopeNode *deleted = rope_delete_range(root, start, len);
+      next = rope_insert_text(deleted, segment, len, start - 1);
+      rope_deref(deleted);
+    } else {
+      // move a character, which is edited in place if the rope is not shared
+      int from = rand() % shared->length;
+      uint32_t c = rope_index(root, from).c;
+      RopeNode *deleted = rope_delete(root, from);
+      next = rope_insert(deleted, c, rand() % shared->length - 1);
+      rope_deref(deleted);
+    }
+    rope_deref(root);
+    root = next;
+
+    if (publish > 0 && i % publish == 0) rope_publish(&shared->rope, root);
+    if (i % 256 == 0) rope_reclaim(0);
+  }
+  return root;
+}
+
+// makes the given number of edits that each keep the length and sum of the
+// rope, publishing it before each one and then publishing a copy of it in its
+// place, which leaves the editing thread with the only reference to it unless
+// a reader has taken one, so that the edit is made in place otherwise
+static RopeNode *edit_replaced(Shared *shared, RopeNode *root, RopeNode *copy, int edits)
+{
+  for (int i = 0; i < edits; i++) {
+    rope_publish(&shared->rope, root);
+    rope_publish(&shared->rope, copy);
+    int from = rand() % shared->length;
+    uint32_t c = rope_index(root, from).c;
+    RopeNode *deleted = rope_delete(root, from);
+    RopeNode *next = rope_insert(deleted, c, rand() % shared->length - 1);
+    rope_deref(deleted);
+    rope_deref(root);
+    root = next;
+    if (i % 256 == 0) rope_reclaim(0);
+  }
+  return root;
+}
+
+/*
+ * Edits a rope on the main thread while reading threads take snapshots of it
+ * with rope_acquire() and check them, and compares the speed of editing with
+ * and without readers. Then each version is replaced right after it is
+ * published and edited in place if no reader holds it, which readers must
+ * never see happen to a version they acquired.
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 100000;
+  int readers = argc > 2 ? atoi(argv[2]) : 4;
+  int edits = argc > 3 ? atoi(argv[3]) : 200000;
+  int publish = 16;
+
+  Shared shared = {.length = length};
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) {
+    text[i] = 'a' + i % 26;
+    shared.sum += text[i];
+  }
+  RopeNode *root = rope_build(text, length);
+  RopeNode *copy = rope_build(text, length);
+  free(text);
+
+  // edit alone first
+  uint64_t t = bench_now();
+  root = edit(&shared, root, edits, 0);
+  t = bench_now() - t;
+  printf("%-6s readers=0 edits=%.0f/s\n", LAYOUT, edits / (t / 1e9));
+
+  // then with readers
+  rope_publish(&shared.rope, root);
+  SDL_Thread *threads[ROPE_MAX_READERS];
+  if (readers > ROPE_MAX_READERS) readers = ROPE_MAX_READERS;
+  for (int i = 0; i < readers; i++) threads[i] = SDL_CreateThread(reader, "reader", &shared);
+  t = bench_now();
+  root = edit(&shared, root, edits, publish);
+  t = bench_now() - t;
+  long reads = atomic_load(&shared.reads);
+  long failures = atomic_load(&shared.failures);
+  printf("%-6s readers=%d edits=%.0f/s reads=%.0f/s failures=%ld\n", LAYOUT, readers,
+         edits / (t / 1e9), reads / (t / 1e9), failures);
+
+  // then with every version replaced as soon as it is published
+  t = bench_now();
+  root = edit_replaced(&shared, root, copy, edits);
+  t = bench_now() - t;
+  atomic_store(&shared.stop, true);
+  for (int i = 0; i < readers; i++) SDL_WaitThread(threads[i], NULL);
+  printf("%-6s readers=%d replaced edits=%.0f/s reads=%.0f/s failures=%ld\n", LAYOUT,
+         readers, edits / (t / 1e9), (atomic_load(&shared.reads) - reads) / (t / 1e9),
+         atomic_load(&shared.failures) - failures);
+
+  // everything must be freed once the last references are gone
+  rope_publish(&shared.rope, NULL);
+  rope_deref(root);
+  rope_deref(copy);
+  rope_reclaim(0);
+  PoolStats stats = pool_stats();
+  printf("%-6s leaked blocks=%ld\n", LAYOUT, stats.allocs - stats.frees);
+  return 0;
+}
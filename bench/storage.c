@@ -0,0 +1,232 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "pool.h"
+#include "rope.h"
+#include "storage.h"
+
+typedef enum {
+  TRACE_INSERT,
+  TRACE_DELETE,
+  TRACE_SNAPSHOT,
+} TraceType;
+
+typedef struct TraceOp {
+  TraceType type;
+  int pos;
+  int len;
+} TraceOp;
+
+// makes a trace of editing a document of the given length, as a number of
+// actions that each start with a snapshot, as the buffer takes one. Each
+// action types or backspaces a run of characters at a cursor, which moves a
+// few lines away for a local trace, or anywhere in the document otherwise.
+// Every so often a block of lines is pasted instead.
+static TraceOp *make_trace(int length, int actions, bool local)
+{
+  TraceOp *trace = NULL;
+  int cursor = length / 2;
+  for (int i = 0; i < actions; i++) {
+    if (local) {
+      cursor += rand() % 513 - 256;
+    } else {
+      cursor = rand() % (length + 1);
+    }
+    if (cursor < 0) cursor = 0;
+    if (cursor > length) cursor = length;
+    arrput(trace, ((TraceOp){.type = TRACE_SNAPSHOT}));
+    int run = 1 + rand() % 16;
+    if (i % 100 == 99) {
+      arrput(trace, ((TraceOp){.type = TRACE_INSERT, .pos = cursor, .len = 4096}));
+      length += 4096;
+    } else if (rand() % 4 == 0) {
+      for (int j = 0; j < run && cursor > 0; j++) {
+        arrput(trace, ((TraceOp){.type = TRACE_DELETE, .pos = --cursor, .len = 1}));
+        length--;
+      }
+    } else {
+      for (int j = 0; j < run; j++) {
+        arrput(trace, ((TraceOp){.type = TRACE_INSERT, .pos = cursor++, .len = 1}));
+        length++;
+      }
+    }
+  }
+  return trace;
+}
+
+// replays the trace against a storage of the given kind, keeping every
+// snapshot alive as the history of a buffer would, and reports the time per
+// edit, counting the snapshots, and the memory held by the storage and its
+// snapshots
+static RopeNode *replay(StorageType type, RopeNode *root, TraceOp *trace, uint32_t *paste,
+                        const char *name)
+{
+  long before = pool_stats().bytes;
+  uint64_t t = bench_now();
+  Storage *storage = storage_init(type, root);
+  check(storage != NULL, "storage_init");
+  uint64_t t_open = bench_now() - t;
+
+  RopeNode **history = NULL;
+  int edits = 0;
+  t = bench_now();
+  for (int i = 0; i < arrlen(trace); i++) {
+    TraceOp op = trace[i];
+    if (op.type == TRACE_SNAPSHOT) {
+      RopeNode *snapshot = storage_snapshot(storage);
+      check(snapshot != NULL, "snapshot");
+      arrput(history, snapshot);
+    } else if (op.type == TRACE_INSERT) {
+      check(storage_insert(storage, paste, op.len, op.pos), "insert");
+      edits++;
+    } else {
+      check(storage_delete(storage, op.pos, op.len), "delete");
+      edits++;
+    }
+  }
+  uint64_t t_edit = bench_now() - t;
+  long held = pool_stats().bytes - before + storage_bytes(storage);
+
+  // read the whole text back, as saving it would
+  StorageIter iter;
+  uint64_t sum = 0;
+  t = bench_now();
+  if (storage_iter_init(&iter, storage, 0)) {
+    do {
+      for (int i = 0; i < iter.len; i++) sum += iter.chunk[i];
+    } while (storage_iter_next(&iter));
+  }
+  uint64_t t_read = bench_now() - t;
+
+  RopeNode *last = storage_snapshot(storage);
+  check(last != NULL, "snapshot");
+  printf("%-6s %-5s %-8s open=%8.2fms edit=%8.1fns/op (%.2fM ops/s) read=%7.2fms "
+         "memory=%8.1fMiB (%lu)\n",
+         LAYOUT, type == STORAGE_ROPE ? "rope" : "gap", name, t_open / 1e6,
+         (double)t_edit / edits, edits * 1e3 / t_edit, t_read / 1e6, held / 1048576.0,
+         (unsigned long)(sum % 1000));
+  storage_free(storage);
+  for (int i = 0; i < arrlen(history); i++) rope_deref(history[i]);
+  arrfree(history);
+  return last;
+}
+
+// types single characters into a storage of the given kind, which a rope
+// storage edits through its finger, and after each one checks that copying
+// out the text from before the cursor to the end matches indexing it
+static void check_copy_out(StorageType type, RopeNode *root)
+{
+  Storage *storage = storage_init(type, root);
+  check(storage != NULL, "storage_init");
+  int length = storage->length;
+  uint32_t *dst = malloc((length + 1000) * sizeof(uint32_t));
+  int cursor = length / 3;
+  for (int i = 0; i < 1000; i++) {
+    uint32_t c = 'a' + i % 26;
+    check(storage_insert(storage, &c, 1, cursor++), "insert");
+    int start = cursor - 1 - rand() % 64;
+    if (start < 0) start = 0;
+    int len = storage->length - start;
+    check(storage_copy_out(storage, start, len, dst), "copy out");
+    for (int j = 0; j < len; j++) {
+      check(dst[j] == storage_index(storage, start + j), "copy out matches index");
+    }
+  }
+  free(dst);
+  storage_free(storage);
+}
+
+// deletes from and types into a storage of the given kind over text that has
+// never held a newline, which leaves a gap storage without any line breaks,
+// and checks the text against the same edits made to an array
+static void check_no_newlines(StorageType type)
+{
+  uint32_t text[256];
+  for (int i = 0; i < 256; i++) text[i] = 'a' + i % 26;
+  int length = 256;
+  RopeNode *root = rope_build(text, length);
+  check(root != NULL, "build");
+  Storage *storage = storage_init(type, root);
+  check(storage != NULL, "storage_init");
+  rope_deref(root);
+  for (int i = 0; i < 200; i++) {
+    int pos = rand() % length;
+    if (i % 2 == 0) {
+      check(storage_delete(storage, pos, 1), "delete");
+      memmove(text + pos, text + pos + 1, (length - pos - 1) * sizeof(uint32_t));
+      length--;
+    } else {
+      uint32_t c = 'A' + i % 26;
+      check(storage_insert(storage, &c, 1, pos), "insert");
+      memmove(text + pos + 1, text + pos, (length - pos) * sizeof(uint32_t));
+      text[pos] = c;
+      length++;
+    }
+    check(storage->length == length, "length");
+    for (int j = 0; j < length; j++) {
+      check(storage_index(storage, j) == text[j], "text matches");
+    }
+  }
+  storage_free(storage);
+}
+
+/*
+ * Replays the same traces of edits against each kind of storage, on a small
+ * document and on a large one, with the cursor moving locally or jumping
+ * anywhere between actions. Each trace takes a snapshot before every action,
+ * as a buffer does, and the final texts of the two kinds of storage are
+ * checked to be the same. Before that, copying text out of each kind of
+ * storage is checked while single characters are being typed into it, and
+ * editing text without newlines is checked against an array.
+ */
+int main(int argc, char **argv)
+{
+  int small = argc > 1 ? atoi(argv[1]) : 64 * 1024;
+  int large = argc > 2 ? atoi(argv[2]) : 16 * 1024 * 1024;
+  int actions = 20000;
+
+  uint32_t *paste = malloc(4096 * sizeof(uint32_t));
+  for (int i = 0; i < 4096; i++) paste[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+  uint32_t *text = malloc(large * sizeof(uint32_t));
+  for (int i = 0; i < large; i++) text[i] = i % 80 == 79 ? '\n' : 'A' + i % 26;
+
+  RopeNode *sample = rope_build(text, 4096);
+  check(sample != NULL, "build");
+  check_copy_out(STORAGE_ROPE, sample);
+  check_copy_out(STORAGE_GAP, sample);
+  rope_deref(sample);
+  check_no_newlines(STORAGE_ROPE);
+  check_no_newlines(STORAGE_GAP);
+  rope_reclaim(0);
+
+  int sizes[] = {small, large};
+  for (int s = 0; s < 2; s++) {
+    RopeNode *root = rope_build(text, sizes[s]);
+    check(root != NULL, "build");
+    for (int local = 1; local >= 0; local--) {
+      char name[32];
+      snprintf(name, sizeof(name), "%s/%s", sizes[s] == small ? "small" : "large",
+               local ? "local" : "jump");
+      srand(1);
+      TraceOp *trace = make_trace(sizes[s], actions, local);
+      RopeNode *a = replay(STORAGE_ROPE, root, trace, paste, name);
+      RopeNode *b = replay(STORAGE_GAP, root, trace, paste, name);
+      check(rope_equal(a, b), "same text");
+      rope_deref(a);
+      rope_deref(b);
+      arrfree(trace);
+      rope_reclaim(0);
+    }
+    rope_deref(root);
+    rope_reclaim(0);
+  }
+
+  free(text);
+  free(paste);
+  return 0;
+}
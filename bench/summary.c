@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STB_DS_IMPLEMENTATION
+#include "stb_ds.h"
+#include "bench.h"
+#include "rope.h"
+
+// counts the UTF-8 bytes before an index by walking the leaves, which is what
+// converting a position took without summaries
+static int scan_bytes(RopeNode *root, int index)
+{
+  RopeIter iter;
+  int bytes = 0;
+  if (index == 0 || !rope_iter_init(&iter, root, 0)) return 0;
+  do {
+    int len = iter.len < index ? iter.len : index;
+    bytes += rope_summarize(iter.chunk, len).bytes;
+    index -= len;
+  } while (index > 0 && rope_iter_next(&iter));
+  return bytes;
+}
+
+/*
+ * Converts random positions of a large document with mixed scripts between
+ * codepoints, UTF-8 bytes, lines and UTF-16 code units, comparing
+ * rope_measure() and rope_seek() with walking the leaves up to the position.
+ */
+int main(int argc, char **argv)
+{
+  int length = argc > 1 ? atoi(argv[1]) : 50 * 1024 * 1024;
+  int ops = argc > 2 ? atoi(argv[2]) : 100000;
+
+  // lines of 60 characters mixing ASCII, Latin, CJK and emoji
+  static const uint32_t alphabet[] = {'a', 'b', 'c', ' ', 0xe9, 0x4e2d, 0x1f600};
+  uint32_t *text = malloc(length * sizeof(uint32_t));
+  for (int i = 0; i < length; i++) {
+    text[i] = i % 61 == 60 ? '\n' : alphabet[i % 7];
+  }
+  RopeNode *root = rope_build(text, length);
+  free(text);
+
+  uint64_t t = bench_now();
+  RopeSummary summary = rope_summary(root);
+  printf("%-6s summary bytes=%d lines=%d utf16=%d %.1fns\n", LAYOUT, summary.bytes,
+         summary.newlines + 1, summary.utf16, (double)(bench_now() - t));
+
+  // codepoint index to byte offset
+  srand(1);
+  long total = 0;
+  t = bench_now();
+  for (int i = 0; i < ops; i++) total += rope_measure(root, ROPE_BYTES, rand() % length);
+  printf("%-6s measure bytes %.2fus/op\n", LAYOUT, (bench_now() - t) / 1e3 / ops);
+  int scans = ops / 1000 > 0 ? ops / 1000 : 1;
+  t = bench_now();
+  for (int i = 0; i < scans; i++) total += scan_bytes(root, rand() % length);
+  printf("%-6s scan bytes    %.2fus/op\n", LAYOUT, (bench_now() - t) / 1e3 / scans);
+
+  // byte, line and UTF-16 offsets back to codepoint indices
+  static const RopeMetric metrics[] = {ROPE_BYTES, ROPE_NEWLINES, ROPE_UTF16};
+  static const char *names[] = {"bytes", "lines", "utf16"};
+  int limits[] = {summary.bytes, summary.newlines, summary.utf16};
+  for (int m = 0; m < 3; m++) {
+    t = bench_now();
+    for (int i = 0; i < ops; i++) total += rope_seek(root, metrics[m], rand() % limits[m]);
+    printf("%-6s seek %-8s %.2fus/op\n", LAYOUT, names[m], (bench_now() - t) / 1e3 / ops);
+  }
+
+  printf("%-6s (%ld)\n", LAYOUT, total);
+  rope_deref(root);
+  return 0;
+}
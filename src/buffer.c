@@ -9,8 +9,9 @@
 #include "glyph.h"
 #include "rope.h"
 #include "stb_ds.h"
+#include "storage.h"
 
-Buffer *buffer_init(void)
+Buffer *buffer_init(StorageType type)
 {
   // allocate and initialize the buffer
   Buffer *buffer = malloc(sizeof(Buffer));
@@ -18,21 +19,51 @@ Buffer *buffer_init(void)
     SDL_SetError("Failed to allocate memory for buffer");
     return NULL;
   }
+  buffer->storage = NULL;
   buffer->ropes = NULL;
+  buffer->sizes = NULL;
+  buffer->history_bytes = 0;
+  buffer->max_versions = BUFFER_MAX_VERSIONS;
+  buffer->max_bytes = BUFFER_MAX_BYTES;
   buffer->text = NULL;
-  arrput(buffer->ropes, NULL);
+  buffer->undo = NULL;
+  buffer->redo = NULL;
 
-  // create empty rope as the default first rope
+  // create the storage holding an empty document
   RopeNode *empty_rope = rope_build(NULL, 0);
   if (empty_rope == NULL) {
     buffer_free(buffer);
     return NULL;
   }
-  arrput(buffer->ropes[0], empty_rope);
+  buffer->storage = storage_init(type, empty_rope);
+  rope_deref(empty_rope);
+  if (buffer->storage == NULL) {
+    buffer_free(buffer);
+    return NULL;
+  }
 
-  // create undo and redo dynamic arrays
-  buffer->undo = NULL;
-  buffer->redo = NULL;
+  return buffer;
+}
+
+Buffer *buffer_open(const char *path, StorageType type)
+{
+  Buffer *buffer = buffer_init(type);
+  if (buffer == NULL) return NULL;
+
+  // replace the empty storage with one holding the text of the file
+  RopeNode *root = rope_map(path);
+  if (root == NULL) {
+    buffer_free(buffer);
+    return NULL;
+  }
+  Storage *storage = storage_init(type, root);
+  rope_deref(root);
+  if (storage == NULL) {
+    buffer_free(buffer);
+    return NULL;
+  }
+  storage_free(buffer->storage);
+  buffer->storage = storage;
   return buffer;
 }
 
@@ -41,26 +72,19 @@ void buffer_free(Buffer *buffer)
   // guard against null
   if (buffer == NULL) return;
 
-  // free the ropes
-  if (buffer->ropes != NULL) {
-    for (int i = 0; i < arrlen(buffer->ropes); i++) {
-      if (buffer->ropes[i] != NULL) {
-        for (int j = 0; j < arrlen(buffer->ropes[i]); j++) {
-          rope_deref(buffer->ropes[i][j]);
-        }
-      }
-      arrfree(buffer->ropes[i]);
-    }
-    arrfree(buffer->ropes);
+  // free the storage and the earlier versions of the document
+  storage_free(buffer->storage);
+  for (int i = 0; i < arrlen(buffer->ropes); i++) {
+    rope_deref(buffer->ropes[i]);
   }
+  arrfree(buffer->ropes);
+  arrfree(buffer->sizes);
 
   // free the cached text
-  if (buffer->text != NULL) {
-    for (int i = 0; i < arrlen(buffer->text); i++) {
-      arrfree(buffer->text[i]);
-    }
-    arrfree(buffer->text);
+  for (int i = 0; i < arrlen(buffer->text); i++) {
+    arrfree(buffer->text[i]);
   }
+  arrfree(buffer->text);
 
   // free the undo and redo stacks
   arrfree(buffer->undo);
@@ -76,14 +100,14 @@ bool buffer_validate(Buffer *buffer, int line)
     return false;
   }
 
-  // make sure the 2d array of ropes is initialized
-  if (buffer->ropes == NULL) {
+  // make sure the storage is initialized
+  if (buffer->storage == NULL) {
     SDL_SetError("Buffer is not initialized properly");
     return false;
   }
 
   // make sure the line doesn't exceed the total number of lines in the buffer
-  if (arrlen(buffer->ropes) <= line) {
+  if (line < 0 || buffer_lines(buffer) <= line) {
     SDL_SetError("Line exceeds buffer size");
     return false;
   }
@@ -91,42 +115,112 @@ bool buffer_validate(Buffer *buffer, int line)
   return true;
 }
 
-bool buffer_newline(Buffer *buffer, struct Cursor *cursor)
+// returns the offset within the document of the given line and index, or -1
+// if the line does not exist
+static int buffer_offset(Buffer *buffer, int line, int idx)
 {
-  // make sure the 2d array of ropes is initialized
-  if (buffer->ropes == NULL) {
-    SDL_SetError("Buffer is not initialized properly");
-    return false;
+  int start = storage_line_start(buffer->storage, line);
+  if (start < 0) return -1;
+  return start + idx + 1;
+}
+
+// drops the version at the given index along with its action, so that the
+// action before it, if any, undoes both, and measures again the memory that
+// the versions on either side hold alone, which may have grown
+static void buffer_drop(Buffer *buffer, int i)
+{
+  buffer->history_bytes -= buffer->sizes[i];
+  rope_deref(buffer->ropes[i]);
+  arrdel(buffer->ropes, i);
+  arrdel(buffer->sizes, i);
+  arrdel(buffer->undo, i);
+  int last = arrlen(buffer->ropes) - 1;
+  for (int j = i > 0 ? i - 1 : 0; j <= i && j < last; j++) {
+    long bytes = rope_unique_bytes(buffer->ropes[j]);
+    buffer->history_bytes += bytes - buffer->sizes[j];
+    buffer->sizes[j] = bytes;
   }
+}
 
-  // split the rope at the current cursor index
-  int line_size = arrlen(buffer->ropes[cursor->line]);
-  RopeNode **roots = rope_split(buffer->ropes[cursor->line][line_size - 1], cursor->idx);
-  if (roots == NULL) return false;
+// drops versions until the history fits within its limits. Past the limit on
+// versions, every other version in the older half is merged into the one
+// before it, so that the older a version is, the further apart the kept
+// checkpoints are. Past the limit on memory, the oldest versions are dropped.
+static void buffer_compact(Buffer *buffer)
+{
+  if (arrlen(buffer->ropes) > buffer->max_versions) {
+    for (int i = arrlen(buffer->ropes) / 2 - 1; i > 0; i -= 2) buffer_drop(buffer, i);
+    while (arrlen(buffer->ropes) > buffer->max_versions) buffer_drop(buffer, 0);
+  }
+  while (buffer->history_bytes > buffer->max_bytes && arrlen(buffer->ropes) > 1) {
+    buffer_drop(buffer, 0);
+  }
+}
 
-  // add pre-split rope to current line, and post-split rope to new line
-  arrput(buffer->ropes[cursor->line], roots[0]);
-  stbds_arrinsn(buffer->ropes, (size_t)(cursor->line + 1), (size_t)1);
-  buffer->ropes[cursor->line + 1] = NULL;
-  arrput(buffer->ropes[cursor->line + 1], roots[1]);
+// adds the version of the document from before a new action to the history
+// along with the action. The version before it has stopped changing, so the
+// memory it holds alone is measured now, while the new version is counted once
+// the next one is added.
+static void buffer_record(Buffer *buffer, RopeNode *before, Action action)
+{
+  if (arrlen(buffer->ropes) > 0) {
+    long bytes = rope_unique_bytes(arrlast(buffer->ropes));
+    buffer->history_bytes += bytes - arrlast(buffer->sizes);
+    arrlast(buffer->sizes) = bytes;
+  }
+  arrput(buffer->ropes, before);
+  arrput(buffer->sizes, 0);
+  arrput(buffer->undo, action);
+  buffer_compact(buffer);
+}
 
-  // rebuild text cache
-  for (int i = 0; i < arrlen(buffer->ropes); i++) {
-    buffer_text(buffer, i);
+void buffer_set_history(Buffer *buffer, int max_versions, long max_bytes)
+{
+  buffer->max_versions = max_versions < 1 ? 1 : max_versions;
+  buffer->max_bytes = max_bytes;
+  buffer_compact(buffer);
+}
+
+// returns the last action if an action of the given type at the given line
+// and index continues it, or NULL if it does not
+static Action *buffer_run(Buffer *buffer, ActionType type, int line, int idx)
+{
+  if (arrlen(buffer->undo) == 0) return NULL;
+  Action *last = &arrlast(buffer->undo);
+  int end = type == ACTION_INSERT ? last->idx + last->count : last->idx - last->count;
+  if (last->type != type || last->line != line || end != idx) return NULL;
+  return last;
+}
+
+bool buffer_newline(Buffer *buffer, struct Cursor *cursor)
+{
+  // check if buffer is valid with the parameters given
+  if (!buffer_validate(buffer, cursor->line)) return false;
+
+  // insert a newline at the cursor, which splits the line in two
+  int offset = buffer_offset(buffer, cursor->line, cursor->idx);
+  if (offset < 0) return false;
+  RopeNode *before = storage_snapshot(buffer->storage);
+  if (before == NULL) return false;
+  uint32_t newline = '\n';
+  if (!storage_insert(buffer->storage, &newline, 1, offset)) {
+    rope_deref(before);
+    return false;
   }
 
   // store action
   Action action = {
     .type = ACTION_NEWLINE,
     .line = cursor->line,
-    .idx = cursor->idx
+    .idx = cursor->idx,
+    .count = 1,
+    .offset = offset
   };
-  arrput(buffer->undo, action);
+  buffer_record(buffer, before, action);
 
   // update cursor location
   cursor->line++;
   cursor->idx = -1;
-  free(roots);
   return true;
 }
 
@@ -139,25 +233,89 @@ bool buffer_insert(Buffer *buffer, struct Cursor *cursor, uint32_t c)
   // check if buffer is valid with the parameters given
   if (!buffer_validate(buffer, line)) return false;
 
-  // create new rope by inserting character at given index on the line
-  int line_size = arrlen(buffer->ropes[line]);
-  RopeNode *new_rope = rope_insert(buffer->ropes[line][line_size - 1], c, idx);
-  if (new_rope == NULL) return false;
+  // continue a run of typing without taking a snapshot, at the end of the
+  // run so that the line does not have to be found again
+  Action *run = buffer_run(buffer, ACTION_INSERT, line, idx);
+  if (run != NULL) {
+    int offset = run->offset + run->count;
+    if (!storage_insert(buffer->storage, &c, 1, offset)) return false;
+    run->count++;
+    cursor->idx++;
+    return true;
+  }
+
+  // otherwise save the document and insert the character at the cursor
+  int offset = buffer_offset(buffer, line, idx);
+  if (offset < 0) return false;
+  RopeNode *before = storage_snapshot(buffer->storage);
+  if (before == NULL) return false;
+  if (!storage_insert(buffer->storage, &c, 1, offset)) {
+    rope_deref(before);
+    return false;
+  }
 
   // store action
   Action action = {
     .type = ACTION_INSERT,
     .line = line,
-    .idx = idx
+    .idx = idx,
+    .count = 1,
+    .offset = offset
   };
-  arrput(buffer->undo, action);
+  buffer_record(buffer, before, action);
 
-  // add to the line array and update cursor
-  arrput(buffer->ropes[line], new_rope);
+  // update cursor
   cursor->idx++;
   return true;
 }
 
+bool buffer_insert_text(Buffer *buffer, struct Cursor *cursor, uint32_t *text, int len)
+{
+  // single characters continue a run of typing
+  if (len == 0) return true;
+  if (len == 1 && text[0] != '\n') return buffer_insert(buffer, cursor, text[0]);
+
+  // get line and idx from cursor
+  int line = cursor->line;
+  int idx = cursor->idx;
+
+  // check if buffer is valid with the parameters given
+  if (!buffer_validate(buffer, line)) return false;
+
+  // splice the text into the document at the cursor
+  int offset = buffer_offset(buffer, line, idx);
+  if (offset < 0) return false;
+  RopeNode *before = storage_snapshot(buffer->storage);
+  if (before == NULL) return false;
+  if (!storage_insert(buffer->storage, text, len, offset)) {
+    rope_deref(before);
+    return false;
+  }
+
+  // store action
+  Action action = {
+    .type = ACTION_INSERT,
+    .line = line,
+    .idx = idx,
+    .count = len,
+    .offset = offset
+  };
+  buffer_record(buffer, before, action);
+
+  // move the cursor to the end of the inserted text
+  int newlines = 0;
+  int last = -1;
+  for (int i = 0; i < len; i++) {
+    if (text[i] == '\n') {
+      newlines++;
+      last = i;
+    }
+  }
+  cursor->line += newlines;
+  cursor->idx = newlines == 0 ? idx + len : len - last - 2;
+  return true;
+}
+
 bool buffer_delete(Buffer *buffer, struct Cursor *cursor)
 {
   // get line and idx from cursor
@@ -167,38 +325,95 @@ bool buffer_delete(Buffer *buffer, struct Cursor *cursor)
   // check if buffer is valid with the parameters given
   if (!buffer_validate(buffer, line)) return false;
 
-  // create new rope by deleting the character at the given index and line
-  int line_size = arrlen(buffer->ropes[line]);
-  RopeNode *new_rope = rope_delete(buffer->ropes[line][line_size - 1], idx);
-  if (new_rope == NULL) return false;
+  // continue a run of deletes without taking a snapshot
+  Action *run = buffer_run(buffer, ACTION_DELETE, line, idx);
+  if (run != NULL && idx > -1) {
+    int offset = run->offset - run->count;
+    if (!storage_delete(buffer->storage, offset - 1, 1)) return false;
+    run->count++;
+    cursor->idx--;
+    return true;
+  }
+
+  // otherwise save the document and delete the character before the cursor,
+  // which is the newline ending the previous line if the cursor is at the
+  // start of a line
+  int offset = buffer_offset(buffer, line, idx);
+  if (offset < 0) return false;
+  if (offset == 0) {
+    SDL_SetError("Cannot delete before the start of the buffer");
+    return false;
+  }
+  int prev_length = idx > -1 ? 0 : buffer_line_length(buffer, line - 1);
+  RopeNode *before = storage_snapshot(buffer->storage);
+  if (before == NULL) return false;
+  if (!storage_delete(buffer->storage, offset - 1, 1)) {
+    rope_deref(before);
+    return false;
+  }
   
   // store action
   Action action = {
     .type = ACTION_DELETE,
     .line = line,
-    .idx = idx
+    .idx = idx,
+    .count = 1,
+    .offset = offset
   };
-  arrput(buffer->undo, action);
+  buffer_record(buffer, before, action);
 
-  // add to the line array and update cursor
-  arrput(buffer->ropes[line], new_rope);
-  cursor->idx--;
+  // update cursor, moving it to the end of the previous line if the lines
+  // were joined
+  if (idx > -1) {
+    cursor->idx--;
+  } else {
+    cursor->line--;
+    cursor->idx = prev_length - 1;
+  }
   return true;
 }
 
-bool buffer_text(Buffer *buffer, int line)
+int buffer_lines(Buffer *buffer)
+{
+  return buffer->storage->newlines + 1;
+}
+
+int buffer_line_length(Buffer *buffer, int line)
+{
+  // find the start of the line and of the line after it
+  Storage *storage = buffer->storage;
+  int start = buffer_offset(buffer, line, -1);
+  if (start < 0) return -1;
+  if (line == storage->newlines) return storage->length - start;
+  return storage_line_start(storage, line + 1) - 1 - start;
+}
+
+bool buffer_text(Buffer *buffer, int first, int count)
 {
-  // append to text array if line exceeds bounds
-  if (line >= arrlen(buffer->text)) {
-    arrput(buffer->text, NULL);
+  // stop at the end of the document
+  if (first < 0 || first > buffer_lines(buffer)) {
+    SDL_SetError("Line exceeds buffer size");
+    return false;
   }
+  if (count > buffer_lines(buffer) - first) count = buffer_lines(buffer) - first;
 
-  // update the given line in the cache
-  int line_size = arrlen(buffer->ropes[line]);
-  uint32_t *text = rope_text(buffer->ropes[line][line_size - 1]);
-  arrfree(buffer->text[line]);
-  buffer->text[line] = text;
-  
+  // resize the cache to the number of lines, freeing lines that are dropped
+  for (int i = count; i < arrlen(buffer->text); i++) {
+    arrfree(buffer->text[i]);
+  }
+  int cached = arrlen(buffer->text);
+  arrsetlen(buffer->text, count);
+  for (int i = cached; i < count; i++) {
+    buffer->text[i] = NULL;
+  }
+
+  // update each line in the cache, reusing its array
+  for (int i = 0; i < count; i++) {
+    int length = buffer_line_length(buffer, first + i);
+    if (length < 0) return false;
+    arrsetlen(buffer->text[i], length);
+    int start = storage_line_start(buffer->storage, first + i);
+    if (!storage_copy_out(buffer->storage, start, length, buffer->text[i])) return false;
+  }
   return true;
 }
-
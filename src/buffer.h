@@ -5,9 +5,18 @@
 #include <stdint.h>
 
 #include "rope.h"
+#include "storage.h"
 
 struct Cursor;
 
+// Determines how many versions of the document a buffer keeps by default
+// before merging the older ones into checkpoints.
+#define BUFFER_MAX_VERSIONS 1024
+
+// Determines how many bytes of nodes the versions of the document may hold by
+// default, beyond what the newest version shares with them.
+#define BUFFER_MAX_BYTES (64L * 1024 * 1024)
+
 typedef enum {
   ACTION_INSERT,
   ACTION_DELETE,
@@ -20,33 +29,58 @@ typedef enum {
  * @type: The type of action performed.
  * @line: The line the cursor was on before the action was performed.
  * @idx: The character index the cursor was on before the action.
+ * @count: The number of characters inserted or deleted by the action.
+ * @offset: The offset of the cursor within the document before the action.
  *
  * This is a struct to hold information about a particular action that was
- * performed. It is meant to be stored into a dynamic array in order to
- * keep a history of previous actions and allow undo and redo functionality.
+ * performed. A run of characters typed or deleted one after another at the
+ * cursor is stored as a single action. It is meant to be stored into a dynamic
+ * array in order to keep a history of previous actions and allow undo and redo
+ * functionality.
  */
 typedef struct Action {
   ActionType type;
   int line;
   int idx;
+  int count;
+  int offset;
 } Action;
 
 /**
- * struct Buffer - Stores rope tree and cached text for the buffer.
+ * struct Buffer - Stores the text of the document and its history.
  *
- * @ropes: A 2D dynamic array of ropes.
+ * @storage: The storage holding the newest version of the document.
+ * @ropes: A dynamic array of earlier versions of the document rope.
+ * @sizes: A dynamic array of the number of bytes each version holds that no
+ * other version or the storage shares, measured with rope_unique_bytes() once
+ * the version after it is added, and counted as 0 until then.
+ * @history_bytes: The sum of the sizes of the versions.
+ * @max_versions: The most versions to keep.
+ * @max_bytes: The most bytes the versions may hold.
  * @text: A 2D dynamic array of unicode codepoints.
  * @undo: A dynamic array of action history.
  * @redo: A dynamic array of undo history.
  *
- * This is a struct to hold information about a buffer. It holds a 2D
- * dynamic array of ropes, where subarray of ropes represents a different
- * line in the buffer, and the last rope in each subarray is the newest
- * version of that line. It also caches text in each line for efficiency,
- * with each subarray representing a different line.
+ * This is a struct to hold information about a buffer. The whole document is
+ * held in a storage, with lines separated by newline characters, and every
+ * edit goes through the storage functions, so the kind of storage can be
+ * chosen for each buffer. Before each action, a snapshot of the document is
+ * taken with storage_snapshot() and added to the dynamic array of ropes, so
+ * that the version at index i is the document before the action at index i
+ * of the undo history. A run of typing at the cursor is a single action, so
+ * it does not add a version for every character. The history is kept within
+ * a number of versions and a number of bytes, set with buffer_set_history(),
+ * by dropping versions and the nodes only they hold. The text of the lines
+ * being displayed is cached for efficiency, with each subarray representing
+ * a different line.
  */
 typedef struct Buffer {
-  RopeNode ***ropes;
+  Storage *storage;
+  RopeNode **ropes;
+  long *sizes;
+  long history_bytes;
+  int max_versions;
+  long max_bytes;
   uint32_t **text;
   Action *undo;
   Action *redo;
@@ -55,25 +89,61 @@ typedef struct Buffer {
 /**
  * buffer_init() - Initializes a new Buffer struct.
  *
+ * @type: The kind of storage to hold the document in.
+ *
  * This function initializes a new Buffer struct by allocating memory
  * for it and returning the pointer. By default, it initializes the
- * rope array with an empty rope as the first element in the first line.
- * This function returns NULL if it fails. For error information, use
+ * storage with an empty document. This function returns NULL if it fails.
+ * For error information, use SDL_GetError().
+ */
+Buffer *buffer_init(StorageType type);
+
+/**
+ * buffer_open() - Initializes a new Buffer struct holding a file.
+ *
+ * @path: The path of the UTF-8 file to open.
+ * @type: The kind of storage to hold the document in.
+ *
+ * This function initializes a new Buffer struct in the same way as
+ * buffer_init(), except that the document starts with the text of the file,
+ * which is read with rope_map() so that a rope storage does not copy it. This
+ * function returns NULL if it fails. For error information, use
  * SDL_GetError().
  */
-Buffer *buffer_init(void);
+Buffer *buffer_open(const char *path, StorageType type);
 
 /**
  * buffer_free() - Frees a Buffer struct.
  *
  * @buffer: The Buffer struct to be freed.
  *
- * This function frees all of the stored rope nodes with rope_deref() and
- * then frees the dynamic arrays holding the nodes. It also frees the
- * dynamic array of text. If NULL is passed, nothing will happen.
+ * This function frees the storage and every earlier version of the document
+ * with rope_deref(), and then frees the dynamic array holding them. It also
+ * frees the dynamic array of text. If NULL is passed, nothing will happen.
  */
 void buffer_free(Buffer *buffer);
 
+/**
+ * buffer_set_history() - Sets the limits on the history of a buffer.
+ *
+ * @buffer: The Buffer struct to use.
+ * @max_versions: The most versions of the document to keep, at least one.
+ * @max_bytes: The most bytes of nodes the versions may hold alone.
+ *
+ * This function sets how much of its history the buffer keeps, and drops
+ * versions right away if it has more. Whenever there are more versions than
+ * allowed, every other version in the older half is merged into the one
+ * before it, so that a single undo goes back over both of their actions, and
+ * the kept versions get further apart the older they are. Whenever the
+ * versions hold more memory than allowed, the oldest ones are dropped. The
+ * memory of a version only counts the nodes that no other version shares, so
+ * a long run of typing in one place costs little, and nodes shared by several
+ * old versions are only counted once all but one of them are dropped. The nodes
+ * only a dropped version held are released with rope_deref(). The limits
+ * default to BUFFER_MAX_VERSIONS and BUFFER_MAX_BYTES.
+ */
+void buffer_set_history(Buffer *buffer, int max_versions, long max_bytes);
+
 /**
  * buffer_validate() - Validates a buffer using the given parameters.
  *
@@ -92,11 +162,10 @@ bool buffer_validate(Buffer *buffer, int line);
  * @buffer: The Buffer struct to use.
  * @cursor: The Cursor struct to update.
  *
- * This function inserts a new line into the dynamic array of ropes in the
- * Buffer struct. By default, it initializes the first rope of the new line
- * to be an empty rope. It will also automatically update the state of the
- * cursor to be on the new line. It returns true on success and false on
- * failure. For error information, use SDL_GetError().
+ * This function splits the line at the cursor by inserting a newline into
+ * the document with storage_insert(). It will also automatically update the
+ * state of the cursor to be on the new line. It returns true on success and
+ * false on failure. For error information, use SDL_GetError().
  */
 bool buffer_newline(Buffer *buffer, struct Cursor *cursor);
 
@@ -110,12 +179,31 @@ bool buffer_newline(Buffer *buffer, struct Cursor *cursor);
  * This function inserts a character into the buffer at the given line,
  * which is zero-indexed, and at a given index within that line. The index
  * and line is given within the Cursor struct that is passed in. It does
- * this by creating a new rope using rope_insert() and saving it into the
- * array of ropes. It returns true on success and false on failure. For
- * error information, use SDL_GetError().
+ * this by saving a snapshot of the document into the array of ropes and
+ * inserting the character with storage_insert(). If the character continues
+ * a run of typing, it is inserted without taking another snapshot. It
+ * returns true on success and false on failure. For error information, use
+ * SDL_GetError().
  */
 bool buffer_insert(Buffer *buffer, struct Cursor *cursor, uint32_t c);
 
+/**
+ * buffer_insert_text() - Inserts an array of text into the buffer.
+ *
+ * @buffer: The Buffer struct to use.
+ * @cursor: The Cursor struct to update.
+ * @text: The array of unicode codepoints representing text.
+ * @len: The length of the array.
+ *
+ * This function inserts text, such as a paste or a burst of typed characters,
+ * at the position of the cursor. The text is inserted into the document at
+ * once using storage_insert(), newlines and all, rather than inserting one
+ * character at a time. The insert is stored as a single
+ * action, and the cursor is moved to the end of the text. It returns true on
+ * success and false on failure. For error information, use SDL_GetError().
+ */
+bool buffer_insert_text(Buffer *buffer, struct Cursor *cursor, uint32_t *text, int len);
+
 /**
  * buffer_delete() - Deletes a character in the buffer.
  *
@@ -123,25 +211,54 @@ bool buffer_insert(Buffer *buffer, struct Cursor *cursor, uint32_t c);
  * @cursor: The Cursor struct to update.
  *
  * This function deletes a character in a buffer at the given line
- * and index in the Cursor struct. It does this by creating a new rope
- * using rope_delete() and saving it into the array of ropes. It returns
- * true on success and false on failure. For error information, use
+ * and index in the Cursor struct. It does this by saving a snapshot of the
+ * document into the array of ropes and deleting the character with
+ * storage_delete(), without taking another snapshot if it continues a run of
+ * deletes. If the cursor is at the start of a line, the newline before
+ * it is deleted instead, joining the line onto the end of the previous one. It
+ * returns true on success and false on failure. For error information, use
  * SDL_GetError().
  */
 bool buffer_delete(Buffer *buffer, struct Cursor *cursor);
 
+/**
+ * buffer_lines() - Gets the number of lines in the buffer.
+ *
+ * @buffer: The Buffer struct to use.
+ *
+ * This function returns the number of lines in the buffer, which is one more
+ * than the number of newlines in the document.
+ */
+int buffer_lines(Buffer *buffer);
+
+/**
+ * buffer_line_length() - Gets the length of a line in the buffer.
+ *
+ * @buffer: The Buffer struct to use.
+ * @line: The line to measure (zero-indexed).
+ *
+ * This function returns the number of characters in the given line, not
+ * counting the newline that ends it, using storage_line_start(). It returns -1
+ * if the line does not exist. For error information, use SDL_GetError().
+ */
+int buffer_line_length(Buffer *buffer, int line);
+
 /**
  * buffer_text() - Update the cache of text in the buffer.
  *
  * @buffer: The Buffer struct to use.
- * @line: The line to update.
+ * @first: The first line to cache.
+ * @count: The number of lines to cache.
  *
- * This function updates the cached text in the buffer for the line
- * given. It does this by calling rope_text() on the given line and
- * replacing the correct element within the text dynamic array. This
- * function returns true on success and false on failure. For error
- * information, use SDL_GetError().
+ * This function updates the cached text in the buffer, so that each subarray
+ * holds one of the given lines in order, stopping early at the end of the
+ * document. It does this by resizing the cached dynamic array of each line to
+ * the length of the line, and copying the text of the document into it with
+ * storage_copy_out(), so the arrays are only reallocated when a line grows.
+ * Only the lines that are displayed need to be cached, so the cost does not
+ * depend on the size of the document. This function returns true on success and
+ * false on failure. For error information, use SDL_GetError().
  */
-bool buffer_text(Buffer *buffer, int line);
+bool buffer_text(Buffer *buffer, int first, int count);
 
 #endif // BUFFER_H
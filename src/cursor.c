@@ -7,7 +7,6 @@
 #include "buffer.h"
 #include "cursor.h"
 #include "glyph.h"
-#include "stb_ds.h"
 
 bool render_cursor(SDL_Renderer *renderer, Cursor *cursor, Glyphs *glyphs)
 {
@@ -42,18 +41,18 @@ void move_cursor(Cursor *cursor, Buffer *buffer, SDL_Keycode key)
   // handle cursor move to the right
   else if (key == SDLK_RIGHT) {
     // stop movement if cursor is at the end of the line
-    int line_length = arrlen(buffer->text[cursor->line]);
+    int line_length = buffer_line_length(buffer, cursor->line);
     if (cursor->idx != line_length - 1) cursor->idx++;
   }
 
   // handle cursor move upwards if current line is not the top line
   else if (key == SDLK_UP && cursor->line != 0) {
     // move the cursor up by a line
-    int line_length = arrlen(buffer->text[cursor->line]);
+    int line_length = buffer_line_length(buffer, cursor->line);
     cursor->line--;
 
     // if the cursor was originally at the end of the line, preserve that
-    int new_length = arrlen(buffer->text[cursor->line]);
+    int new_length = buffer_line_length(buffer, cursor->line);
     if (cursor->idx == line_length - 1) {
       cursor->idx = new_length - 1;
     }
@@ -65,13 +64,13 @@ void move_cursor(Cursor *cursor, Buffer *buffer, SDL_Keycode key)
   }
 
   // handle cursor move downwards if current line is not the bottom line
-  else if (key == SDLK_DOWN && cursor->line != arrlen(buffer->text) - 1) {
+  else if (key == SDLK_DOWN && cursor->line != buffer_lines(buffer) - 1) {
     // move the cursor down by a line
-    int line_length = arrlen(buffer->text[cursor->line]);
+    int line_length = buffer_line_length(buffer, cursor->line);
     cursor->line++;
 
     // if the cursor was originally at the end of the line, preserve that
-    int new_length = arrlen(buffer->text[cursor->line]);
+    int new_length = buffer_line_length(buffer, cursor->line);
     if (cursor->idx == line_length - 1) {
       cursor->idx = new_length - 1;
     }
@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <SDL3/SDL_clipboard.h>
 #include <SDL3/SDL_init.h>
 #include <SDL3/SDL_keyboard.h>
 #include <SDL3/SDL_render.h>
@@ -18,6 +19,7 @@
 
 #define INIT_WIDTH 1080
 #define INIT_HEIGHT 720
+#define RECLAIM_BUDGET 2000000
 #define FONT_FILE "/usr/share/fonts/TTF/JetBrainsMonoNerdFontMono-Regular.ttf"
 #define pse()                                                                  \
   printf("Error: %s", SDL_GetError());                                         \
@@ -29,8 +31,24 @@ SDL_Window *window = NULL;
 SDL_Renderer *renderer = NULL;
 Glyphs *glyphs = NULL;
 Buffer *buffer = NULL;
+uint32_t *typed = NULL;
 
-int main(void)
+// decodes UTF-8 text and appends its unicode codepoints to a dynamic array,
+// dropping carriage returns so that pasted line endings become newlines
+static void decode_text(uint32_t **codepoints, const char *text)
+{
+  int len = (int)SDL_strlen(text);
+  int start = (int)arrlen(*codepoints);
+  uint32_t *dst = arraddnptr(*codepoints, len);
+  int count = rope_decode_utf8(text, len, dst, len);
+  int kept = 0;
+  for (int i = 0; i < count; i++) {
+    if (dst[i] != '\r') dst[kept++] = dst[i];
+  }
+  arrsetlen(*codepoints, start + kept);
+}
+
+int main(int argc, char **argv)
 {
   // code to return from the program with
   int code = 0; 
@@ -70,8 +88,8 @@ int main(void)
     pse();
   }
 
-  // initialize the buffer
-  buffer = buffer_init();
+  // initialize the buffer, with the text of the file given, if any
+  buffer = argc > 1 ? buffer_open(argv[1], STORAGE_ROPE) : buffer_init(STORAGE_ROPE);
   if (buffer == NULL) {
     pse();
   }
@@ -83,6 +101,11 @@ int main(void)
   if (!SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND)) {
     pse();
   }  
+
+  // receive typed characters as text input events
+  if (!SDL_StartTextInput(window)) {
+    pse();
+  }
   
   // event loop with quit event state
   bool quit = false;
@@ -90,30 +113,72 @@ int main(void)
     // handle events by repeatedly polling from event queue
     SDL_Event event;
     SDL_Keycode key;
+    char *clipboard;
+    uint32_t *pasted;
+    int start;
     while (SDL_PollEvent(&event)) {
+      // insert any typed characters before handling a key press that does
+      // not type text itself, so that a burst of typing stays together
+      if (event.type == SDL_EVENT_KEY_DOWN) {
+        key = SDL_GetKeyFromScancode(event.key.scancode, event.key.mod, false);
+        bool types = validate_glyphs(key) &&
+                     !(event.key.mod & (SDL_KMOD_CTRL | SDL_KMOD_ALT | SDL_KMOD_GUI));
+        if (!types && arrlen(typed) > 0) {
+          if (!buffer_insert_text(buffer, &cursor, typed, arrlen(typed))) {
+            pse();
+          }
+          arrfree(typed);
+        }
+      }
+
       switch (event.type) {
       case SDL_EVENT_QUIT:
         quit = true;
         break;
+      case SDL_EVENT_TEXT_INPUT:
+        // collect typed characters so that a burst of them is inserted at once
+        start = arrlen(typed);
+        decode_text(&typed, event.text.text);
+        for (int i = arrlen(typed) - 1; i >= start; i--) {
+          if (!validate_glyphs(typed[i])) arrdel(typed, i);
+        }
+        break;
       case SDL_EVENT_KEY_DOWN:
-        key = SDL_GetKeyFromScancode(event.key.scancode, event.key.mod, false);
         if (event.key.key == SDLK_RETURN) {
-          buffer_newline(buffer, &cursor);
-        } else if (event.key.key == SDLK_BACKSPACE && cursor.idx > -1) {
+          if (!buffer_newline(buffer, &cursor)) {
+            pse();
+          }
+        } else if (event.key.key == SDLK_BACKSPACE &&
+                   (cursor.idx > -1 || cursor.line > 0)) {
           if (!buffer_delete(buffer, &cursor)) {
             pse();
           }
-        } else if (validate_glyphs(key)) {
-          if (!buffer_insert(buffer, &cursor, key)) {
+        } else if (event.key.key == SDLK_V && (event.key.mod & SDL_KMOD_CTRL)) {
+          // paste the clipboard as a single insert
+          pasted = NULL;
+          clipboard = SDL_GetClipboardText();
+          decode_text(&pasted, clipboard);
+          SDL_free(clipboard);
+          bool pasted_ok = buffer_insert_text(buffer, &cursor, pasted, arrlen(pasted));
+          arrfree(pasted);
+          if (!pasted_ok) {
             pse();
           }
-        } else {
+        } else if (!validate_glyphs(key)) {
           move_cursor(&cursor, buffer, event.key.key);
         }
         break;
       }
     }
 
+    // insert the characters typed during this frame
+    if (arrlen(typed) > 0) {
+      if (!buffer_insert_text(buffer, &cursor, typed, arrlen(typed))) {
+        pse();
+      }
+      arrfree(typed);
+    }
+
     // set drawing color to white
     if (!SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255)) {
       pse();
@@ -124,8 +189,12 @@ int main(void)
       pse();
     }
 
-    // render the typed text
-    if (!buffer_text(buffer, cursor.line)) {
+    // cache the text of the lines that fit in the window, and render it
+    int width, height;
+    if (!SDL_GetWindowSize(window, &width, &height)) {
+      pse();
+    }
+    if (!buffer_text(buffer, 0, (height - PADDING) / glyphs->height + 1)) {
       pse();
     }
     if (!render_text(glyphs, renderer, buffer->text)) {
@@ -146,11 +215,17 @@ int main(void)
     if (!SDL_RenderPresent(renderer)) {
       pse();
     }
+
+    // free the nodes of ropes that were released, spending at most 2ms per
+    // frame so that closing a large buffer is spread over several frames
+    rope_reclaim(RECLAIM_BUDGET);
   }
 
   // cleanup
  cleanup:
+  arrfree(typed);
   buffer_free(buffer);
+  rope_reclaim(0);
   free_glyphs(glyphs);
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
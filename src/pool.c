@@ -0,0 +1,301 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_thread.h>
+
+#include "pool.h"
+
+// poison freed blocks so that address sanitizer still catches use after free
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#define POOL_POISON(ptr, size) ASAN_POISON_MEMORY_REGION(ptr, size)
+#define POOL_UNPOISON(ptr, size) ASAN_UNPOISON_MEMORY_REGION(ptr, size)
+#else
+#define POOL_POISON(ptr, size) ((void)(ptr), (void)(size))
+#define POOL_UNPOISON(ptr, size) ((void)(ptr), (void)(size))
+#endif
+
+// Size classes step by a factor of 1.5 and 2 in turn: 16, 24, 32, 48, ...
+#define POOL_MIN_BLOCK 16
+#define POOL_CLASSES 19
+
+// A free block, which stores the next free block of its size class.
+typedef struct PoolBlock {
+  struct PoolBlock *next;
+} PoolBlock;
+
+// The header at the start of each slab, which links all of the slabs together.
+typedef struct PoolSlab {
+  struct PoolSlab *next;
+  max_align_t align;
+} PoolSlab;
+
+// A batch of blocks carved out of one allocation by pool_alloc_many(), along
+// with the number of its blocks in use and a free list of the others, which
+// are handed out again before a new slab is added. The runs of a size class
+// that have free blocks are linked together through prev and next.
+typedef struct PoolRun {
+  char *start;
+  char *end;
+  size_t live;
+  int class;
+  PoolBlock *free;
+  struct PoolRun *prev;
+  struct PoolRun *next;
+} PoolRun;
+
+static PoolBlock *free_lists[POOL_CLASSES];
+static PoolSlab *slabs;
+static PoolStats stats;
+
+// The runs sorted by address, so that the run of a block can be found with a
+// binary search, and the runs of each size class that have free blocks.
+static PoolRun **runs;
+static int run_count;
+static int run_capacity;
+static PoolRun *partial_runs[POOL_CLASSES];
+
+// returns the size of the blocks of a size class
+static size_t pool_class_size(int class)
+{
+  size_t base = class % 2 == 0 ? POOL_MIN_BLOCK : POOL_MIN_BLOCK * 3 / 2;
+  return base << (class / 2);
+}
+
+// returns the smallest size class that fits the size
+static int pool_class(size_t size)
+{
+  int class = 0;
+  while (pool_class_size(class) < size) class++;
+  return class;
+}
+
+// carves a new slab into blocks of a size class and adds them to its free list
+static bool pool_grow(int class)
+{
+  size_t block = pool_class_size(class);
+  PoolSlab *slab = malloc(POOL_SLAB_SIZE);
+  if (slab == NULL) {
+    SDL_SetError("Failed to allocate memory for slab");
+    return false;
+  }
+  stats.mallocs++;
+  slab->next = slabs;
+  slabs = slab;
+
+  // push the blocks in reverse so that they are handed out in address order
+  char *start = (char*)(slab + 1);
+  size_t size = POOL_SLAB_SIZE - sizeof(PoolSlab);
+  for (size_t offset = size / block * block; offset > 0; offset -= block) {
+    PoolBlock *free_block = (PoolBlock*)(start + offset - block);
+    free_block->next = free_lists[class];
+    free_lists[class] = free_block;
+  }
+  POOL_POISON(start, size);
+  return true;
+}
+
+// returns the index of the run holding a block, or -1 if it is not in a run
+static int pool_find_run(void *ptr)
+{
+  int low = 0;
+  int high = run_count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if ((char*)ptr < runs[mid]->start) {
+      high = mid;
+    } else if ((char*)ptr >= runs[mid]->end) {
+      low = mid + 1;
+    } else {
+      return mid;
+    }
+  }
+  return -1;
+}
+
+// adds a run to the runs of its size class that have free blocks
+static void pool_link_run(PoolRun *run)
+{
+  run->prev = NULL;
+  run->next = partial_runs[run->class];
+  if (run->next != NULL) run->next->prev = run;
+  partial_runs[run->class] = run;
+}
+
+// removes a run from the runs of its size class that have free blocks
+static void pool_unlink_run(PoolRun *run)
+{
+  if (run->prev != NULL) {
+    run->prev->next = run->next;
+  } else {
+    partial_runs[run->class] = run->next;
+  }
+  if (run->next != NULL) run->next->prev = run->prev;
+}
+
+void *pool_alloc(size_t size)
+{
+  stats.allocs++;
+  stats.bytes += pool_size(size);
+
+  // allocate large blocks directly
+  if (size > POOL_MAX_BLOCK) {
+    void *ptr = malloc(size);
+    if (ptr == NULL) {
+      SDL_SetError("Failed to allocate memory for block");
+      stats.bytes -= size;
+      return NULL;
+    }
+    stats.mallocs++;
+    return ptr;
+  }
+
+  // reuse a freed block of a run before adding a new slab, so that a run
+  // with a few live blocks does not hold the rest of its memory for nothing
+  int class = pool_class(size);
+  PoolRun *run = partial_runs[class];
+  if (free_lists[class] == NULL && run != NULL) {
+    PoolBlock *block = run->free;
+    POOL_UNPOISON(block, pool_class_size(class));
+    run->free = block->next;
+    run->live++;
+    if (run->free == NULL) pool_unlink_run(run);
+    return block;
+  }
+
+  // pop a block off the free list, adding a new slab if it is empty
+  if (free_lists[class] == NULL && !pool_grow(class)) {
+    stats.bytes -= pool_class_size(class);
+    return NULL;
+  }
+  PoolBlock *block = free_lists[class];
+  POOL_UNPOISON(block, pool_class_size(class));
+  free_lists[class] = block->next;
+  return block;
+}
+
+bool pool_alloc_many(size_t size, size_t count, void **blocks)
+{
+  // allocate large blocks and small batches one at a time
+  size_t block = pool_size(size);
+  if (size > POOL_MAX_BLOCK || count * block < POOL_SLAB_SIZE) {
+    for (size_t i = 0; i < count; i++) {
+      blocks[i] = pool_alloc(size);
+      if (blocks[i] == NULL) {
+        while (i > 0) pool_free(blocks[--i], size);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // carve larger batches out of a run of their own without touching it
+  if (run_count == run_capacity) {
+    int capacity = run_capacity == 0 ? 8 : run_capacity * 2;
+    PoolRun **grown = realloc(runs, capacity * sizeof(PoolRun*));
+    if (grown == NULL) {
+      SDL_SetError("Failed to allocate memory for run");
+      return false;
+    }
+    runs = grown;
+    run_capacity = capacity;
+  }
+  PoolRun *run = malloc(sizeof(PoolRun));
+  char *start = malloc(count * block);
+  if (run == NULL || start == NULL) {
+    SDL_SetError("Failed to allocate memory for run");
+    free(run);
+    free(start);
+    return false;
+  }
+  *run = (PoolRun){
+    .start = start,
+    .end = start + count * block,
+    .live = count,
+    .class = pool_class(size),
+  };
+
+  // keep the runs sorted by address
+  int index = run_count;
+  while (index > 0 && runs[index - 1]->start > start) index--;
+  memmove(runs + index + 1, runs + index, (run_count - index) * sizeof(PoolRun*));
+  runs[index] = run;
+  run_count++;
+  stats.allocs += count;
+  stats.bytes += count * block;
+  stats.mallocs++;
+  for (size_t i = 0; i < count; i++) blocks[i] = start + i * block;
+  return true;
+}
+
+// returns a run to the system on its own thread, at a low priority so that
+// it does not take time from the thread that freed the run
+static int pool_release(void *run)
+{
+  SDL_SetCurrentThreadPriority(SDL_THREAD_PRIORITY_LOW);
+  free(run);
+  return 0;
+}
+
+void pool_free(void *ptr, size_t size)
+{
+  if (ptr == NULL) return;
+  stats.frees++;
+  stats.bytes -= pool_size(size);
+
+  // free large blocks directly
+  if (size > POOL_MAX_BLOCK) {
+    free(ptr);
+    return;
+  }
+
+  // push blocks of runs onto the free list of their run, returning each run
+  // to the system with its last block
+  int class = pool_class(size);
+  PoolBlock *block = ptr;
+  int index = pool_find_run(ptr);
+  if (index >= 0) {
+    PoolRun *run = runs[index];
+    if (--run->live > 0) {
+      if (run->free == NULL) pool_link_run(run);
+      block->next = run->free;
+      run->free = block;
+      POOL_POISON(block, pool_class_size(class));
+      return;
+    }
+    if (run->free != NULL) pool_unlink_run(run);
+    POOL_UNPOISON(run->start, run->end - run->start);
+    SDL_Thread *thread = NULL;
+    if (run->end - run->start >= POOL_RELEASE_SIZE) {
+      thread = SDL_CreateThread(pool_release, "pool_release", run->start);
+    }
+    if (thread != NULL) {
+      SDL_DetachThread(thread);
+    } else {
+      free(run->start);
+    }
+    free(run);
+    run_count--;
+    memmove(runs + index, runs + index + 1, (run_count - index) * sizeof(PoolRun*));
+    return;
+  }
+
+  // otherwise push the block onto the free list of its size class
+  block->next = free_lists[class];
+  free_lists[class] = block;
+  POOL_POISON(block, pool_class_size(class));
+}
+
+size_t pool_size(size_t size)
+{
+  if (size > POOL_MAX_BLOCK) return size;
+  return pool_class_size(pool_class(size));
+}
+
+PoolStats pool_stats(void)
+{
+  return stats;
+}
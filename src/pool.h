@@ -0,0 +1,113 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Determines the size of each slab that blocks are carved out of.
+#define POOL_SLAB_SIZE 65536
+
+// Determines the largest block size served from a slab. Larger blocks are
+// allocated with malloc() directly.
+#define POOL_MAX_BLOCK 8192
+
+// Determines the size from which a run is returned to the system on a thread
+// of its own, since unmapping a large run can take tens of milliseconds.
+#define POOL_RELEASE_SIZE (1 << 20)
+
+/**
+ * struct PoolStats - Counts the allocations made through the pool.
+ *
+ * @allocs: The number of blocks handed out by pool_alloc().
+ * @frees: The number of blocks returned with pool_free().
+ * @mallocs: The number of allocations made with malloc(), for new slabs and
+ * for blocks larger than POOL_MAX_BLOCK.
+ * @bytes: The number of bytes in blocks that have not been freed yet, counting
+ * each block by its usable size.
+ *
+ * This struct is meant to be used by benchmarks to count how many allocations
+ * an operation makes, how many of them reach the system allocator, and how
+ * much memory the blocks in use take up.
+ */
+typedef struct PoolStats {
+  long allocs;
+  long frees;
+  long mallocs;
+  long bytes;
+} PoolStats;
+
+/**
+ * pool_alloc() - Allocates a block of memory from the pool.
+ *
+ * @size: The size of the block in bytes.
+ *
+ * This function allocates a block of memory by rounding the size up to the
+ * nearest size class and popping a block off that class's free list. If the
+ * free list is empty, a freed block of a run of that class is reused, and if
+ * there is none, a new slab of POOL_SLAB_SIZE bytes is allocated and carved
+ * into blocks of that class. Blocks larger than POOL_MAX_BLOCK are
+ * allocated with malloc(). The block must be freed with pool_free() using the
+ * same size. The pool is not thread-safe. This function returns NULL if it
+ * fails. For error information, use SDL_GetError().
+ */
+void *pool_alloc(size_t size);
+
+/**
+ * pool_alloc_many() - Allocates a batch of blocks of the same size.
+ *
+ * @size: The size of each block in bytes.
+ * @count: The number of blocks to allocate.
+ * @blocks: The array to store the blocks in, which must hold count pointers.
+ *
+ * This function allocates count blocks of the given size in one call. A batch
+ * that fills at least a slab is carved out of a single allocation of its own,
+ * called a run. The blocks of a run are not written to, so the pages of a
+ * large batch are first touched by whichever thread fills them in, and the
+ * run is returned to the system once all of its blocks have been freed, rather
+ * than being kept like a slab. Smaller batches, and blocks larger than
+ * POOL_MAX_BLOCK, are allocated one at a time with pool_alloc(). Either way,
+ * each block is freed on its own with pool_free(). This function returns false
+ * if it fails, in which case no blocks are allocated. For error information,
+ * use SDL_GetError().
+ */
+bool pool_alloc_many(size_t size, size_t count, void **blocks);
+
+/**
+ * pool_free() - Returns a block of memory to the pool.
+ *
+ * @ptr: The block to free.
+ * @size: The size the block was allocated with.
+ *
+ * This function pushes a block allocated with pool_alloc() back onto the free
+ * list of its size class so that it can be reused. Slabs are never returned
+ * to the system, but a block from a run made by pool_alloc_many() is instead
+ * pushed onto a free list of its run, found with a binary search over the
+ * runs, so that pool_alloc() can reuse it while the run is still in use. The
+ * run is freed along with its last block in use. A run of at least
+ * POOL_RELEASE_SIZE bytes is freed on a detached thread, so that freeing it
+ * does not stall the caller. If NULL is passed, nothing will happen.
+ */
+void pool_free(void *ptr, size_t size);
+
+/**
+ * pool_size() - Returns the usable size of a block.
+ *
+ * @size: The size the block was allocated with.
+ *
+ * This function returns the size of the blocks of the size class that a block
+ * of the given size is allocated from, which is at least as large as the size
+ * itself. A block may be resized in place with no effect on the pool, as long
+ * as the new size has the same usable size. It is then freed using the new
+ * size.
+ */
+size_t pool_size(size_t size);
+
+/**
+ * pool_stats() - Returns the allocation counters of the pool.
+ *
+ * This function returns a copy of the counters of all of the allocations
+ * made through the pool since the program started.
+ */
+PoolStats pool_stats(void);
+
+#endif // POOL_H
@@ -0,0 +1,922 @@
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL_error.h>
+
+#include "regexp.h"
+#include "stb_ds.h"
+
+// Determines how deeply groups may be nested in a pattern.
+#define REGEXP_MAX_DEPTH 1000
+
+// The flags of a DFA state.
+enum {
+  // the character before the state is a newline, or there is none
+  REGEXP_STATE_LINE = 1 << 0,
+  // a match ends right before the character that led to the state
+  REGEXP_STATE_MATCH = 1 << 1,
+  // a match has been found, so no more threads are started
+  REGEXP_STATE_FOUND = 1 << 2,
+  // no thread is left and none will be started, so the search can stop
+  REGEXP_STATE_DEAD = 1 << 3,
+  // whether a match ends at the end of the text has been worked out
+  REGEXP_STATE_END_KNOWN = 1 << 4,
+  // a match ends at the end of the text
+  REGEXP_STATE_END = 1 << 5,
+};
+
+// The flags that tell states with the same threads apart.
+#define REGEXP_STATE_KEY (REGEXP_STATE_LINE | REGEXP_STATE_MATCH | REGEXP_STATE_FOUND)
+
+typedef enum {
+  REGEXP_NODE_EMPTY,
+  REGEXP_NODE_SET,
+  REGEXP_NODE_CAT,
+  REGEXP_NODE_ALT,
+  REGEXP_NODE_REPEAT,
+  REGEXP_NODE_LINE_START,
+  REGEXP_NODE_LINE_END,
+} RegexpNodeType;
+
+// A node of the syntax tree of a pattern. Sets keep the index of their set in
+// a, concatenations and alternations keep their operands in a and b, and
+// repetitions keep the repeated node in a.
+typedef struct RegexpNode {
+  RegexpNodeType type;
+  int a;
+  int b;
+  int min;
+  int max;
+  bool greedy;
+} RegexpNode;
+
+// The state of parsing a pattern into a syntax tree.
+typedef struct RegexpParser {
+  const uint32_t *pattern;
+  int len;
+  int pos;
+  int depth;
+  RegexpNode *nodes;
+  Regexp *regex;
+} RegexpParser;
+
+static int regexp_parse_alt(RegexpParser *parser);
+
+// adds a node to the syntax tree, returning its index
+static int regexp_node(RegexpParser *parser, RegexpNodeType type, int a, int b)
+{
+  RegexpNode node = {.type = type, .a = a, .b = b};
+  arrput(parser->nodes, node);
+  return (int)arrlen(parser->nodes) - 1;
+}
+
+// compares two ranges by their first codepoint, for qsort()
+static int regexp_range_cmp(const void *a, const void *b)
+{
+  uint32_t x = ((const RegexpRange*)a)->lo;
+  uint32_t y = ((const RegexpRange*)b)->lo;
+  return x < y ? -1 : x > y;
+}
+
+// sorts the ranges of a set and merges the ones that overlap or touch,
+// complementing the set if it is negated, and returns the new array of ranges
+static RegexpRange *regexp_normalize(RegexpRange *ranges, bool negate)
+{
+  int count = 0;
+  if (arrlen(ranges) > 0) {
+    qsort(ranges, arrlen(ranges), sizeof(RegexpRange), regexp_range_cmp);
+    for (int i = 1; i < arrlen(ranges); i++) {
+      if (ranges[count].hi != UINT32_MAX && ranges[i].lo > ranges[count].hi + 1) {
+        ranges[++count] = ranges[i];
+      } else if (ranges[i].hi > ranges[count].hi) {
+        ranges[count].hi = ranges[i].hi;
+      }
+    }
+    count++;
+  }
+  arrsetlen(ranges, count);
+
+  if (negate) {
+    RegexpRange *complement = NULL;
+    uint32_t lo = 0;
+    bool done = false;
+    for (int i = 0; i < count && !done; i++) {
+      if (ranges[i].lo > lo) arrput(complement, ((RegexpRange){lo, ranges[i].lo - 1}));
+      if (ranges[i].hi == UINT32_MAX) done = true;
+      else lo = ranges[i].hi + 1;
+    }
+    if (!done) arrput(complement, ((RegexpRange){lo, UINT32_MAX}));
+    arrfree(ranges);
+    ranges = complement;
+  }
+  return ranges;
+}
+
+// adds a set to the regex, returning the node that matches it
+static int regexp_set(RegexpParser *parser, RegexpRange *ranges, bool negate)
+{
+  arrput(parser->regex->sets, regexp_normalize(ranges, negate));
+  return regexp_node(parser, REGEXP_NODE_SET, (int)arrlen(parser->regex->sets) - 1, -1);
+}
+
+// adds the ranges of a class escape such as \d to a set, returning whether the
+// character is one
+static bool regexp_class_escape(uint32_t c, RegexpRange **ranges, bool *negate)
+{
+  switch (c) {
+  case 'D':
+  case 'd':
+    arrput(*ranges, ((RegexpRange){'0', '9'}));
+    break;
+  case 'W':
+  case 'w':
+    arrput(*ranges, ((RegexpRange){'0', '9'}));
+    arrput(*ranges, ((RegexpRange){'A', 'Z'}));
+    arrput(*ranges, ((RegexpRange){'_', '_'}));
+    arrput(*ranges, ((RegexpRange){'a', 'z'}));
+    break;
+  case 'S':
+  case 's':
+    arrput(*ranges, ((RegexpRange){'\t', '\r'}));
+    arrput(*ranges, ((RegexpRange){' ', ' '}));
+    break;
+  default:
+    return false;
+  }
+  *negate = c == 'D' || c == 'W' || c == 'S';
+  return true;
+}
+
+// parses the character after a backslash as a single character, returning
+// false if it is not one
+static bool regexp_char_escape(RegexpParser *parser, uint32_t c, uint32_t *out)
+{
+  switch (c) {
+  case 'n':
+    *out = '\n';
+    return true;
+  case 't':
+    *out = '\t';
+    return true;
+  case 'r':
+    *out = '\r';
+    return true;
+  }
+  if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+    SDL_SetError("Regex has an unknown escape at %d", parser->pos - 1);
+    return false;
+  }
+  *out = c;
+  return true;
+}
+
+// parses a character set in brackets, after the opening bracket
+static int regexp_parse_set(RegexpParser *parser)
+{
+  RegexpRange *ranges = NULL;
+  bool negate = false;
+  if (parser->pos < parser->len && parser->pattern[parser->pos] == '^') {
+    negate = true;
+    parser->pos++;
+  }
+
+  for (bool first = true; parser->pos < parser->len; first = false) {
+    uint32_t c = parser->pattern[parser->pos++];
+    if (c == ']' && !first) return regexp_set(parser, ranges, negate);
+
+    // an escape is either a class, whose ranges are added as they are, or a
+    // single character
+    if (c == '\\') {
+      if (parser->pos == parser->len) break;
+      uint32_t e = parser->pattern[parser->pos++];
+      RegexpRange *class = NULL;
+      bool inverse;
+      if (regexp_class_escape(e, &class, &inverse)) {
+        if (inverse) class = regexp_normalize(class, true);
+        for (int i = 0; i < arrlen(class); i++) arrput(ranges, class[i]);
+        arrfree(class);
+        continue;
+      }
+      if (!regexp_char_escape(parser, e, &c)) {
+        arrfree(ranges);
+        return -1;
+      }
+    }
+
+    // a dash between two characters makes a range of them
+    uint32_t hi = c;
+    if (parser->pos + 1 < parser->len && parser->pattern[parser->pos] == '-' &&
+        parser->pattern[parser->pos + 1] != ']') {
+      parser->pos++;
+      hi = parser->pattern[parser->pos++];
+      if (hi == '\\') {
+        if (parser->pos == parser->len) break;
+        if (!regexp_char_escape(parser, parser->pattern[parser->pos++], &hi)) {
+          arrfree(ranges);
+          return -1;
+        }
+      }
+      if (hi < c) {
+        SDL_SetError("Regex has a range out of order at %d", parser->pos - 1);
+        arrfree(ranges);
+        return -1;
+      }
+    }
+    arrput(ranges, ((RegexpRange){c, hi}));
+  }
+  SDL_SetError("Regex is missing a ]");
+  arrfree(ranges);
+  return -1;
+}
+
+// parses a single character, set, group or anchor
+static int regexp_parse_atom(RegexpParser *parser)
+{
+  uint32_t c = parser->pattern[parser->pos++];
+  RegexpRange *ranges = NULL;
+  bool negate = false;
+  switch (c) {
+  case '(': {
+    if (++parser->depth > REGEXP_MAX_DEPTH) {
+      SDL_SetError("Regex is nested too deeply");
+      return -1;
+    }
+    if (parser->pos + 1 < parser->len && parser->pattern[parser->pos] == '?' &&
+        parser->pattern[parser->pos + 1] == ':') {
+      parser->pos += 2;
+    }
+    int node = regexp_parse_alt(parser);
+    if (node < 0) return -1;
+    if (parser->pos == parser->len) {
+      SDL_SetError("Regex is missing a )");
+      return -1;
+    }
+    parser->pos++;
+    parser->depth--;
+    return node;
+  }
+  case '[':
+    return regexp_parse_set(parser);
+  case '.':
+    arrput(ranges, ((RegexpRange){'\n', '\n'}));
+    return regexp_set(parser, ranges, true);
+  case '^':
+    return regexp_node(parser, REGEXP_NODE_LINE_START, -1, -1);
+  case '$':
+    return regexp_node(parser, REGEXP_NODE_LINE_END, -1, -1);
+  case '*':
+  case '+':
+  case '?':
+  case '{':
+    SDL_SetError("Regex has nothing to repeat at %d", parser->pos - 1);
+    return -1;
+  case '\\':
+    if (parser->pos == parser->len) {
+      SDL_SetError("Regex ends with a \\");
+      return -1;
+    }
+    c = parser->pattern[parser->pos++];
+    if (regexp_class_escape(c, &ranges, &negate)) return regexp_set(parser, ranges, negate);
+    if (!regexp_char_escape(parser, c, &c)) return -1;
+    break;
+  }
+  arrput(ranges, ((RegexpRange){c, c}));
+  return regexp_set(parser, ranges, false);
+}
+
+// parses a decimal number of repetitions, returning -1 if there is none
+static int regexp_parse_count(RegexpParser *parser)
+{
+  int count = -1;
+  while (parser->pos < parser->len && parser->pattern[parser->pos] >= '0' &&
+         parser->pattern[parser->pos] <= '9') {
+    int digit = parser->pattern[parser->pos++] - '0';
+    count = count < 0 ? digit : count * 10 + digit;
+    if (count > REGEXP_MAX_REPEAT) count = REGEXP_MAX_REPEAT + 1;
+  }
+  return count;
+}
+
+// parses an atom followed by any number of quantifiers
+static int regexp_parse_repeat(RegexpParser *parser)
+{
+  int node = regexp_parse_atom(parser);
+  while (node >= 0 && parser->pos < parser->len) {
+    int min;
+    int max;
+    switch (parser->pattern[parser->pos++]) {
+    case '*':
+      min = 0;
+      max = -1;
+      break;
+    case '+':
+      min = 1;
+      max = -1;
+      break;
+    case '?':
+      min = 0;
+      max = 1;
+      break;
+    case '{':
+      min = regexp_parse_count(parser);
+      max = min;
+      if (parser->pos < parser->len && parser->pattern[parser->pos] == ',') {
+        parser->pos++;
+        max = regexp_parse_count(parser);
+      }
+      if (min < 0 || parser->pos == parser->len || parser->pattern[parser->pos++] != '}') {
+        SDL_SetError("Regex has an invalid repetition at %d", parser->pos - 1);
+        return -1;
+      }
+      if (min > REGEXP_MAX_REPEAT || max > REGEXP_MAX_REPEAT) {
+        SDL_SetError("Regex repeats more than %d times", REGEXP_MAX_REPEAT);
+        return -1;
+      }
+      if (max >= 0 && max < min) {
+        SDL_SetError("Regex has a repetition out of order at %d", parser->pos - 1);
+        return -1;
+      }
+      break;
+    default:
+      parser->pos--;
+      return node;
+    }
+    bool greedy = true;
+    if (parser->pos < parser->len && parser->pattern[parser->pos] == '?') {
+      greedy = false;
+      parser->pos++;
+    }
+    int repeat = regexp_node(parser, REGEXP_NODE_REPEAT, node, -1);
+    parser->nodes[repeat].min = min;
+    parser->nodes[repeat].max = max;
+    parser->nodes[repeat].greedy = greedy;
+    node = repeat;
+  }
+  return node;
+}
+
+// parses a sequence of atoms up to the end of an alternative
+static int regexp_parse_cat(RegexpParser *parser)
+{
+  int node = -1;
+  while (parser->pos < parser->len && parser->pattern[parser->pos] != '|' &&
+         parser->pattern[parser->pos] != ')') {
+    int next = regexp_parse_repeat(parser);
+    if (next < 0) return -1;
+    node = node < 0 ? next : regexp_node(parser, REGEXP_NODE_CAT, node, next);
+  }
+  return node < 0 ? regexp_node(parser, REGEXP_NODE_EMPTY, -1, -1) : node;
+}
+
+// parses alternatives separated by bars
+static int regexp_parse_alt(RegexpParser *parser)
+{
+  int node = regexp_parse_cat(parser);
+  while (node >= 0 && parser->pos < parser->len && parser->pattern[parser->pos] == '|') {
+    parser->pos++;
+    int next = regexp_parse_cat(parser);
+    if (next < 0) return -1;
+    node = regexp_node(parser, REGEXP_NODE_ALT, node, next);
+  }
+  return node;
+}
+
+// adds an instruction to the NFA, returning its index, or -1 if the NFA is
+// too large
+static int regexp_emit(RegexpDfa *dfa, RegexpOp op, int out, int out1, int set)
+{
+  if (arrlen(dfa->insts) >= REGEXP_MAX_INSTS) {
+    SDL_SetError("Regex is too large");
+    return -1;
+  }
+  RegexpInst inst = {op, out, out1, set};
+  arrput(dfa->insts, inst);
+  return (int)arrlen(dfa->insts) - 1;
+}
+
+// compiles a node of the syntax tree into instructions that go on to the next
+// instruction once the node has matched, returning the first of them, or -1
+// if it fails. The reversed regex matches the operands of concatenations in
+// the opposite order, and swaps the anchors.
+static int regexp_compile_node(RegexpDfa *dfa, const RegexpNode *nodes, int node, bool reverse,
+                               int next)
+{
+  const RegexpNode *n = &nodes[node];
+  switch (n->type) {
+  case REGEXP_NODE_EMPTY:
+    return next;
+  case REGEXP_NODE_SET:
+    return regexp_emit(dfa, REGEXP_SET, next, -1, n->a);
+  case REGEXP_NODE_LINE_START:
+    return regexp_emit(dfa, reverse ? REGEXP_LINE_END : REGEXP_LINE_START, next, -1, -1);
+  case REGEXP_NODE_LINE_END:
+    return regexp_emit(dfa, reverse ? REGEXP_LINE_START : REGEXP_LINE_END, next, -1, -1);
+
+  case REGEXP_NODE_CAT:
+  case REGEXP_NODE_ALT: {
+    // chains of operands are parsed into left-deep trees, so gather the
+    // operands of the chain without recursing, last first
+    int *operands = NULL;
+    for (; nodes[node].type == n->type; node = nodes[node].a) arrput(operands, nodes[node].b);
+    arrput(operands, node);
+    int count = (int)arrlen(operands);
+    int start = next;
+    if (n->type == REGEXP_NODE_CAT) {
+      for (int i = 0; i < count && start >= 0; i++) {
+        start = regexp_compile_node(dfa, nodes, operands[reverse ? count - 1 - i : i], reverse,
+                                    start);
+      }
+    } else {
+      start = regexp_compile_node(dfa, nodes, operands[0], reverse, next);
+      for (int i = 1; i < count && start >= 0; i++) {
+        int first = regexp_compile_node(dfa, nodes, operands[i], reverse, next);
+        start = first < 0 ? -1 : regexp_emit(dfa, REGEXP_SPLIT, first, start, -1);
+      }
+    }
+    arrfree(operands);
+    return start;
+  }
+
+  case REGEXP_NODE_REPEAT: {
+    // the optional repetitions nest, so each is only tried after the one
+    // before it has matched
+    int start = next;
+    if (n->max < 0) {
+      int loop = regexp_emit(dfa, REGEXP_SPLIT, -1, -1, -1);
+      int body = loop < 0 ? -1 : regexp_compile_node(dfa, nodes, n->a, reverse, loop);
+      if (body < 0) return -1;
+      dfa->insts[loop].out = n->greedy ? body : next;
+      dfa->insts[loop].out1 = n->greedy ? next : body;
+      start = loop;
+    }
+    for (int i = n->min; i < n->max && start >= 0; i++) {
+      int body = regexp_compile_node(dfa, nodes, n->a, reverse, start);
+      if (body < 0) return -1;
+      start = regexp_emit(dfa, REGEXP_SPLIT, n->greedy ? body : next, n->greedy ? next : body, -1);
+    }
+    for (int i = 0; i < n->min && start >= 0; i++) {
+      start = regexp_compile_node(dfa, nodes, n->a, reverse, start);
+    }
+    return start;
+  }
+  }
+  return -1;
+}
+
+// compiles the syntax tree into the NFA of a DFA, reversed or not
+static bool regexp_program(RegexpDfa *dfa, const RegexpNode *nodes, int root, bool reverse)
+{
+  int match = regexp_emit(dfa, REGEXP_MATCH, -1, -1, -1);
+  dfa->start = regexp_compile_node(dfa, nodes, root, reverse, match);
+  if (dfa->start < 0) return false;
+  dfa->longest = reverse;
+  dfa->capacity = 64;
+  dfa->table = calloc(dfa->capacity, sizeof(RegexpState*));
+  dfa->visited = calloc(arrlen(dfa->insts), sizeof(int));
+  arrsetcap(dfa->list, 64);
+  arrsetcap(dfa->stack, 64);
+  if (dfa->table == NULL || dfa->visited == NULL) {
+    SDL_SetError("Failed to allocate memory for regex");
+    return false;
+  }
+  return true;
+}
+
+// compares two codepoints, for qsort()
+static int regexp_codepoint_cmp(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+  return x < y ? -1 : x > y;
+}
+
+// returns the class of a codepoint, which is the number of bounds at or
+// before it
+static int regexp_class(const Regexp *regex, uint32_t c)
+{
+  int lo = 0;
+  int hi = (int)arrlen(regex->bounds);
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (regex->bounds[mid] <= c) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+// splits the codepoints into the classes that every set of the regex either
+// matches entirely or not at all, with the newline in a class of its own
+static void regexp_classes(Regexp *regex)
+{
+  arrput(regex->bounds, '\n');
+  arrput(regex->bounds, '\n' + 1);
+  for (int i = 0; i < arrlen(regex->sets); i++) {
+    for (int j = 0; j < arrlen(regex->sets[i]); j++) {
+      arrput(regex->bounds, regex->sets[i][j].lo);
+      if (regex->sets[i][j].hi != UINT32_MAX) arrput(regex->bounds, regex->sets[i][j].hi + 1);
+    }
+  }
+  qsort(regex->bounds, arrlen(regex->bounds), sizeof(uint32_t), regexp_codepoint_cmp);
+  int count = 0;
+  for (int i = 0; i < arrlen(regex->bounds); i++) {
+    if (regex->bounds[i] != 0 && (count == 0 || regex->bounds[i] != regex->bounds[count - 1])) {
+      regex->bounds[count++] = regex->bounds[i];
+    }
+  }
+  arrsetlen(regex->bounds, count);
+  regex->classes = count + 1;
+  for (uint32_t c = 0; c < 128; c++) regex->ascii[c] = regexp_class(regex, c);
+  regex->newline = regex->ascii['\n'];
+}
+
+Regexp *regexp_compile(const uint32_t *pattern, int len)
+{
+  Regexp *regex = calloc(1, sizeof(Regexp));
+  if (regex == NULL) {
+    SDL_SetError("Failed to allocate memory for regex");
+    return NULL;
+  }
+
+  // parse the pattern into a syntax tree, then compile it both ways
+  RegexpParser parser = {.pattern = pattern, .len = len, .regex = regex};
+  int root = regexp_parse_alt(&parser);
+  if (root >= 0 && parser.pos < len) {
+    SDL_SetError("Regex has an unmatched ) at %d", parser.pos);
+    root = -1;
+  }
+  bool ok = root >= 0 && regexp_program(&regex->forward, parser.nodes, root, false) &&
+            regexp_program(&regex->reverse, parser.nodes, root, true);
+  arrfree(parser.nodes);
+  if (!ok) {
+    regexp_free(regex);
+    return NULL;
+  }
+  regexp_classes(regex);
+  return regex;
+}
+
+// frees every cached state of a DFA
+static void regexp_flush(RegexpDfa *dfa)
+{
+  for (int i = 0; i < dfa->capacity; i++) {
+    free(dfa->table[i]);
+    dfa->table[i] = NULL;
+  }
+  dfa->states = 0;
+  dfa->bytes = 0;
+  dfa->initial[0] = NULL;
+  dfa->initial[1] = NULL;
+}
+
+// frees the NFA and the cached states of a DFA
+static void regexp_dfa_free(RegexpDfa *dfa)
+{
+  if (dfa->table != NULL) regexp_flush(dfa);
+  free(dfa->table);
+  free(dfa->visited);
+  arrfree(dfa->insts);
+  arrfree(dfa->list);
+  arrfree(dfa->stack);
+}
+
+void regexp_free(Regexp *regex)
+{
+  if (regex == NULL) return;
+  regexp_dfa_free(&regex->forward);
+  regexp_dfa_free(&regex->reverse);
+  for (int i = 0; i < arrlen(regex->sets); i++) arrfree(regex->sets[i]);
+  arrfree(regex->sets);
+  arrfree(regex->bounds);
+  free(regex);
+}
+
+// returns whether a set matches a codepoint
+static bool regexp_set_contains(const RegexpRange *ranges, uint32_t c)
+{
+  int lo = 0;
+  int hi = (int)arrlen(ranges);
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (ranges[mid].hi < c) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo < arrlen(ranges) && ranges[lo].lo <= c;
+}
+
+// returns the hash of the flags and threads of a state
+static uint32_t regexp_hash(int flags, const int *threads, int count)
+{
+  uint32_t hash = 2166136261u ^ (uint32_t)flags;
+  for (int i = 0; i < count; i++) hash = (hash ^ (uint32_t)threads[i]) * 16777619u;
+  return hash;
+}
+
+// doubles the size of the table of cached states
+static bool regexp_grow(RegexpDfa *dfa)
+{
+  int capacity = dfa->capacity * 2;
+  RegexpState **table = calloc(capacity, sizeof(RegexpState*));
+  if (table == NULL) {
+    SDL_SetError("Failed to allocate memory for regex");
+    return false;
+  }
+  for (int i = 0; i < dfa->capacity; i++) {
+    if (dfa->table[i] == NULL) continue;
+    int slot = dfa->table[i]->hash & (capacity - 1);
+    while (table[slot] != NULL) slot = (slot + 1) & (capacity - 1);
+    table[slot] = dfa->table[i];
+  }
+  free(dfa->table);
+  dfa->table = table;
+  dfa->capacity = capacity;
+  return true;
+}
+
+// returns the cached state with the given flags and threads, building it if
+// it is not cached yet, or NULL if it fails
+static RegexpState *regexp_state(const Regexp *regex, RegexpDfa *dfa, int flags,
+                                 const int *threads, int count)
+{
+  uint32_t hash = regexp_hash(flags, threads, count);
+  int slot = hash & (dfa->capacity - 1);
+  for (; dfa->table[slot] != NULL; slot = (slot + 1) & (dfa->capacity - 1)) {
+    RegexpState *state = dfa->table[slot];
+    if (state->hash == hash && (state->flags & REGEXP_STATE_KEY) == flags &&
+        state->count == count && memcmp(state->threads, threads, count * sizeof(int)) == 0) {
+      return state;
+    }
+  }
+
+  // keep the table at most half full
+  if (2 * (dfa->states + 1) > dfa->capacity) {
+    if (!regexp_grow(dfa)) return NULL;
+    slot = hash & (dfa->capacity - 1);
+    while (dfa->table[slot] != NULL) slot = (slot + 1) & (dfa->capacity - 1);
+  }
+
+  // allocate the state with its transitions and threads after it
+  size_t size = sizeof(RegexpState) + regex->classes * sizeof(RegexpState*) + count * sizeof(int);
+  RegexpState *state = calloc(1, size);
+  if (state == NULL) {
+    SDL_SetError("Failed to allocate memory for regex");
+    return NULL;
+  }
+  state->flags = flags;
+  if (count == 0 && (dfa->longest || (flags & REGEXP_STATE_FOUND))) {
+    state->flags |= REGEXP_STATE_DEAD;
+  }
+  state->count = count;
+  state->hash = hash;
+  state->threads = (int*)(state->next + regex->classes);
+  memcpy(state->threads, threads, count * sizeof(int));
+  dfa->table[slot] = state;
+  dfa->states++;
+  dfa->bytes += size;
+  return state;
+}
+
+// starts marking the instructions added to a new state
+static void regexp_mark(RegexpDfa *dfa)
+{
+  if (dfa->mark == INT_MAX) {
+    memset(dfa->visited, 0, arrlen(dfa->insts) * sizeof(int));
+    dfa->mark = 0;
+  }
+  dfa->mark++;
+}
+
+// adds the threads reached from an instruction without consuming a character
+// to the list, in order of priority. Returns whether the rest of the threads
+// are to be dropped, which they are once a thread matches, unless the DFA
+// finds the longest match, in which case matched is set instead.
+static bool regexp_closure(RegexpDfa *dfa, int inst, bool line_start, bool line_end,
+                           bool *matched)
+{
+  arrput(dfa->stack, inst);
+  while (arrlen(dfa->stack) > 0) {
+    int i = arrpop(dfa->stack);
+    if (dfa->visited[i] == dfa->mark) continue;
+    dfa->visited[i] = dfa->mark;
+    const RegexpInst *in = &dfa->insts[i];
+    switch (in->op) {
+    case REGEXP_NOP:
+      arrput(dfa->stack, in->out);
+      break;
+    case REGEXP_SPLIT:
+      arrput(dfa->stack, in->out1);
+      arrput(dfa->stack, in->out);
+      break;
+    case REGEXP_LINE_START:
+      if (line_start) arrput(dfa->stack, in->out);
+      break;
+    case REGEXP_LINE_END:
+      if (line_end) arrput(dfa->stack, in->out);
+      break;
+    case REGEXP_SET:
+      arrput(dfa->list, i);
+      break;
+    case REGEXP_MATCH:
+      *matched = true;
+      if (!dfa->longest) {
+        arrdeln(dfa->stack, 0, arrlen(dfa->stack));
+        return true;
+      }
+      break;
+    }
+  }
+  return false;
+}
+
+// gathers the threads of a state and the threads they reach without consuming
+// a character into the list, starting a new thread at the lowest priority
+// unless the DFA is anchored or a match has been found. Returns whether a
+// match ends at this position.
+static bool regexp_gather(RegexpDfa *dfa, const RegexpState *state, bool line_end)
+{
+  bool line_start = state->flags & REGEXP_STATE_LINE;
+  bool matched = false;
+  arrdeln(dfa->list, 0, arrlen(dfa->list));
+  regexp_mark(dfa);
+  for (int i = 0; i < state->count; i++) {
+    if (regexp_closure(dfa, state->threads[i], line_start, line_end, &matched)) return true;
+  }
+  if (!dfa->longest && !(state->flags & REGEXP_STATE_FOUND)) {
+    regexp_closure(dfa, dfa->start, line_start, line_end, &matched);
+  }
+  return matched;
+}
+
+// builds the transition of a state on a class of characters, returning the
+// state that it reaches, or NULL if it fails
+static RegexpState *regexp_step(const Regexp *regex, RegexpDfa *dfa, RegexpState *state,
+                                int class)
+{
+  bool line_end = class == regex->newline;
+  bool matched = regexp_gather(dfa, state, line_end);
+
+  // step the threads whose sets match the class over it, keeping the first of
+  // any that reach the same instruction
+  uint32_t c = class == 0 ? 0 : regex->bounds[class - 1];
+  int count = 0;
+  regexp_mark(dfa);
+  for (int i = 0; i < arrlen(dfa->list); i++) {
+    const RegexpInst *in = &dfa->insts[dfa->list[i]];
+    if (!regexp_set_contains(regex->sets[in->set], c)) continue;
+    if (dfa->visited[in->out] == dfa->mark) continue;
+    dfa->visited[in->out] = dfa->mark;
+    dfa->list[count++] = in->out;
+  }
+  int flags = (line_end ? REGEXP_STATE_LINE : 0) | (matched ? REGEXP_STATE_MATCH : 0);
+  if (!dfa->longest && (matched || (state->flags & REGEXP_STATE_FOUND))) {
+    flags |= REGEXP_STATE_FOUND;
+  }
+
+  // start over once the cached states take up too much memory
+  if (dfa->bytes > REGEXP_CACHE_SIZE) {
+    regexp_flush(dfa);
+    state = NULL;
+  }
+  RegexpState *next = regexp_state(regex, dfa, flags, dfa->list, count);
+  if (next != NULL && state != NULL) state->next[class] = next;
+  return next;
+}
+
+// returns the state that a DFA starts in, after a newline or not
+static RegexpState *regexp_initial(const Regexp *regex, RegexpDfa *dfa, bool line_start)
+{
+  if (dfa->initial[line_start] == NULL) {
+    dfa->initial[line_start] = regexp_state(regex, dfa, line_start ? REGEXP_STATE_LINE : 0,
+                                            &dfa->start, dfa->longest);
+  }
+  return dfa->initial[line_start];
+}
+
+// returns whether a match ends at the end of the text after a state
+static bool regexp_at_end(RegexpDfa *dfa, RegexpState *state)
+{
+  if (!(state->flags & REGEXP_STATE_END_KNOWN)) {
+    bool matched = regexp_gather(dfa, state, true);
+    state->flags |= REGEXP_STATE_END_KNOWN | (matched ? REGEXP_STATE_END : 0);
+  }
+  return state->flags & REGEXP_STATE_END;
+}
+
+// returns whether a search has been cancelled, setting the error if so
+static bool regexp_cancelled(const _Atomic(bool) *cancel)
+{
+  if (cancel == NULL || !*cancel) return false;
+  SDL_SetError("Search was cancelled");
+  return true;
+}
+
+// runs the forward DFA from an index until the leftmost match has ended and
+// no thread that could extend it is left, returning the end of the match, or
+// -1 if there is none, or -2 if it fails
+static int regexp_scan(Regexp *regex, RopeNode *root, int from, const _Atomic(bool) *cancel)
+{
+  RegexpDfa *dfa = &regex->forward;
+  RopeIter iter;
+
+  // start on the character before the index, if any, to know whether the
+  // index is at the start of a line
+  if (!rope_iter_init(&iter, root, from > 0 ? from - 1 : 0)) return -2;
+  bool line_start = from == 0 || iter.chunk[0] == '\n';
+  int skip = from > 0;
+  RegexpState *state = regexp_initial(regex, dfa, line_start);
+  if (state == NULL) return -2;
+
+  int end = -1;
+  int pos = from;
+  do {
+    if (regexp_cancelled(cancel)) return -2;
+    const uint32_t *chunk = iter.chunk + skip;
+    int n = iter.len - skip;
+    skip = 0;
+    for (int i = 0; i < n; i++) {
+      uint32_t c = chunk[i];
+      int class = c < 128 ? regex->ascii[c] : regexp_class(regex, c);
+      RegexpState *next = state->next[class];
+
+      // leave the state as it is when it steps to itself, so that the next
+      // step does not wait for this one to load, which lets the search skip
+      // through text that cannot start a match at the speed of the cache
+      if (next == state && !(state->flags & REGEXP_STATE_MATCH)) continue;
+      if (next == NULL && (next = regexp_step(regex, dfa, state, class)) == NULL) return -2;
+      state = next;
+      if (state->flags & (REGEXP_STATE_MATCH | REGEXP_STATE_DEAD)) {
+        if (state->flags & REGEXP_STATE_MATCH) end = pos + i;
+        if (state->flags & REGEXP_STATE_DEAD) return end;
+      }
+    }
+    pos += n;
+  } while (rope_iter_next(&iter));
+  return regexp_at_end(dfa, state) ? pos : end;
+}
+
+// runs the reverse DFA back from the end of a match to the index the search
+// started at, returning where the match starts, or -2 if it fails
+static int regexp_scan_back(Regexp *regex, RopeNode *root, int from, int end,
+                            const _Atomic(bool) *cancel)
+{
+  RegexpDfa *dfa = &regex->reverse;
+  RopeIter iter;
+
+  // the reversed regex sees the character after the end first, and reads the
+  // character before the index last, to know whether the index is at the
+  // start of a line
+  rope_iter_init(&iter, root, end);
+  bool line_start = end == rope_length(root) || iter.chunk[0] == '\n';
+  RegexpState *state = regexp_initial(regex, dfa, line_start);
+  if (state == NULL) return -2;
+
+  int start = -1;
+  int limit = from > 0 ? from - 1 : 0;
+  int pos = end;
+  while (pos > limit && rope_iter_prev(&iter)) {
+    if (regexp_cancelled(cancel)) return -2;
+    int lo = iter.start > limit ? iter.start : limit;
+    for (int p = pos - 1; p >= lo; p--) {
+      uint32_t c = iter.chunk[p - iter.start];
+      int class = c < 128 ? regex->ascii[c] : regexp_class(regex, c);
+      RegexpState *next = state->next[class];
+      if (next == NULL && (next = regexp_step(regex, dfa, state, class)) == NULL) return -2;
+      state = next;
+      if (state->flags & REGEXP_STATE_MATCH) start = p + 1;
+      if (p < from || (state->flags & REGEXP_STATE_DEAD)) return start;
+    }
+    pos = lo;
+  }
+  return from == 0 && regexp_at_end(dfa, state) ? 0 : start;
+}
+
+int regexp_find(Regexp *regex, RopeNode *root, int from, int *end, const _Atomic(bool) *cancel)
+{
+  if (from < 0 || from > rope_length(root)) {
+    SDL_SetError("Index is outside of the rope");
+    return -2;
+  }
+  int stop = regexp_scan(regex, root, from, cancel);
+  if (stop < 0) return stop;
+  int start = regexp_scan_back(regex, root, from, stop, cancel);
+  if (start >= 0) *end = stop;
+  return start;
+}
+
+int regexp_find_all(Regexp *regex, RopeNode *root, RegexpMatch **matches,
+                    const _Atomic(bool) *cancel)
+{
+  int count = (int)arrlen(*matches);
+  int length = rope_length(root);
+  for (int from = 0; from <= length;) {
+    int end;
+    int start = regexp_find(regex, root, from, &end, cancel);
+    if (start == -2) return -1;
+    if (start < 0) break;
+    arrput(*matches, ((RegexpMatch){start, end}));
+    from = end > start ? end : end + 1;
+  }
+  return (int)arrlen(*matches) - count;
+}
@@ -0,0 +1,232 @@
+#ifndef REGEXP_H
+#define REGEXP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rope.h"
+
+// Determines the most memory that the cached states of the DFA of a regex may
+// take up. Once they take up more, they are all freed and built again as the
+// search goes on, so memory stays bounded however many states the text visits.
+#define REGEXP_CACHE_SIZE (4 << 20)
+
+// Determines the most instructions that the NFA of a regex may compile to,
+// which bounds the size of counted repetitions such as x{1000}.
+#define REGEXP_MAX_INSTS 65536
+
+// Determines the most times that a counted repetition may repeat.
+#define REGEXP_MAX_REPEAT 1000
+
+/**
+ * struct RegexpMatch - Holds where a match of a regex lies in a rope.
+ *
+ * @start: The index of the first character of the match.
+ * @end: The index after the last character of the match.
+ */
+typedef struct RegexpMatch {
+  int start;
+  int end;
+} RegexpMatch;
+
+/**
+ * struct RegexpRange - Holds a range of codepoints matched by a character set.
+ *
+ * @lo: The first codepoint of the range.
+ * @hi: The last codepoint of the range, which is included.
+ */
+typedef struct RegexpRange {
+  uint32_t lo;
+  uint32_t hi;
+} RegexpRange;
+
+typedef enum {
+  REGEXP_NOP,
+  REGEXP_SPLIT,
+  REGEXP_SET,
+  REGEXP_LINE_START,
+  REGEXP_LINE_END,
+  REGEXP_MATCH,
+} RegexpOp;
+
+/**
+ * struct RegexpInst - An instruction of the NFA of a regex.
+ *
+ * @op: The kind of instruction.
+ * @out: The instruction to go to next.
+ * @out1: The instruction to go to with lower priority, for REGEXP_SPLIT.
+ * @set: The index of the character set to match, for REGEXP_SET.
+ */
+typedef struct RegexpInst {
+  RegexpOp op;
+  int out;
+  int out1;
+  int set;
+} RegexpInst;
+
+/**
+ * struct RegexpState - A state of the DFA of a regex.
+ *
+ * @flags: The REGEXP_STATE_* flags of the state.
+ * @count: The number of NFA threads in the state.
+ * @hash: The hash of the flags and threads, for the cache of states.
+ * @threads: The instructions that the NFA threads of the state are at, in
+ * order of priority.
+ * @next: The state reached from this one on each class of character, or NULL
+ * if that transition has not been built yet.
+ *
+ * This struct represents a set of NFA threads that the DFA is in between two
+ * characters. States are allocated in a single block with their transitions
+ * inline, so that stepping over a character loads a single pointer, followed
+ * by their threads, and are built lazily the first time a transition reaches
+ * them.
+ */
+typedef struct RegexpState {
+  int flags;
+  int count;
+  uint32_t hash;
+  int *threads;
+  struct RegexpState *next[];
+} RegexpState;
+
+/**
+ * struct RegexpDfa - A lazily built DFA that runs the NFA of a regex.
+ *
+ * @insts: The dynamic array of NFA instructions.
+ * @start: The instruction that a match starts at.
+ * @longest: Whether the DFA is anchored at the start of the text and finds
+ * the longest match, rather than starting a thread at every position and
+ * preferring the match of the thread with the highest priority.
+ * @table: The open-addressed hash table of the cached states.
+ * @capacity: The number of slots in the table, which is a power of two.
+ * @states: The number of cached states.
+ * @bytes: The number of bytes that the cached states take up.
+ * @initial: The state to start in, after a line break or not, or NULL if it
+ * has not been built yet.
+ * @list: The dynamic array that the threads of a new state are gathered in.
+ * @stack: The dynamic array of instructions left to follow while gathering.
+ * @visited: The mark of each instruction, to add each to a state only once.
+ * @mark: The mark of the state being built.
+ */
+typedef struct RegexpDfa {
+  RegexpInst *insts;
+  int start;
+  bool longest;
+  RegexpState **table;
+  int capacity;
+  int states;
+  long bytes;
+  RegexpState *initial[2];
+  int *list;
+  int *stack;
+  int *visited;
+  int mark;
+} RegexpDfa;
+
+/**
+ * struct Regexp - A compiled regular expression.
+ *
+ * @sets: The dynamic array of character sets, each a dynamic array of sorted
+ * ranges that do not overlap.
+ * @bounds: The dynamic array of codepoints at which the class of a character
+ * changes, in order.
+ * @classes: The number of classes of characters, one more than the bounds.
+ * @ascii: The class of each ASCII character.
+ * @newline: The class of the newline character.
+ * @forward: The DFA that finds where the leftmost match ends.
+ * @reverse: The DFA that runs the reversed regex back from the end of a match
+ * to find where it starts.
+ *
+ * This struct holds a regex compiled to a Thompson NFA, which is run as a DFA
+ * whose states are built as the search reaches them, so the search takes time
+ * linear in the length of the text whatever the pattern. Codepoints are
+ * grouped into classes that every character set either matches entirely or not
+ * at all, so each state has one transition per class rather than per
+ * codepoint. The DFAs are changed by every search, so a regex must only be
+ * used by one thread at a time.
+ */
+typedef struct Regexp {
+  RegexpRange **sets;
+  uint32_t *bounds;
+  int classes;
+  int ascii[128];
+  int newline;
+  RegexpDfa forward;
+  RegexpDfa reverse;
+} Regexp;
+
+/**
+ * regexp_compile() - Compiles a regular expression.
+ *
+ * @pattern: The array of unicode codepoints of the pattern.
+ * @len: The length of the array.
+ *
+ * This function parses a pattern and compiles it into a Regexp struct. The
+ * pattern may use literal characters, the . wildcard, which matches anything
+ * but a newline, character sets in brackets with ranges and negation, the
+ * escapes \d, \w, \s and their negations \D, \W and \S, the escapes \n, \t and
+ * \r, groups in parentheses, alternation with |, the anchors ^ and $, which
+ * match at the start and end of a line, and the quantifiers *, +, ?, {n},
+ * {n,} and {n,m}, which are lazy if followed by ?. Matches are leftmost, and
+ * among the matches starting at the same character, the one preferred by the
+ * order of alternatives and the greediness of the quantifiers is reported.
+ * This is the match a backtracking engine such as Perl reports, except when a
+ * repeated group matches empty text: such an engine stops repeating the group
+ * there, while this one may keep repeating it, so it may report a different
+ * match. The regex must be freed with regexp_free(). This function returns
+ * NULL if the pattern is invalid, or if it fails. For error information, use
+ * SDL_GetError().
+ */
+Regexp *regexp_compile(const uint32_t *pattern, int len);
+
+/**
+ * regexp_free() - Frees a compiled regular expression.
+ *
+ * @regex: The regex to free. If NULL is passed, nothing will happen.
+ */
+void regexp_free(Regexp *regex);
+
+/**
+ * regexp_find() - Finds the first match of a regex in a rope.
+ *
+ * @regex: The regex to search for.
+ * @root: The root node of the rope.
+ * @from: The index at or after which the match must start.
+ * @end: The place to store the index after the end of the match.
+ * @cancel: A flag that another thread may set to stop the search, or NULL.
+ *
+ * This function runs the forward DFA over the text of the rope one chunk at a
+ * time with a rope iterator, so the text is never copied out of the rope, until
+ * the leftmost match has ended and no thread that could extend it is left.
+ * The reverse DFA is then run back from the end of the match to find where it
+ * starts. The cancel flag is checked between chunks, so that a search of a
+ * large rope on a reading thread can be stopped within microseconds when the
+ * pattern or the text changes. This function returns the index of the start of
+ * the match, or -1 if there is none. If the index is not within the rope,
+ * memory runs out, or the search is cancelled, it returns -2. For error
+ * information, use SDL_GetError().
+ */
+int regexp_find(Regexp *regex, RopeNode *root, int from, int *end,
+                const _Atomic(bool) *cancel);
+
+/**
+ * regexp_find_all() - Finds every match of a regex in a rope.
+ *
+ * @regex: The regex to search for.
+ * @root: The root node of the rope.
+ * @matches: The dynamic array to append each match to.
+ * @cancel: A flag that another thread may set to stop the search, or NULL.
+ *
+ * This function finds the matches of the regex one after another with
+ * regexp_find(), each starting where the one before it ended, so the matches
+ * do not overlap. After an empty match, the next match starts at least one
+ * character later. The matches are appended to the array in order, and the
+ * array must be freed with arrfree(). This function returns the number of
+ * matches found, or -1 if memory runs out or the search is cancelled, in which
+ * case the matches found so far are left in the array. For error information,
+ * use SDL_GetError().
+ */
+int regexp_find_all(Regexp *regex, RopeNode *root, RegexpMatch **matches,
+                    const _Atomic(bool) *cancel);
+
+#endif
@@ -1,86 +1,463 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <SDL3/SDL_cpuinfo.h>
 #include <SDL3/SDL_error.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_thread.h>
 
+#include "pool.h"
 #include "rope.h"
 #include "stb_ds.h"
 
-void rope_set(RopeNode *node, int w, int refc, uint32_t *val, RopeNode *l, RopeNode *r)
+// Determines how many nodes a path can hold before it is moved to the heap.
+#define ROPE_PATH_LOCAL 64
+
+/*
+ * A stack of nodes along a path from the root of a rope, used in place of
+ * recursion so that operations on deep ropes cannot overflow the C stack. It
+ * starts out in the local array, and only moves to the heap for paths longer
+ * than ROPE_PATH_LOCAL.
+ */
+typedef struct RopePath {
+  RopeNode **nodes;
+  int length;
+  int capacity;
+  RopeNode *local[ROPE_PATH_LOCAL];
+} RopePath;
+
+#ifdef ROPE_INTERN
+
+// Determines the prime modulus and the base of the hash of text, which is the
+// sum of each unit of text times the base raised to the number of units after
+// it, so that the hash of two joined pieces of text follows from theirs.
+#define ROPE_HASH_PRIME ((1ull << 61) - 1)
+#define ROPE_HASH_BASE 0x0f3a5c9d27e4b1ull
+
+__extension__ typedef unsigned __int128 RopeWide;
+
+#endif // ROPE_INTERN
+
+// The empty rope, which is shared by every empty rope. It starts with a
+// reference held by the rope module itself, so it is never freed.
+static RopeNode rope_empty = {
+  .weight = 0, .length = 0, .height = 1, .ref_count = 1,
+#ifdef ROPE_INTERN
+  .scale = 1,
+#endif
+};
+
+// initializes an empty path
+static void rope_path_init(RopePath *path)
+{
+  path->nodes = path->local;
+  path->length = 0;
+  path->capacity = ROPE_PATH_LOCAL;
+}
+
+// pushes a node onto a path, moving the path to the heap if it is full
+static bool rope_path_push(RopePath *path, RopeNode *node)
+{
+  if (path->length == path->capacity) {
+    int capacity = path->capacity * 2;
+    RopeNode **nodes = NULL;
+    if (path->nodes == path->local) {
+      nodes = malloc(capacity * sizeof(RopeNode*));
+      if (nodes != NULL) memcpy(nodes, path->local, sizeof(path->local));
+    } else {
+      nodes = realloc(path->nodes, capacity * sizeof(RopeNode*));
+    }
+    if (nodes == NULL) {
+      SDL_SetError("Failed to allocate memory for rope path");
+      return false;
+    }
+    path->nodes = nodes;
+    path->capacity = capacity;
+  }
+  path->nodes[path->length++] = node;
+  return true;
+}
+
+// frees a path if it was moved to the heap
+static void rope_path_free(RopePath *path)
+{
+  if (path->nodes != path->local) free(path->nodes);
+}
+
+// adds a summary to another, or subtracts it if the sign is -1
+static void rope_summary_add(RopeSummary *summary, RopeSummary other, int sign)
+{
+  summary->bytes += sign * other.bytes;
+  summary->newlines += sign * other.newlines;
+  summary->utf16 += sign * other.utf16;
+}
+
+// returns a metric from the summary of text of the given length
+static int rope_summary_metric(RopeSummary summary, int length, RopeMetric metric)
+{
+  switch (metric) {
+  case ROPE_BYTES: return summary.bytes;
+  case ROPE_NEWLINES: return summary.newlines;
+  case ROPE_UTF16: return summary.utf16;
+  default: return length;
+  }
+}
+
+#ifdef ROPE_UTF8
+
+// returns the number of bytes in the UTF-8 sequence starting with a byte
+static int rope_utf8_length(uint8_t lead)
+{
+  return lead < 0x80 ? 1 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+}
+
+#endif // ROPE_UTF8
+
+// Writing single codepoints into leaves is only needed by edits in place,
+// which ROPE_INTERN turns off.
+#ifndef ROPE_INTERN
+
+// returns the number of units that a codepoint takes up in the text of a leaf
+static int rope_char_units(uint32_t c)
+{
+#ifdef ROPE_UTF8
+  return c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+#else
+  (void)c;
+  return 1;
+#endif
+}
+
+// writes a codepoint into the text of a leaf, returning the number of units
+static int rope_put_char(ROPE_UNIT *dst, uint32_t c)
+{
+#ifdef ROPE_UTF8
+  return rope_encode_utf8(&c, 1, (char*)dst);
+#else
+  *dst = c;
+  return 1;
+#endif
+}
+
+#endif // ROPE_INTERN
+
+// reads the codepoint at the start of some leaf text, storing the number of
+// units it takes up in units
+static uint32_t rope_get_char(const ROPE_UNIT *src, int *units)
+{
+#ifdef ROPE_UTF8
+  *units = rope_utf8_length(src[0]);
+  switch (*units) {
+  case 1: return src[0];
+  case 2: return (uint32_t)(src[0] & 0x1f) << 6 | (src[1] & 0x3f);
+  case 3: return (uint32_t)(src[0] & 0x0f) << 12 | (uint32_t)(src[1] & 0x3f) << 6 | (src[2] & 0x3f);
+  default:
+    return (uint32_t)(src[0] & 0x07) << 18 | (uint32_t)(src[1] & 0x3f) << 12 |
+           (uint32_t)(src[2] & 0x3f) << 6 | (src[3] & 0x3f);
+  }
+#else
+  *units = 1;
+  return *src;
+#endif
+}
+
+// returns the offset within some leaf text of the character at the index
+static int rope_unit_offset(const RopeNode *leaf, int index)
+{
+#ifdef ROPE_UTF8
+  // a leaf of ASCII text has one byte per character
+  if (leaf->summary.bytes == leaf->weight) return index;
+  if (index == leaf->weight) return leaf->summary.bytes;
+  int offset = 0;
+  for (int i = 0; i < index; i++) offset += rope_utf8_length(leaf->value[offset]);
+  return offset;
+#else
+  (void)leaf;
+  return index;
+#endif
+}
+
+// returns the number of units in the text of a leaf
+static int rope_units(const RopeNode *leaf)
+{
+#ifdef ROPE_UTF8
+  return leaf->summary.bytes;
+#else
+  return leaf->weight;
+#endif
+}
+
+// returns the summary of the given number of units of leaf text
+static RopeSummary rope_units_summary(const ROPE_UNIT *value, int units)
+{
+#ifdef ROPE_UTF8
+  return rope_summarize_utf8((const char*)value, units, NULL);
+#else
+  return rope_summarize(value, units);
+#endif
+}
+
+// returns the summary of the first characters of some leaf text
+static RopeSummary rope_value_summary(const ROPE_UNIT *value, int count)
+{
+#ifdef ROPE_UTF8
+  RopeSummary summary = {0};
+  for (int i = 0; i < count; i++) {
+    int units = rope_utf8_length(*value);
+    summary.bytes += units;
+    summary.newlines += *value == '\n';
+    summary.utf16 += units == 4 ? 2 : 1;
+    value += units;
+  }
+  return summary;
+#else
+  return rope_summarize(value, count);
+#endif
+}
+
+#ifdef ROPE_INTERN
+
+// reduces a number below 2^64 modulo the prime of the hash
+static uint64_t rope_hash_mod(uint64_t x)
+{
+  x = (x & ROPE_HASH_PRIME) + (x >> 61);
+  return x >= ROPE_HASH_PRIME ? x - ROPE_HASH_PRIME : x;
+}
+
+// returns the product of two numbers below the prime of the hash modulo it
+static uint64_t rope_hash_mul(uint64_t a, uint64_t b)
+{
+  RopeWide product = (RopeWide)a * b;
+  return rope_hash_mod(((uint64_t)product & ROPE_HASH_PRIME) + (uint64_t)(product >> 61));
+}
+
+// appends the text with the given hash and scale to the text of a node
+static void rope_hash_join(RopeNode *node, uint64_t hash, uint64_t scale)
+{
+  node->hash = rope_hash_mod(rope_hash_mul(node->hash, scale) + hash);
+  node->scale = rope_hash_mul(node->scale, scale);
+}
+
+void rope_rehash(RopeNode *leaf)
+{
+  const ROPE_UNIT *value = leaf->value;
+  int units = rope_units(leaf);
+  uint64_t b2 = rope_hash_mul(ROPE_HASH_BASE, ROPE_HASH_BASE);
+  uint64_t b3 = rope_hash_mul(b2, ROPE_HASH_BASE);
+  uint64_t b4 = rope_hash_mul(b3, ROPE_HASH_BASE);
+  uint64_t hash = 0;
+  uint64_t scale = 1;
+
+  // hash four units at a time, so that only one multiplication a block
+  // depends on the hash of the block before it
+  int i = 0;
+  for (; i + 4 <= units; i += 4) {
+    uint64_t block = rope_hash_mul(value[i], b3) + rope_hash_mul(value[i + 1], b2) +
+                     rope_hash_mul(value[i + 2], ROPE_HASH_BASE) + value[i + 3];
+    hash = rope_hash_mod(rope_hash_mul(hash, b4) + rope_hash_mod(block));
+    scale = rope_hash_mul(scale, b4);
+  }
+  for (; i < units; i++) {
+    hash = rope_hash_mod(rope_hash_mul(hash, ROPE_HASH_BASE) + value[i]);
+    scale = rope_hash_mul(scale, ROPE_HASH_BASE);
+  }
+  leaf->hash = hash;
+  leaf->scale = scale;
+}
+
+#endif // ROPE_INTERN
+
+void rope_set(RopeNode *node, int w, int refc, ROPE_UNIT *val, RopeNode *l, RopeNode *r)
 {
   node->weight = w;
   node->ref_count = refc;
   node->value = val;
   node->left = l;
   node->right = r;
-  if (node->left != NULL) node->left->ref_count++;
-  if (node->right != NULL) node->right->ref_count++;
+#ifdef ROPE_UTF8
+  node->map = NULL;
+#endif
+  node->height = 1;
+  node->length = l == NULL && r == NULL ? w : 0;
+  node->summary = l == NULL && r == NULL && val != NULL ? rope_value_summary(val, w)
+                                                        : (RopeSummary){0};
+#ifdef ROPE_INTERN
+  node->hash = 0;
+  node->scale = 1;
+  if (l == NULL && r == NULL && val != NULL) rope_rehash(node);
+#endif
+  if (node->left != NULL) {
+    rope_ref(node->left);
+    node->height = node->left->height + 1;
+    node->length += node->left->length;
+    rope_summary_add(&node->summary, node->left->summary, 1);
+#ifdef ROPE_INTERN
+    rope_hash_join(node, node->left->hash, node->left->scale);
+#endif
+  }
+  if (node->right != NULL) {
+    rope_ref(node->right);
+    if (node->right->height >= node->height) node->height = node->right->height + 1;
+    node->length += node->right->length;
+    rope_summary_add(&node->summary, node->right->summary, 1);
+#ifdef ROPE_INTERN
+    rope_hash_join(node, node->right->hash, node->right->scale);
+#endif
+  }
 }
 
-RopeNode *rope_merge(RopeNode **nodes, int length)
+// creates a leaf of the given weight holding a copy of the given number of
+// units of leaf text, or uninitialized text if NULL, in which case the caller
+// sets its summary
+static RopeNode *rope_leaf_units(const ROPE_UNIT *value, int weight, int units)
 {
-  // return if array only consists of one node, the root node
-  if (length == 1) {
-    RopeNode *root = nodes[0];
-    free(nodes);
-    return root;
-  }
-
-  // calculate length of next level of nodes and allocate memory for array
-  int new_length = (length + 1)/ 2;
-  RopeNode **new_nodes = malloc(new_length * sizeof(RopeNode*));
-  if (new_nodes == NULL) {
-    SDL_SetError("Failed to allocate memory in rope_merge");
+  RopeNode *leaf = pool_alloc(sizeof(RopeNode));
+  ROPE_UNIT *copy = pool_alloc(units * sizeof(ROPE_UNIT));
+  if (leaf == NULL || copy == NULL) {
+    SDL_SetError("Failed to allocate memory for leaf");
+    pool_free(leaf, sizeof(RopeNode));
+    pool_free(copy, units * sizeof(ROPE_UNIT));
     return NULL;
   }
-
-  // null initialize array of new nodes
-  for (int i = 0; i < new_length; i++) {
-    new_nodes[i] = NULL;
+  rope_set(leaf, weight, 1, NULL, NULL, NULL);
+  leaf->value = copy;
+  if (value != NULL) {
+    memcpy(copy, value, units * sizeof(ROPE_UNIT));
+    leaf->summary = rope_units_summary(copy, units);
+#ifdef ROPE_INTERN
+    rope_rehash(leaf);
+#endif
   }
+  return leaf;
+}
+
+// creates a leaf holding a copy of the text
+static RopeNode *rope_leaf(const uint32_t *text, int weight)
+{
+#ifdef ROPE_UTF8
+  RopeSummary summary = rope_summarize(text, weight);
+  RopeNode *leaf = rope_leaf_units(NULL, weight, summary.bytes);
+  if (leaf == NULL) return NULL;
+  rope_encode_utf8(text, weight, (char*)leaf->value);
+  leaf->summary = summary;
+#ifdef ROPE_INTERN
+  rope_rehash(leaf);
+#endif
+  return leaf;
+#else
+  return rope_leaf_units(text, weight, weight);
+#endif
+}
 
-  // iterate through pairs of nodes, creating parent nodes
-  for (int i = 0; i < length / 2; i++) {
-    RopeNode* left = nodes[2 * i];
-    RopeNode* right = nodes[2 * i + 1];
-    new_nodes[i] = malloc(sizeof(RopeNode));
-    if (new_nodes[i] == NULL) goto cleanup;
-    rope_set(new_nodes[i], rope_length(left), 1, NULL, left, right);
+// turns a block into the parent of two nodes, taking over the references that
+// the caller held to them
+static RopeNode *rope_parent(void *block, RopeNode *left, RopeNode *right)
+{
+  RopeNode *parent = block;
+  rope_set(parent, left->length, 1, NULL, left, right);
+  left->ref_count--;
+  right->ref_count--;
+  return parent;
+}
+
+// merges neighbouring nodes pairwise in place, for up to the given number of
+// levels, taking the parents in order from the blocks. If a level has an odd
+// number of nodes, the last three are merged together. Returns the number of
+// nodes left at the top.
+static int rope_pair(RopeNode **nodes, int count, int levels, void **parents)
+{
+  for (int level = 0; level < levels && count > 1; level++) {
+    int half = count / 2;
+    for (int i = 0; i < half; i++) {
+      nodes[i] = rope_parent(*parents++, nodes[2 * i], nodes[2 * i + 1]);
+    }
+    if (count % 2 != 0) {
+      nodes[half - 1] = rope_parent(*parents++, nodes[half - 1], nodes[count - 1]);
+    }
+    count = half;
   }
+  return count;
+}
 
-  // handle if length is odd by adding last node as parent node
-  if (length % 2 != 0) {
-    RopeNode* left = nodes[length - 1];
-    new_nodes[new_length - 1] = malloc(sizeof(RopeNode));
-    if (new_nodes[new_length - 1] == NULL) goto cleanup;
-    rope_set(new_nodes[new_length - 1], rope_length(left), 1, NULL, left, NULL);
+RopeNode *rope_merge(RopeNode **nodes, int length)
+{
+  // allocate all of the parents up front
+  void **parents = malloc(length * sizeof(void*));
+  if (parents == NULL || !pool_alloc_many(sizeof(RopeNode), length - 1, parents)) {
+    SDL_SetError("Failed to allocate memory in rope_merge");
+    free(parents);
+    rope_arr_free(nodes, length);
+    return NULL;
   }
 
-  rope_arr_free(nodes, length);
-  return rope_merge(new_nodes, new_length);
+  rope_pair(nodes, length, length, parents);
+  RopeNode *root = nodes[0];
+  free(parents);
+  free(nodes);
+  return root;
+}
 
-  // cleanup new nodes if memory allocation fails
- cleanup:
-  SDL_SetError("Failed to allocate memory in rope_merge");
-  rope_arr_free(new_nodes, new_length);
-  rope_arr_free(nodes, length);
-  return NULL;
+#ifndef ROPE_INTERN
+
+/*
+ * A share of the work of rope_build_threads(), which fills in a run of leaves
+ * and merges them up to a given level of the tree.
+ */
+typedef struct RopeBuildTask {
+  const uint32_t *text;
+  int length;
+  void **blocks;
+  void **values;
+#ifdef ROPE_UTF8
+  const RopeSummary *summaries;
+#endif
+  RopeNode **nodes;
+  void **parents;
+  int start;
+  int end;
+  int levels;
+  int count;
+} RopeBuildTask;
+
+// runs a build task, which only writes to memory that was allocated for it
+static int rope_build_task(void *data)
+{
+  RopeBuildTask *task = data;
+  for (int i = task->start; i < task->end; i++) {
+    int start = i * LEAF_WEIGHT;
+    int weight = task->length - start < LEAF_WEIGHT ? task->length - start : LEAF_WEIGHT;
+#ifdef ROPE_UTF8
+    rope_encode_utf8(&task->text[start], weight, task->values[i]);
+    RopeNode *leaf = task->blocks[i];
+    rope_set(leaf, weight, 1, NULL, NULL, NULL);
+    leaf->value = task->values[i];
+    leaf->summary = task->summaries[i];
+#else
+    memcpy(task->values[i], &task->text[start], weight * sizeof(uint32_t));
+    rope_set(task->blocks[i], weight, 1, task->values[i], NULL, NULL);
+#endif
+    task->nodes[i] = task->blocks[i];
+  }
+  task->count = rope_pair(&task->nodes[task->start], task->end - task->start, task->levels,
+                          task->parents);
+  return 0;
 }
 
 RopeNode *rope_build(uint32_t *text, int length)
 {
-  // handle empty case
+  return rope_build_threads(text, length, 0);
+}
+
+RopeNode *rope_build_threads(uint32_t *text, int length, int threads)
+{
+  // handle empty case by sharing the empty rope
   if (length == 0) {
-    RopeNode *empty_node = malloc(sizeof(RopeNode));
-    if (empty_node == NULL) {
-      SDL_SetError("Failed to allocate memory for empty node");
-      return NULL;
-    }
-    rope_set(empty_node, 0, 1, NULL, NULL, NULL);
-    return empty_node;
+    rope_ref(&rope_empty);
+    return &rope_empty;
   }
   
   // guard against negative length
@@ -89,54 +466,159 @@ RopeNode *rope_build(uint32_t *text, int length)
     return NULL;
   }
 
-  // find amount of leaves and allocate memory for them
-  int new_length = (length + LEAF_WEIGHT - 1) / LEAF_WEIGHT;
-  RopeNode **new_nodes = malloc(new_length * sizeof(RopeNode*));
-  if (new_nodes == NULL) {
+  // allocate the arrays of blocks, and then every node and leaf text up front,
+  // with the leaves before the parents
+  int count = (length + LEAF_WEIGHT - 1) / LEAF_WEIGHT;
+  void **blocks = malloc((2 * count - 1) * sizeof(void*));
+  void **values = malloc(count * sizeof(void*));
+  RopeNode **nodes = malloc(count * sizeof(RopeNode*));
+  if (blocks == NULL || values == NULL || nodes == NULL) {
     SDL_SetError("Failed to allocate memory in rope_build");
-    return NULL;
+    goto fail;
+  }
+  if (!pool_alloc_many(sizeof(RopeNode), 2 * count - 1, blocks)) goto fail;
+#ifdef ROPE_UTF8
+  // the size of the text of a leaf depends on its characters, so every leaf is
+  // measured first, and its text allocated on its own
+  RopeSummary *summaries = malloc(count * sizeof(RopeSummary));
+  if (summaries == NULL) {
+    SDL_SetError("Failed to allocate memory in rope_build");
+    goto fail_values;
+  }
+  for (int i = 0; i < count; i++) {
+    int start = i * LEAF_WEIGHT;
+    int weight = length - start < LEAF_WEIGHT ? length - start : LEAF_WEIGHT;
+    summaries[i] = rope_summarize(&text[start], weight);
+    values[i] = pool_alloc(summaries[i].bytes);
+    if (values[i] == NULL) {
+      while (i-- > 0) pool_free(values[i], summaries[i].bytes);
+      free(summaries);
+      goto fail_values;
+    }
   }
+#else
+  int full = length / LEAF_WEIGHT;
+  if (!pool_alloc_many(LEAF_WEIGHT * sizeof(uint32_t), full, values)) goto fail_values;
+  if (full < count) {
+    values[full] = pool_alloc(length % LEAF_WEIGHT * sizeof(uint32_t));
+    if (values[full] == NULL) goto fail_last;
+  }
+#endif
 
-  // null initialize array of new nodes
-  for (int i = 0; i < new_length; i++) {
-    new_nodes[i] = NULL;
+  // split the tree between the tasks at the lowest level with at least one
+  // node for each task, so that the tasks build whole subtrees
+  if (threads <= 0) threads = SDL_GetNumLogicalCPUCores();
+  if (threads > ROPE_BUILD_MAX_THREADS) threads = ROPE_BUILD_MAX_THREADS;
+  int tasks = length / ROPE_BUILD_MIN_TEXT < threads ? length / ROPE_BUILD_MIN_TEXT : threads;
+  if (tasks < 1) tasks = 1;
+  int levels = 0;
+  int top = count;
+  while (top / 2 >= tasks) {
+    top /= 2;
+    levels++;
   }
 
-  // memory pointer for each leaf's text
-  uint32_t *split_text = NULL;
+  // give each task its share of the leaves, along with the parents it needs,
+  // which follow on from the parents of the task before it
+  RopeBuildTask task[ROPE_BUILD_MAX_THREADS];
+  SDL_Thread *thread[ROPE_BUILD_MAX_THREADS];
+  for (int i = 0; i < tasks; i++) {
+    int first = (int)((int64_t)top * i / tasks);
+    int last = (int)((int64_t)top * (i + 1) / tasks);
+    task[i] = (RopeBuildTask){
+      .text = text, .length = length, .blocks = blocks, .values = values, .nodes = nodes,
+      .start = first << levels, .end = i == tasks - 1 ? count : last << levels,
+      .levels = levels,
+    };
+#ifdef ROPE_UTF8
+    task[i].summaries = summaries;
+#endif
+    task[i].parents = blocks + count + (task[i].start - first);
+  }
 
-  // iterate through text and create new leaves
-  for (int i = 0; i < new_length; i++) {
-    // handle weight if there is a remainder
-    int weight = LEAF_WEIGHT;
-    if (i == new_length - 1 && length % LEAF_WEIGHT != 0) {
-      weight = length % LEAF_WEIGHT;
-    }
+  // run the first task on this thread, and the rest on their own threads,
+  // falling back to this thread if one cannot be started
+  for (int i = 1; i < tasks; i++) {
+    thread[i] = SDL_CreateThread(rope_build_task, "rope_build", &task[i]);
+  }
+  rope_build_task(&task[0]);
+  for (int i = 1; i < tasks; i++) {
+    if (thread[i] == NULL) rope_build_task(&task[i]);
+    else SDL_WaitThread(thread[i], NULL);
+  }
 
-    // allocate new rope node
-    new_nodes[i] = malloc(sizeof(RopeNode));
-    if (new_nodes[i] == NULL) goto cleanup;
+  // gather the subtrees of the tasks and merge them into the root
+  int subtrees = 0;
+  for (int i = 0; i < tasks; i++) {
+    memmove(&nodes[subtrees], &nodes[task[i].start], task[i].count * sizeof(RopeNode*));
+    subtrees += task[i].count;
+  }
+  assert(subtrees == top);
+  rope_pair(nodes, subtrees, count, blocks + 2 * count - top);
+  RopeNode *root = nodes[0];
+#ifdef ROPE_UTF8
+  free(summaries);
+#endif
+  free(blocks);
+  free(values);
+  free(nodes);
+  return root;
+
+#ifndef ROPE_UTF8
+ fail_last:
+  for (int i = 0; i < full; i++) pool_free(values[i], LEAF_WEIGHT * sizeof(uint32_t));
+#endif
+ fail_values:
+  for (int i = 0; i < 2 * count - 1; i++) pool_free(blocks[i], sizeof(RopeNode));
+ fail:
+  free(blocks);
+  free(values);
+  free(nodes);
+  return NULL;
+}
 
-    // allocate memory for the leaf's text
-    split_text = malloc(weight * sizeof(uint32_t));
-    if (split_text == NULL) goto cleanup;
+#else
 
-    // copy text into node and set properties
-    memcpy(split_text, &text[LEAF_WEIGHT * i], weight * sizeof(uint32_t));
-    rope_set(new_nodes[i], weight, 1, split_text, NULL, NULL);
+// builds a rope out of interned leaves, one leaf at a time on the calling
+// thread, since each leaf is looked up in the table as it is built
+RopeNode *rope_build(uint32_t *text, int length)
+{
+  // handle empty case by sharing the empty rope
+  if (length == 0) {
+    rope_ref(&rope_empty);
+    return &rope_empty;
   }
 
-  // merge all of the leaves into a rope tree recursively
-  return rope_merge(new_nodes, new_length);
+  // guard against negative length
+  if (length < 0) {
+    SDL_SetError("Cannot build a rope with negative length");
+    return NULL;
+  }
 
-  // handle cleanup if memory allocation fails
- cleanup:
-  SDL_SetError("Failed to allocate memory in rope_build");
-  rope_arr_free(new_nodes, new_length);
-  free(split_text);
-  return NULL;
+  int count = (length + LEAF_WEIGHT - 1) / LEAF_WEIGHT;
+  RopeNode **nodes = malloc(count * sizeof(RopeNode*));
+  if (nodes == NULL) {
+    SDL_SetError("Failed to allocate memory in rope_build");
+    return NULL;
+  }
+  for (int i = 0; i < count; i++) {
+    int start = i * LEAF_WEIGHT;
+    int weight = length - start < LEAF_WEIGHT ? length - start : LEAF_WEIGHT;
+    RopeNode *leaf = rope_leaf(&text[start], weight);
+    if (leaf == NULL) {
+      rope_arr_free(nodes, i);
+      return NULL;
+    }
+    nodes[i] = rope_intern(leaf);
+  }
+  if (count > 1) return rope_merge(nodes, count);
+  RopeNode *root = nodes[0];
+  free(nodes);
+  return root;
 }
 
+#endif // ROPE_INTERN
+
 RopeNode **rope_collect(RopeNode *root)
 {
   // exit if there is no rope
@@ -164,7 +646,7 @@ RopeNode **rope_collect(RopeNode *root)
     // this is a leaf
     else {
       arrput(leaves, curr);
-      curr->ref_count++;
+      rope_ref(curr);
       curr = NULL;
       while (curr == NULL && arrlen(nodes) > 0) {
         curr = arrlast(nodes)->right;
@@ -178,45 +660,169 @@ RopeNode **rope_collect(RopeNode *root)
   return leaves;
 }
 
-uint32_t *rope_text(RopeNode *root)
+// descends from the root of an iterator to the leaf holding the character at
+// the index, or to the last leaf if the index is the length of the rope,
+// keeping the path if it fits
+static void rope_iter_seek(RopeIter *iter, int index)
 {
-  // collect all the leaves from the rope
-  RopeNode **leaves = rope_collect(root);
-  if (leaves == NULL) return NULL;
+  RopeNode *node = iter->root;
+  int start = 0;
+  iter->depth = 0;
+  while (node->left != NULL) {
+    bool right = index - start >= node->weight;
+    if (iter->depth >= 0 && iter->depth < ROPE_ITER_DEPTH) {
+      iter->path[iter->depth] = node;
+      iter->steps[iter->depth++] = right;
+    } else {
+      iter->depth = -1;
+    }
+    if (right) {
+      start += node->weight;
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  iter->leaf = node;
+  iter->leaf_start = start;
+}
 
-  // create new dynamic array for text
-  uint32_t *text = NULL;
+// moves an iterator to the next or previous leaf, returning false if there is
+// none. The chunk is left for the caller to update.
+static bool rope_iter_step(RopeIter *iter, bool forward)
+{
+  // find the leaf by its index if the path did not fit
+  if (iter->depth < 0) {
+    int index = forward ? iter->leaf_start + iter->leaf->weight : iter->leaf_start - 1;
+    if (index < 0 || index >= iter->root->length) return false;
+    rope_iter_seek(iter, index);
+    return true;
+  }
+
+  // go up to the last node where the path can go the other way
+  int depth = iter->depth;
+  while (depth > 0 && iter->steps[depth - 1] == forward) depth--;
+  if (depth == 0) return false;
+  iter->steps[depth - 1] = forward;
+  iter->depth = depth;
+  RopeNode *node = forward ? iter->path[depth - 1]->right : iter->path[depth - 1]->left;
 
-  // iterate through leaves and add to the dynamic array
-  for (int i = 0; i < arrlen(leaves); i++) {
-    RopeNode *leaf = leaves[i];
-    rope_deref(leaf);
-    uint32_t *value = leaf->value;
-    for (int j = 0; j < leaf->weight; j++) {
-      arrput(text, value[j]);
+  // and go down the other side to its first or last leaf
+  while (node->left != NULL) {
+    if (iter->depth >= 0 && iter->depth < ROPE_ITER_DEPTH) {
+      iter->path[iter->depth] = node;
+      iter->steps[iter->depth++] = !forward;
+    } else {
+      iter->depth = -1;
     }
+    node = forward ? node->left : node->right;
   }
+  iter->leaf_start += forward ? iter->leaf->weight : -node->weight;
+  iter->leaf = node;
+  return true;
+}
 
-  arrfree(leaves);
-  return text;
+// returns the codepoints of the leaf an iterator has just moved to, which are
+// first decoded into the iterator if the leaf holds UTF-8
+static const uint32_t *rope_iter_load(RopeIter *iter)
+{
+#ifdef ROPE_UTF8
+  if (!iter->decode) return iter->decoded;
+  rope_decode_utf8((const char*)iter->leaf->value, iter->leaf->summary.bytes, iter->decoded,
+                   iter->leaf->weight);
+  return iter->decoded;
+#else
+  return iter->leaf->value;
+#endif
 }
 
-void rope_deref(RopeNode *node)
+// returns the codepoints of the leaf an iterator is already in
+static const uint32_t *rope_iter_text(RopeIter *iter)
 {
-  // guard for null node and decrement ref count
-  if (node == NULL) return;
-  node->ref_count--;
+#ifdef ROPE_UTF8
+  return iter->decoded;
+#else
+  return iter->leaf->value;
+#endif
+}
+
+// points an iterator at the text of its leaf between two indices
+static void rope_iter_chunk(RopeIter *iter, const uint32_t *text, int start, int end)
+{
+  iter->chunk = text + (start - iter->leaf_start);
+  iter->len = end - start;
+  iter->start = start;
+#ifdef ROPE_UTF8
+  int offset = rope_unit_offset(iter->leaf, start - iter->leaf_start);
+  iter->bytes = (const char*)iter->leaf->value + offset;
+  iter->size = rope_unit_offset(iter->leaf, end - iter->leaf_start) - offset;
+#endif
+}
+
+bool rope_iter_init(RopeIter *iter, RopeNode *root, int index)
+{
+  if (index < 0 || index > root->length) {
+    SDL_SetError("Index is outside of the rope");
+    return false;
+  }
+  iter->root = root;
+#ifdef ROPE_UTF8
+  iter->decode = true;
+#endif
+  rope_iter_seek(iter, index);
+  rope_iter_chunk(iter, rope_iter_load(iter), index, iter->leaf_start + iter->leaf->weight);
+  return true;
+}
 
-  // if ref count is zero, it is safe to free this node
-  if (node->ref_count == 0) {
-    // unreference the children
-    rope_deref(node->left);
-    rope_deref(node->right);
+bool rope_iter_next(RopeIter *iter)
+{
+  // step to the rest of the current leaf, or otherwise to the next leaf
+  int end = iter->start + iter->len;
+  const uint32_t *text = rope_iter_text(iter);
+  if (end == iter->leaf_start + iter->leaf->weight) {
+    if (!rope_iter_step(iter, true)) return false;
+    end = iter->leaf_start;
+    text = rope_iter_load(iter);
+  }
+  rope_iter_chunk(iter, text, end, iter->leaf_start + iter->leaf->weight);
+  return true;
+}
 
-    // free the node
-    free(node->value);
-    free(node);
+bool rope_iter_prev(RopeIter *iter)
+{
+  // step to the start of the current leaf, or otherwise to the previous leaf
+  int end = iter->start;
+  const uint32_t *text = rope_iter_text(iter);
+  if (end == iter->leaf_start) {
+    if (!rope_iter_step(iter, false)) return false;
+    end = iter->leaf_start + iter->leaf->weight;
+    text = rope_iter_load(iter);
   }
+  rope_iter_chunk(iter, text, iter->leaf_start, end);
+  return true;
+}
+
+uint32_t *rope_text(RopeNode *root)
+{
+  // exit if there is no rope
+  if (root == NULL) {
+    SDL_SetError("Rope does not exist");
+    return NULL;
+  }
+  if (root->length == 0) return NULL;
+
+  RopeIter iter;
+  if (!rope_iter_init(&iter, root, 0)) return NULL;
+
+  // allocate the whole array, and copy the text of each leaf into it
+  uint32_t *text = NULL;
+  arrsetlen(text, root->length);
+  uint32_t *dst = text;
+  do {
+    memcpy(dst, iter.chunk, iter.len * sizeof(uint32_t));
+    dst += iter.len;
+  } while (rope_iter_next(&iter));
+  return text;
 }
 
 void rope_arr_free(RopeNode **arr, int length)
@@ -233,159 +839,668 @@ void rope_arr_free(RopeNode **arr, int length)
 
 int rope_length(RopeNode *root)
 {
-  if (root->right == NULL) return root->weight;
-  else return root->weight + rope_length(root->right);
+  return root->length;
+}
+
+int rope_measure(RopeNode *root, RopeMetric metric, int index)
+{
+  if (index < 0 || index > root->length) {
+    SDL_SetError("Index is outside of the rope");
+    return -1;
+  }
+
+  // add up the summaries of the left subtrees passed on the way to the leaf
+  int measure = 0;
+  while (root->left != NULL) {
+    if (index >= root->weight) {
+      measure += rope_summary_metric(root->left->summary, root->left->length, metric);
+      index -= root->weight;
+      root = root->right;
+    } else {
+      root = root->left;
+    }
+  }
+  RopeSummary summary = rope_units_summary(root->value, rope_unit_offset(root, index));
+  return measure + rope_summary_metric(summary, index, metric);
+}
+
+int rope_seek(RopeNode *root, RopeMetric metric, int value)
+{
+  if (value < 0 || value > rope_summary_metric(root->summary, root->length, metric)) {
+    SDL_SetError("Value is outside of the rope");
+    return -1;
+  }
+
+  // descend to the leaf where the measure reaches the value, using the
+  // summaries of the left subtrees
+  int index = 0;
+  while (root->left != NULL) {
+    int left = rope_summary_metric(root->left->summary, root->left->length, metric);
+    if (value > left) {
+      value -= left;
+      index += root->weight;
+      root = root->right;
+    } else {
+      root = root->left;
+    }
+  }
+
+  // and measure the text of the leaf until it does
+  const ROPE_UNIT *text = root->value;
+  int i = 0;
+  while (value > 0) {
+    int units;
+    uint32_t c = rope_get_char(text, &units);
+    value -= rope_summary_metric(rope_summarize(&c, 1), 1, metric);
+    text += units;
+    i++;
+  }
+  return index + i;
 }
 
 int rope_height(RopeNode *root, int curr_height)
 {
   if (root == NULL) return curr_height;
-  curr_height++;
-  int lh = rope_height(root->left, curr_height);
-  int rh = rope_height(root->right, curr_height);
-  return lh > rh ? lh : rh;
+  return curr_height + root->height;
+}
+
+// creates a new parent node for two subtrees, which may not be NULL
+static RopeNode *rope_node(RopeNode *left, RopeNode *right)
+{
+  RopeNode *node = pool_alloc(sizeof(RopeNode));
+  if (node == NULL) return NULL;
+  rope_set(node, left->length, 1, NULL, left, right);
+  return node;
+}
+
+// creates a new parent node for two subtrees whose heights differ by at most
+// ROPE_BALANCE + 1, rotating the taller side once or twice to rebalance it
+static RopeNode *rope_balance(RopeNode *left, RopeNode *right)
+{
+  RopeNode *outer = NULL;               // new child on the side of the shorter subtree
+  RopeNode *inner = NULL;               // new child on the side of the taller subtree
+  RopeNode *root = NULL;
+
+  // the left subtree is too tall, so rotate right
+  if (left->height > right->height + ROPE_BALANCE) {
+    RopeNode *ll = left->left;
+    RopeNode *lr = left->right;
+    if (ll->height >= lr->height) {
+      outer = rope_node(lr, right);
+      if (outer != NULL) root = rope_node(ll, outer);
+    } else {
+      inner = rope_node(ll, lr->left);
+      outer = rope_node(lr->right, right);
+      if (inner != NULL && outer != NULL) root = rope_node(inner, outer);
+    }
+  }
+
+  // the right subtree is too tall, so rotate left
+  else if (right->height > left->height + ROPE_BALANCE) {
+    RopeNode *rl = right->left;
+    RopeNode *rr = right->right;
+    if (rr->height >= rl->height) {
+      outer = rope_node(left, rl);
+      if (outer != NULL) root = rope_node(outer, rr);
+    } else {
+      outer = rope_node(left, rl->left);
+      inner = rope_node(rl->right, rr);
+      if (inner != NULL && outer != NULL) root = rope_node(outer, inner);
+    }
+  }
+
+  // otherwise the subtrees are balanced enough to be siblings
+  else {
+    return rope_node(left, right);
+  }
+
+  // the new root holds the only references to the rebuilt children
+  rope_deref(outer);
+  rope_deref(inner);
+  return root;
+}
+
+// rebuilds the nodes along a path from the bottom up, replacing the child on
+// the given side of each node with the rebuilt subtree below it, and
+// rebalancing each new node. The reference to child is taken over.
+static RopeNode *rope_rebuild(RopePath *path, RopeNode *child, bool right)
+{
+  for (int i = path->length - 1; i >= 0 && child != NULL; i--) {
+    RopeNode *node = path->nodes[i];
+    RopeNode *parent = right ? rope_balance(node->left, child) : rope_balance(child, node->right);
+    rope_deref(child);
+    child = parent;
+  }
+  rope_path_free(path);
+  return child;
+}
+
+// joins two non-empty ropes by descending the spine of the taller one until
+// the heights are close, and then rebalancing on the way back up
+static RopeNode *rope_join(RopeNode *first, RopeNode *second)
+{
+  RopePath path;
+  rope_path_init(&path);
+
+  // the first rope is taller, so join into its right spine
+  if (first->height > second->height + ROPE_BALANCE) {
+    RopeNode *node = first;
+    while (node->height > second->height + ROPE_BALANCE) {
+      if (!rope_path_push(&path, node)) goto cleanup;
+      node = node->right;
+    }
+    return rope_rebuild(&path, rope_node(node, second), true);
+  }
+
+  // the second rope is taller, so join into its left spine
+  if (second->height > first->height + ROPE_BALANCE) {
+    RopeNode *node = second;
+    while (node->height > first->height + ROPE_BALANCE) {
+      if (!rope_path_push(&path, node)) goto cleanup;
+      node = node->left;
+    }
+    return rope_rebuild(&path, rope_node(first, node), false);
+  }
+
+  return rope_node(first, second);
+
+ cleanup:
+  rope_path_free(&path);
+  return NULL;
+}
+
+// returns the leftmost or rightmost leaf of a rope
+static RopeNode *rope_edge(RopeNode *root, bool right)
+{
+  while (root->left != NULL) root = right ? root->right : root->left;
+  return root;
+}
+
+// creates a copy of a rope with its leftmost or rightmost leaf replaced
+static RopeNode *rope_replace_edge(RopeNode *root, RopeNode *leaf, bool right)
+{
+  RopePath path;
+  rope_path_init(&path);
+  for (RopeNode *node = root; node->left != NULL; node = right ? node->right : node->left) {
+    if (!rope_path_push(&path, node)) {
+      rope_path_free(&path);
+      return NULL;
+    }
+  }
+  rope_ref(leaf);
+  return rope_rebuild(&path, leaf, right);
+}
+
+// creates a copy of a rope with its leftmost or rightmost leaf removed,
+// rebalancing on the way back up. The root may not be a leaf.
+static RopeNode *rope_remove_edge(RopeNode *root, bool right)
+{
+  RopePath path;
+  rope_path_init(&path);
+
+  // descend to the parent of the leaf
+  RopeNode *node = root;
+  while ((right ? node->right : node->left)->left != NULL) {
+    if (!rope_path_push(&path, node)) {
+      rope_path_free(&path);
+      return NULL;
+    }
+    node = right ? node->right : node->left;
+  }
+
+  // replace the parent with the other child
+  RopeNode *other = right ? node->left : node->right;
+  rope_ref(other);
+  return rope_rebuild(&path, other, right);
+}
+
+// creates a leaf holding the text of two leaves
+static RopeNode *rope_merge_leaves(RopeNode *first, RopeNode *second)
+{
+  int units = rope_units(first);
+  RopeNode *leaf = rope_leaf_units(NULL, first->weight + second->weight,
+                                   units + rope_units(second));
+  if (leaf == NULL) return NULL;
+  memcpy(leaf->value, first->value, units * sizeof(ROPE_UNIT));
+  memcpy(leaf->value + units, second->value, rope_units(second) * sizeof(ROPE_UNIT));
+  leaf->summary = first->summary;
+  rope_summary_add(&leaf->summary, second->summary, 1);
+#ifdef ROPE_INTERN
+  leaf->hash = first->hash;
+  leaf->scale = first->scale;
+  rope_hash_join(leaf, second->hash, second->scale);
+#endif
+  return leaf;
 }
 
 RopeNode *rope_concat(RopeNode *first, RopeNode *second)
 {
   // skip if one of the ropes is empty
   if (first->weight == 0) {
-    second->ref_count++;
+    rope_ref(second);
     return second;
   } else if (second->weight == 0) {
-    first->ref_count++;
+    rope_ref(first);
     return first;
   }
   
-  // allocate memory for new root node
-  RopeNode *root = malloc(sizeof(RopeNode));
-  if (root == NULL) {
-    SDL_SetError("Failed to allocate memory for node");
-    return NULL;
-  }
+  // join the two ropes under a new root if the leaves at the seam are too big
+  // to coalesce
+  RopeNode *last = rope_edge(first, true);
+  RopeNode *head = rope_edge(second, false);
+  if (last->weight + head->weight > LEAF_WEIGHT) return rope_join(first, second);
 
-  // set two nodes to be children of new root node
-  rope_set(root, rope_length(first), 1, NULL, first, second);
+  // otherwise move the text of the first leaf of the second rope into the last
+  // leaf of the first rope
+  RopeNode *leaf = rope_merge_leaves(last, head);
+  if (leaf == NULL) return NULL;
+  RopeNode *left = rope_replace_edge(first, leaf, true);
+  rope_deref(leaf);
+  if (left == NULL || second->left == NULL) return left;
+  RopeNode *right = rope_remove_edge(second, false);
+  RopeNode *root = NULL;
+  if (right != NULL) root = rope_join(left, right);
+  rope_deref(left);
+  rope_deref(right);
   return root;
 }
 
 RopeIndex rope_index(RopeNode *root, int index)
 {
-  if (index >= root->weight) return rope_index(root->right, index - root->weight);
-  else if (root->left != NULL) return rope_index(root->left, index);
+  // descend to the leaf containing the index
+  while (root->left != NULL) {
+    if (index >= root->weight) {
+      index -= root->weight;
+      root = root->right;
+    } else {
+      root = root->left;
+    }
+  }
+
+  int units;
+  RopeIndex idx = {
+    .node = root,
+    .c = rope_get_char(root->value + rope_unit_offset(root, index), &units),
+    .n_idx = index
+  };
+  return idx;
+}
+
+// creates a rope holding the text of a leaf between two offsets, sharing the
+// leaf if that is all of its text, and pointing into the same file if the leaf
+// points into a mapped file
+static RopeNode *rope_piece(RopeNode *leaf, int from, int to)
+{
+  if (from == to) return rope_build(NULL, 0);
+  if (from == 0 && to == leaf->weight) {
+    rope_ref(leaf);
+    return leaf;
+  }
+  int start = rope_unit_offset(leaf, from);
+  int end = rope_unit_offset(leaf, to);
+#ifdef ROPE_UTF8
+  if (leaf->map != NULL) {
+    RopeNode *piece = pool_alloc(sizeof(RopeNode));
+    if (piece == NULL) {
+      SDL_SetError("Failed to allocate memory for leaf");
+      return NULL;
+    }
+    rope_set(piece, to - from, 1, NULL, NULL, NULL);
+    piece->value = leaf->value + start;
+    piece->summary = rope_units_summary(piece->value, end - start);
+#ifdef ROPE_INTERN
+    rope_rehash(piece);
+#endif
+    piece->map = leaf->map;
+    piece->map->ref_count++;
+    return piece;
+  }
+#endif
+  return rope_leaf_units(leaf->value + start, to - from, end - start);
+}
+
+// descends from a node to the leaf containing the position before which the
+// rope is cut, where a position at the end of a leaf is in that leaf, pushing
+// the subtrees that hang off the left and right of the path onto the given
+// paths. Stores the offset of the position within the leaf in pos.
+static RopeNode *rope_descend(RopeNode *node, int *pos, RopePath *lefts, RopePath *rights)
+{
+  while (node->left != NULL) {
+    if (*pos > node->weight) {
+      if (!rope_path_push(lefts, node->left)) return NULL;
+      *pos -= node->weight;
+      node = node->right;
+    } else {
+      if (!rope_path_push(rights, node->right)) return NULL;
+      node = node->left;
+    }
+  }
+  return node;
+}
+
+// concatenates the subtrees of a path onto a rope from the bottom of the path
+// up, onto its left side if left is true and its right side otherwise. The
+// reference to the rope is taken over.
+static RopeNode *rope_fold(RopeNode *rope, RopePath *path, bool left)
+{
+  for (int i = path->length - 1; i >= 0 && rope != NULL; i--) {
+    RopeNode *prev = rope;
+    rope = left ? rope_concat(path->nodes[i], prev) : rope_concat(prev, path->nodes[i]);
+    rope_deref(prev);
+  }
+  return rope;
+}
+
+// cuts a rope before the positions start and end, storing the ropes before,
+// between and after them in out, in a single pass down the paths to the two
+// positions. The subtrees that hang off the paths are shared with the rope.
+static bool rope_slice(RopeNode *root, int start, int end, RopeNode **out)
+{
+  RopePath lefts, middle_lefts, middle_rights, rights;
+  rope_path_init(&lefts);
+  rope_path_init(&middle_lefts);
+  rope_path_init(&middle_rights);
+  rope_path_init(&rights);
+  out[0] = out[1] = out[2] = NULL;
+
+  // descend while both positions are in the same child
+  RopeNode *node = root;
+  while (node->left != NULL && (start > node->weight || end <= node->weight)) {
+    if (start > node->weight) {
+      if (!rope_path_push(&lefts, node->left)) goto cleanup;
+      start -= node->weight;
+      end -= node->weight;
+      node = node->right;
+    } else {
+      if (!rope_path_push(&rights, node->right)) goto cleanup;
+      node = node->left;
+    }
+  }
+
+  // cut a single leaf into three pieces
+  RopeNode *first = node, *last = node;
+  if (node->left == NULL) {
+    out[0] = rope_piece(node, 0, start);
+    out[1] = rope_piece(node, start, end);
+    out[2] = rope_piece(node, end, node->weight);
+  }
+
+  // otherwise the paths fork, so descend to each position separately, where
+  // the subtrees between the two paths belong to the middle rope
   else {
-    RopeIndex idx = {
-      .node = root,
-      .c = root->value[index],
-      .n_idx = index
-    };
-    return idx;
+    end -= node->weight;
+    first = rope_descend(node->left, &start, &lefts, &middle_rights);
+    last = rope_descend(node->right, &end, &middle_lefts, &rights);
+    if (first == NULL || last == NULL) goto cleanup;
+    out[0] = rope_piece(first, 0, start);
+    out[1] = rope_piece(first, start, first->weight);
+    out[2] = rope_piece(last, end, last->weight);
+    RopeNode *middle = rope_fold(rope_piece(last, 0, end), &middle_lefts, true);
+    out[1] = rope_fold(out[1], &middle_rights, false);
+    if (middle == NULL || out[1] == NULL) {
+      rope_deref(middle);
+      goto cleanup;
+    }
+    RopeNode *prev = out[1];
+    out[1] = rope_concat(prev, middle);
+    rope_deref(prev);
+    rope_deref(middle);
+  }
+
+  // concatenate the subtrees on either side back onto the outer ropes
+  out[0] = rope_fold(out[0], &lefts, true);
+  out[2] = rope_fold(out[2], &rights, false);
+  if (out[0] == NULL || out[1] == NULL || out[2] == NULL) goto cleanup;
+  rope_path_free(&lefts);
+  rope_path_free(&middle_lefts);
+  rope_path_free(&middle_rights);
+  rope_path_free(&rights);
+  return true;
+
+  // memory cleanup for allocation failure
+ cleanup:
+  SDL_SetError("Failed to allocate memory while slicing rope");
+  rope_path_free(&lefts);
+  rope_path_free(&middle_lefts);
+  rope_path_free(&middle_rights);
+  rope_path_free(&rights);
+  for (int i = 0; i < 3; i++) rope_deref(out[i]);
+  return false;
+}
+
+// checks that a range lies within a rope
+static bool rope_check_range(RopeNode *root, int start, int len)
+{
+  if (start < 0 || len < 0 || start > root->length - len) {
+    SDL_SetError("Range is outside of the rope");
+    return false;
+  }
+  return true;
+}
+
+bool rope_copy_out(RopeNode *root, int start, int len, uint32_t *dst)
+{
+  if (!rope_check_range(root, start, len)) return false;
+  if (len == 0) return true;
+
+  // copy each chunk until the range runs out
+  RopeIter iter;
+  if (!rope_iter_init(&iter, root, start)) return false;
+  while (true) {
+    int count = iter.len < len ? iter.len : len;
+    memcpy(dst, iter.chunk, count * sizeof(uint32_t));
+    dst += count;
+    len -= count;
+    if (len == 0 || !rope_iter_next(&iter)) return true;
   }
 }
 
+int rope_copy_out_utf8(RopeNode *root, int start, int len, char *dst)
+{
+  if (!rope_check_range(root, start, len)) return -1;
+  if (len == 0) return 0;
+
+#ifdef ROPE_UTF8
+  // copy the text of each leaf straight out, since it is already UTF-8
+  RopeIter iter = {.root = root};
+  rope_iter_seek(&iter, start);
+  char *end = dst;
+  int from = start - iter.leaf_start;
+  while (true) {
+    RopeNode *leaf = iter.leaf;
+    int count = leaf->weight - from < len ? leaf->weight - from : len;
+    int offset = rope_unit_offset(leaf, from);
+    int bytes = rope_unit_offset(leaf, from + count) - offset;
+    memcpy(end, leaf->value + offset, bytes);
+    end += bytes;
+    len -= count;
+    from = 0;
+    if (len == 0 || !rope_iter_step(&iter, true)) return (int)(end - dst);
+  }
+#else
+  // encode each chunk until the range runs out
+  RopeIter iter;
+  if (!rope_iter_init(&iter, root, start)) return -1;
+  char *end = dst;
+  while (true) {
+    int count = iter.len < len ? iter.len : len;
+    end += rope_encode_utf8(iter.chunk, count, end);
+    len -= count;
+    if (len == 0 || !rope_iter_next(&iter)) return (int)(end - dst);
+  }
+#endif
+}
+
 RopeNode **rope_split(RopeNode *root, int index)
 {
-  // all heap-allocated pointers here
-  RopeNode **new_roots = NULL;          // array of the roots of the two ropes after split
-  uint32_t *text_left = NULL;           // text to the left of the split in the leaf
-  uint32_t *text_right = NULL;          // text to the right of the split in the leaf
+  // allocate memory for the roots of the two ropes after split
+  RopeNode **new_roots = malloc(2 * sizeof(RopeNode*));
+  if (new_roots == NULL) {
+    SDL_SetError("Failed to allocate memory during rope_split");
+    return NULL;
+  }
 
   // if index is -1, return whole rope as right tree
   if (index == -1) {
-    // allocate memory for new root pointers
-    new_roots = malloc(2 * sizeof(RopeNode*));
-    if (new_roots == NULL) goto cleanup;
-    
     new_roots[0] = rope_build(NULL, 0);
-    if (new_roots[0] == NULL) goto cleanup;
     new_roots[1] = root;
-    root->ref_count++;
+    rope_ref(root);
     return new_roots;
   }
-  
-  // base case: node is leaf
-  if (root->left == NULL && root->right == NULL) {
-    // allocate memory for new root pointers
-    new_roots = malloc(2 * sizeof(RopeNode*));
-    if (new_roots == NULL) goto cleanup;
-    
-    // if split point is at end of leaf, then return empty right rope
-    if (root->weight - 1 == index) {
-      new_roots[0] = root;
-      root->ref_count++;
-      new_roots[1] = rope_build(NULL, 0);
-      if (new_roots[1] == NULL) goto cleanup;
-      return new_roots;
-    }
-
-    // otherwise calculate weights of new split left and right nodes
-    int left_weight = index + 1;
-    int right_weight =  root->weight - index - 1;
-
-    // allocate memory for new text and copy slices from old value
-    text_left = malloc(left_weight * sizeof(uint32_t));
-    text_right = malloc(right_weight * sizeof(uint32_t));
-    if (text_left == NULL || text_right == NULL) goto cleanup;
-    memcpy(text_left, root->value, left_weight * sizeof(uint32_t));
-    memcpy(text_right, root->value+index+1, right_weight * sizeof(uint32_t));
-
-    // create new left and right nodes from the split text
-    new_roots[0] = malloc(sizeof(RopeNode));
-    new_roots[1] = malloc(sizeof(RopeNode));
-    if (new_roots[0] == NULL || new_roots[1] == NULL) goto cleanup;
-    rope_set(new_roots[0], left_weight, 1, text_left, NULL, NULL);
-    rope_set(new_roots[1], right_weight, 1, text_right, NULL, NULL);
 
-    return new_roots;
+  // otherwise cut the rope after the index, leaving the middle rope empty
+  RopeNode *out[3];
+  if (!rope_slice(root, index + 1, index + 1, out)) {
+    free(new_roots);
+    return NULL;
   }
+  rope_deref(out[1]);
+  new_roots[0] = out[0];
+  new_roots[1] = out[2];
+  return new_roots;
+}
+
+RopeNode *rope_substr(RopeNode *root, int start, int len)
+{
+  RopeNode *out[3];
+  if (!rope_check_range(root, start, len)) return NULL;
+  if (!rope_slice(root, start, start + len, out)) return NULL;
+  rope_deref(out[0]);
+  rope_deref(out[2]);
+  return out[1];
+}
+
+RopeNode *rope_replace(RopeNode *root, int start, int len, RopeNode *rope)
+{
+  // cut out the range
+  RopeNode *out[3];
+  if (!rope_check_range(root, start, len)) return NULL;
+  if (!rope_slice(root, start, start + len, out)) return NULL;
+  rope_deref(out[1]);
 
-  // otherwise split down left or right subtree based on index
-  if (index >= root->weight) {
-    new_roots = rope_split(root->right, index - root->weight);
-    if (new_roots == NULL) goto cleanup;
-    RopeNode* right = new_roots[0];
-    new_roots[0] = rope_concat(root->left, new_roots[0]);
-    rope_deref(right);
-    if (new_roots[0] == NULL) goto cleanup;
-  } else {
-    new_roots = rope_split(root->left, index);
-    if (new_roots == NULL) goto cleanup;
-    RopeNode* left = new_roots[1];
-    new_roots[1] = rope_concat(new_roots[1], root->right);
-    rope_deref(left);
-    if (new_roots[1] == NULL) goto cleanup;
+  // concatenate (before + rope + after)
+  RopeNode *new_rope = rope_concat(out[0], rope);
+  if (new_rope != NULL) {
+    RopeNode *prev = new_rope;
+    new_rope = rope_concat(prev, out[2]);
+    rope_deref(prev);
   }
-  return new_roots;
+  rope_deref(out[0]);
+  rope_deref(out[2]);
+  return new_rope;
+}
 
-  // memory cleanup for allocation failure
- cleanup:
-  SDL_SetError("Failed to allocate memory during rope_split");
-  rope_arr_free(new_roots, 2);
-  free(text_left);
-  free(text_right);
-  return NULL;
+RopeNode *rope_delete_range(RopeNode *root, int start, int len)
+{
+  RopeNode *out[3];
+  if (!rope_check_range(root, start, len)) return NULL;
+  if (!rope_slice(root, start, start + len, out)) return NULL;
+  RopeNode *new_rope = rope_concat(out[0], out[2]);
+  for (int i = 0; i < 3; i++) rope_deref(out[i]);
+  return new_rope;
 }
 
-RopeNode *rope_insert(RopeNode *root, uint32_t c, int idx)
+// An interned leaf may be shared without its reference count showing it, and
+// an edit in place would leave the hashes above it out of date, so nodes are
+// only edited in place when ROPE_INTERN is not defined.
+#ifndef ROPE_INTERN
+
+// returns the leaf holding the given position, where a position at the end of
+// a leaf is in that leaf rather than at the start of the next, and stores the
+// offset into the leaf. Returns NULL if any node along the path is shared.
+static RopeNode *rope_owned_leaf(RopeNode *root, int pos, int *offset)
 {
-  // allocate memory for new node
-  RopeNode *insert_node = malloc(sizeof(RopeNode));
-  if (insert_node == NULL) {
-    SDL_SetError("Failed to allocate memory for node");
-    return NULL;
+  RopeNode *node = root;
+  while (node->ref_count == 1 && node->left != NULL) {
+    if (pos > node->weight) {
+      pos -= node->weight;
+      node = node->right;
+    } else {
+      node = node->left;
+    }
   }
+  if (node->ref_count != 1) return NULL;
+#ifdef ROPE_UTF8
+  if (node->map != NULL) return NULL;
+#endif
+  *offset = pos;
+  return node;
+}
 
-  // allocate memory for text value
-  uint32_t *text = malloc(sizeof(uint32_t));
-  if (text == NULL) {
-    SDL_SetError("Failed to allocate memory for text");
-    free(insert_node);
-    return NULL;
+// opens a gap of delta units at the given offset in the text of a leaf, or
+// removes that many units if delta is negative, moving the text to a new block
+// of the pool only if its current block does not fit the new size. The weight
+// and summary of the leaf are left unchanged.
+static bool rope_resize_leaf(RopeNode *leaf, int offset, int delta)
+{
+  int units = rope_units(leaf);
+  size_t size = (units + delta) * sizeof(ROPE_UNIT);
+  size_t old_size = units * sizeof(ROPE_UNIT);
+  ROPE_UNIT *value = leaf->value;
+  if (pool_size(size) != pool_size(old_size)) {
+    value = pool_alloc(size);
+    if (value == NULL) return false;
+    memcpy(value, leaf->value, offset * sizeof(ROPE_UNIT));
+  }
+
+  // shift the text after the offset
+  int src = delta < 0 ? offset - delta : offset;
+  int dst = delta > 0 ? offset + delta : offset;
+  memmove(value + dst, leaf->value + src, (units - src) * sizeof(ROPE_UNIT));
+  if (value != leaf->value) {
+    pool_free(leaf->value, old_size);
+    leaf->value = value;
   }
-  *text = c;
+  return true;
+}
+
+// adds to the lengths of the nodes along the path to the given position, and
+// to the weights of the nodes whose left subtree contains it. The summary of
+// the inserted or deleted text is added to or subtracted from their summaries,
+// following the sign of the change in length.
+static void rope_resize_path(RopeNode *root, int pos, int delta, RopeSummary change)
+{
+  int sign = delta < 0 ? -1 : 1;
+  RopeNode *node = root;
+  while (node->left != NULL) {
+    node->length += delta;
+    rope_summary_add(&node->summary, change, sign);
+    if (pos > node->weight) {
+      pos -= node->weight;
+      node = node->right;
+    } else {
+      node->weight += delta;
+      node = node->left;
+    }
+  }
+  node->weight += delta;
+  node->length += delta;
+  rope_summary_add(&node->summary, change, sign);
+}
+
+#endif // ROPE_INTERN
+
+RopeNode *rope_insert(RopeNode *root, uint32_t c, int idx)
+{
+#ifndef ROPE_INTERN
+  // insert into the leaf in place if nothing else can see the rope, and the
+  // leaf has room
+  int offset;
+  RopeNode *leaf = rope_owned_leaf(root, idx + 1, &offset);
+  if (leaf != NULL && leaf->weight > 0 && leaf->weight < LEAF_WEIGHT) {
+    int at = rope_unit_offset(leaf, offset);
+    if (rope_resize_leaf(leaf, at, rope_char_units(c))) {
+      rope_put_char(leaf->value + at, c);
+      rope_resize_path(root, idx + 1, 1, rope_summarize(&c, 1));
+      rope_ref(root);
+      return root;
+    }
+  }
+#endif
 
-  // set the new node's properties
-  rope_set(insert_node, 1, 1, text, NULL, NULL);
+  // create a new leaf for the character
+  RopeNode *insert_node = rope_leaf(&c, 1);
+  if (insert_node == NULL) return NULL;
 
   // split the rope at the index
   RopeNode **roots = rope_split(root, idx);
@@ -420,27 +1535,160 @@ RopeNode *rope_insert(RopeNode *root, uint32_t c, int idx)
   return full_concat;
 }
 
+RopeNode *rope_insert_text(RopeNode *root, uint32_t *text, int len, int idx)
+{
+  // single characters can be inserted in place
+  if (len == 1) return rope_insert(root, text[0], idx);
+
+  // build a balanced rope from the text and splice it in after the index
+  RopeNode *insert = rope_build(text, len);
+  if (insert == NULL) return NULL;
+  RopeNode *new_rope = rope_replace(root, idx + 1, 0, insert);
+  rope_deref(insert);
+  return new_rope;
+}
+
 RopeNode *rope_delete(RopeNode *root, int idx)
 {
-  // split at point before and at the index
-  RopeNode **before_splits = rope_split(root, idx - 1);
-  if (before_splits == NULL) return NULL;
-  RopeNode **after_splits = rope_split(root, idx);
-  if (after_splits == NULL) goto cleanup;
+#ifndef ROPE_INTERN
+  // remove from the leaf in place if nothing else can see the rope, and the
+  // leaf stays at least half full, so that deletes still coalesce small leaves
+  int offset;
+  RopeNode *leaf = rope_owned_leaf(root, idx + 1, &offset);
+  if (leaf != NULL && leaf->weight > (leaf == root ? 1 : LEAF_WEIGHT / 2)) {
+    int at = rope_unit_offset(leaf, offset - 1);
+    int units;
+    uint32_t c = rope_get_char(leaf->value + at, &units);
+    RopeSummary change = rope_summarize(&c, 1);
+    if (rope_resize_leaf(leaf, at, -units)) {
+      rope_resize_path(root, idx + 1, -1, change);
+      rope_ref(root);
+      return root;
+    }
+  }
+#endif
 
-  // make new rope without the deleted character
-  RopeNode *new_rope = rope_concat(before_splits[0], after_splits[1]);
-  if (new_rope == NULL) goto cleanup;
+  // otherwise cut the character out of the rope
+  return rope_delete_range(root, idx, 1);
+}
 
-  // free unused rope nodes
-  rope_arr_free(before_splits, 2);
-  rope_arr_free(after_splits, 2);
-  return new_rope;
+void rope_finger_flush(RopeFinger *finger)
+{
+  // add the pending change to the ancestors of the leaf, other than the root,
+  // whose length and summary are kept up to date, by descending to the start
+  // of the leaf using the weights from before the change
+  RopeNode *root = finger->root;
+  RopeSummary change = finger->pending_summary;
+  if (root != NULL && (finger->pending != 0 || change.bytes != 0 || change.newlines != 0 ||
+                       change.utf16 != 0)) {
+    RopeNode *node = root;
+    int pos = finger->start;
+    while (node->left != NULL) {
+      if (node != root) {
+        node->length += finger->pending;
+        rope_summary_add(&node->summary, change, 1);
+      }
+      if (pos >= node->weight) {
+        pos -= node->weight;
+        node = node->right;
+      } else {
+        node->weight += finger->pending;
+        node = node->left;
+      }
+    }
+  }
+  finger->root = NULL;
+  finger->leaf = NULL;
+  finger->start = 0;
+  finger->pending = 0;
+  finger->pending_summary = (RopeSummary){0};
+}
 
-  // cleanup logic if memory allocation fails
- cleanup:
-  rope_arr_free(before_splits, 2);
-  rope_arr_free(after_splits, 2);
-  return NULL;
+#ifndef ROPE_INTERN
+
+// moves a finger to the leaf holding the given position in a rope, flushing
+// it first if it was in a different leaf. Returns false if the leaf is shared.
+static bool rope_finger_seek(RopeFinger *finger, RopeNode *root, int pos, bool end)
+{
+  // stay in the current leaf if it still holds the position
+  if (finger->root == root && root->ref_count == 1 && pos >= finger->start &&
+      pos < finger->start + finger->leaf->weight + end) {
+    return true;
+  }
+
+  // otherwise descend from the root
+  rope_finger_flush(finger);
+  int offset;
+  RopeNode *leaf = rope_owned_leaf(root, end ? pos : pos + 1, &offset);
+  if (leaf == NULL || leaf->weight == 0) return false;
+  finger->root = root;
+  finger->leaf = leaf;
+  finger->start = pos - (end ? offset : offset - 1);
+  return true;
 }
 
+#endif // ROPE_INTERN
+
+RopeNode *rope_finger_insert(RopeFinger *finger, RopeNode *root, uint32_t c, int idx)
+{
+#ifndef ROPE_INTERN
+  // insert into the leaf under the finger in place if it has room
+  if (rope_finger_seek(finger, root, idx + 1, true)) {
+    RopeNode *leaf = finger->leaf;
+    int offset = idx + 1 - finger->start;
+    int at = rope_unit_offset(leaf, offset);
+    if (leaf->weight < LEAF_WEIGHT && rope_resize_leaf(leaf, at, rope_char_units(c))) {
+      RopeSummary change = rope_summarize(&c, 1);
+      rope_put_char(leaf->value + at, c);
+      leaf->weight++;
+      leaf->length++;
+      rope_summary_add(&leaf->summary, change, 1);
+      if (leaf != root) {
+        root->length++;
+        rope_summary_add(&root->summary, change, 1);
+        finger->pending++;
+        rope_summary_add(&finger->pending_summary, change, 1);
+      }
+      rope_ref(root);
+      return root;
+    }
+  }
+#endif
+
+  // otherwise fall back to rebuilding the path
+  rope_finger_flush(finger);
+  return rope_insert(root, c, idx);
+}
+
+RopeNode *rope_finger_delete(RopeFinger *finger, RopeNode *root, int idx)
+{
+#ifndef ROPE_INTERN
+  // remove from the leaf under the finger in place until it has one character
+  // left. Unlike rope_delete(), this allows the leaf to get less than half
+  // full, since a run of deletes at a cursor usually goes on to empty it.
+  if (rope_finger_seek(finger, root, idx, false)) {
+    RopeNode *leaf = finger->leaf;
+    int at = rope_unit_offset(leaf, idx - finger->start);
+    int units;
+    uint32_t c = rope_get_char(leaf->value + at, &units);
+    RopeSummary change = rope_summarize(&c, 1);
+    if (leaf->weight > 1 && rope_resize_leaf(leaf, at, -units)) {
+      leaf->weight--;
+      leaf->length--;
+      rope_summary_add(&leaf->summary, change, -1);
+      if (leaf != root) {
+        root->length--;
+        rope_summary_add(&root->summary, change, -1);
+        finger->pending--;
+        rope_summary_add(&finger->pending_summary, change, -1);
+      }
+      rope_ref(root);
+      return root;
+    }
+  }
+#endif
+
+  // otherwise fall back to rebuilding the path
+  rope_finger_flush(finger);
+  return rope_delete(root, idx);
+}
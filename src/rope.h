@@ -1,36 +1,249 @@
 #ifndef ROPE_H
 #define ROPE_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
-// Determines the size of each leaf upon rebuild of the rope.
-#define LEAF_WEIGHT 4
+// Makes the reference counts of nodes atomic when ROPE_ATOMIC is defined, so
+// that snapshots of a rope can be read on other threads with rope_acquire().
+#ifdef ROPE_ATOMIC
+#include <stdatomic.h>
+#define ROPE_REF_COUNT _Atomic int
+#else
+#define ROPE_REF_COUNT int
+#endif
+
+// Stores the text of leaves as UTF-8 rather than as codepoints when ROPE_UTF8
+// is defined, so that mostly ASCII text takes up a quarter of the memory. Ropes
+// are still indexed by codepoint, and their text is still read and written as
+// codepoints, which must not be above U+10FFFF. Surrogates are stored as
+// U+FFFD.
+#ifdef ROPE_UTF8
+#ifdef ROPE_BTREE
+#error "ROPE_UTF8 is only supported by the binary rope layout"
+#endif
+#define ROPE_UNIT uint8_t
+#else
+#define ROPE_UNIT uint32_t
+#endif
+
+// Keeps a hash of the text of every node when ROPE_INTERN is defined, so that
+// ropes are compared in O(1) time with rope_equal(), and interns the leaves
+// built by rope_build() with rope_intern(), so that leaves with the same text
+// share one node. Nodes are then never edited in place, since an interned leaf
+// may be shared by ropes that do not know about each other.
+#ifdef ROPE_INTERN
+#ifdef ROPE_BTREE
+#error "ROPE_INTERN is only supported by the binary rope layout"
+#endif
+#endif
+
+/**
+ * struct RopeSummary - Stores the metrics of a span of text.
+ *
+ * @bytes: The number of bytes the text takes up when encoded as UTF-8.
+ * @newlines: The number of newlines within the text.
+ * @utf16: The number of code units the text takes up when encoded as UTF-16.
+ *
+ * This struct holds the metrics that are kept for every node of a rope, other
+ * than the number of codepoints, which is the length of the node. The summary
+ * of a node is the sum of the summaries of its children, so it is kept up to
+ * date by every edit, split and concatenation without ever rescanning text.
+ * This lets a position be converted between codepoints, UTF-8 bytes, lines and
+ * UTF-16 code units by descending a single path with rope_seek() and
+ * rope_measure().
+ */
+typedef struct RopeSummary {
+  int bytes;
+  int newlines;
+  int utf16;
+} RopeSummary;
+
+/**
+ * enum RopeMetric - Selects a metric of the text in a rope.
+ *
+ * @ROPE_CODEPOINTS: The number of unicode codepoints.
+ * @ROPE_BYTES: The number of bytes when encoded as UTF-8.
+ * @ROPE_NEWLINES: The number of newlines.
+ * @ROPE_UTF16: The number of code units when encoded as UTF-16.
+ */
+typedef enum RopeMetric {
+  ROPE_CODEPOINTS,
+  ROPE_BYTES,
+  ROPE_NEWLINES,
+  ROPE_UTF16,
+} RopeMetric;
+
+/**
+ * enum RopeKernels - Selects the instruction sets used to scan text.
+ *
+ * @ROPE_KERNELS_SCALAR: Plain C, one character at a time.
+ * @ROPE_KERNELS_SSE2: SSE2 vectors of 16 bytes.
+ * @ROPE_KERNELS_AVX2: AVX2 vectors of 32 bytes.
+ */
+typedef enum RopeKernels {
+  ROPE_KERNELS_SCALAR,
+  ROPE_KERNELS_SSE2,
+  ROPE_KERNELS_AVX2,
+} RopeKernels;
+
+#ifdef ROPE_BTREE
+
+// Determines the maximum and minimum number of children of an internal node.
+#define ROPE_BRANCH 16
+#define ROPE_MIN_BRANCH (ROPE_BRANCH / 2)
+
+// Determines the maximum and minimum number of codepoints stored in a leaf. The
+// text of a leaf is stored inline in the space used for children by an
+// internal node, so a leaf size above 48 makes every node larger.
+#ifndef LEAF_WEIGHT
+#define LEAF_WEIGHT 48
+#endif
+#define ROPE_MIN_LEAF (LEAF_WEIGHT / 2)
+
+/**
+ * struct RopeNode - Defines a node within a B-tree rope.
+ *
+ * @weight: The total length of all the text within the node.
+ * @height: The height of the subtree rooted at this node, where a leaf has a
+ * height of 1.
+ * @ref_count: The number of references to this node.
+ * @count: The number of children of the node, or the number of codepoints if
+ * the node is a leaf.
+ * @summary: The metrics of the text within the node.
+ * @retired: The next dead node waiting for rope_reclaim(), if ROPE_ATOMIC is
+ * defined.
+ * @lengths: The total length of the text within each child.
+ * @children: The children of the node.
+ * @value: An array of unicode codepoints representing text, if the node is a
+ * leaf.
+ *
+ * This struct represents a node within a rope B-tree that represents a
+ * document of text, used in place of the binary rope when ROPE_BTREE is
+ * defined. Each internal node has up to ROPE_BRANCH children, and the lengths
+ * of the children are stored inline so that indexing only loads the nodes
+ * along a single path. All leaves are at the same depth, and hold up to
+ * LEAF_WEIGHT codepoints inline rather than in a separate allocation. Each
+ * node also keeps a summary of its text, so that a line or a UTF-8 offset is
+ * found by descending a single path while reading the summaries of the
+ * children on the way. Like
+ * the binary rope, the nodes are immutable once shared and are reference
+ * counted. The B-tree layout implements all of the rope API except for
+ * rope_set(), rope_merge() and rope_collect(), which depend on the binary
+ * layout.
+ */
+typedef struct RopeNode {
+  int weight;
+  int height;
+  ROPE_REF_COUNT ref_count;
+  int count;
+  RopeSummary summary;
+#ifdef ROPE_ATOMIC
+  struct RopeNode *retired;
+#endif
+  union {
+    struct {
+      int lengths[ROPE_BRANCH];
+      struct RopeNode *children[ROPE_BRANCH];
+    };
+    uint32_t value[LEAF_WEIGHT];
+  };
+} RopeNode;
+
+#else
+
+// Determines the size of each leaf upon rebuild of the rope, as well as the
+// size up to which rope_concat() coalesces the leaves on either side of the
+// seam into a single leaf.
+#ifndef LEAF_WEIGHT
+#define LEAF_WEIGHT 512
+#endif
+
+// Determines how much the heights of two sibling subtrees may differ before
+// rope_concat() rotates them back into balance.
+#define ROPE_BALANCE 2
+
+#ifdef ROPE_UTF8
+
+/**
+ * struct RopeMap - Holds a read-only mapping of a file that leaves point into.
+ *
+ * @data: The contents of the file.
+ * @size: The size of the file in bytes.
+ * @ref_count: The number of leaves whose text points into the mapping, plus
+ * one while rope_map() is still building the rope.
+ *
+ * This struct is created by rope_map(), so that the text of a file is read
+ * straight from the mapping rather than being copied into every leaf. The file
+ * is unmapped once the last leaf pointing into it is freed.
+ */
+typedef struct RopeMap {
+  const char *data;
+  size_t size;
+  int ref_count;
+} RopeMap;
+
+#endif // ROPE_UTF8
 
 /**
  * struct RopeNode - Defines a node within a rope.
  *
  * @weight: The weight of the rope node.
+ * @length: The total length of all the text within the subtree.
+ * @height: The height of the subtree rooted at this node, where a leaf has a
+ * height of 1.
+ * @summary: The metrics of all the text within the subtree.
  * @ref_count: The number of references to this node.
- * @value: An array of unicode codepoints representing text, if the node is a
- * leaf
+ * @value: An array of unicode codepoints representing text, or of UTF-8 bytes
+ * if ROPE_UTF8 is defined, if the node is a leaf
  * @left: The left child of the node.
  * @right: The right child of the node.
+ * @retired: The next dead node waiting for rope_reclaim(), if ROPE_ATOMIC is
+ * defined.
+ * @map: The mapping of a file that the text of the leaf points into, or NULL
+ * if the leaf owns its text, if ROPE_UTF8 is defined.
+ * @hash: The polynomial hash of the units of text within the subtree, if
+ * ROPE_INTERN is defined.
+ * @scale: The base of the hash raised to the number of units of text within
+ * the subtree, which the hash of the text before it is multiplied by when the
+ * two are joined, if ROPE_INTERN is defined.
  *
  * This struct represents a node within a rope binary tree that represents
- * a line of text. The weight is calculated as the total length of all the text
- * within the left subtree of the node. If the node is a leaf, that means it
- * contains a value, which is that leaf's segment of text represented as an
- * array of unicode codepoints. The node is reference counted and will be freed
- * once the number of references to it reaches zero.
+ * a document of text. The weight is calculated as the total length of all the
+ * text within the left subtree of the node. If the node is a leaf, that means
+ * it contains a value, which is that leaf's segment of text represented as an
+ * array of unicode codepoints, or as UTF-8 when ROPE_UTF8 is defined, in which
+ * case the weight and length still count codepoints, and the size of the text
+ * of a leaf is the byte count in its summary. The node is reference counted
+ * and will be freed once the number of references to it reaches zero. The
+ * total length, summary and height are kept so that the length and lines of
+ * a rope can be found, and the tree kept balanced, without walking it. A leaf
+ * whose text points into a file mapped by rope_map() is never edited in place.
  */
 typedef struct RopeNode {
   int weight;
-  int ref_count;
-  uint32_t *value;
+  int length;
+  int height;
+  RopeSummary summary;
+  ROPE_REF_COUNT ref_count;
+  ROPE_UNIT *value;
   struct RopeNode *left;
   struct RopeNode *right;
+#ifdef ROPE_ATOMIC
+  struct RopeNode *retired;
+#endif
+#ifdef ROPE_UTF8
+  RopeMap *map;
+#endif
+#ifdef ROPE_INTERN
+  uint64_t hash;
+  uint64_t scale;
+#endif
 } RopeNode;
 
+#endif // ROPE_BTREE
+
 /**
  * struct RopeIndex - Contains information about a character within a rope.
  *
@@ -48,6 +261,107 @@ typedef struct RopeIndex {
   int n_idx;
 } RopeIndex;
 
+// Determines how many nodes of the path to the current leaf a RopeIter keeps.
+#define ROPE_ITER_DEPTH 64
+
+/**
+ * struct RopeIter - Iterates over the text of a rope one chunk at a time.
+ *
+ * @root: The root node of the rope.
+ * @chunk: The codepoints of the current chunk, which point into a leaf, or
+ * into the decoded text if ROPE_UTF8 is defined.
+ * @len: The number of codepoints in the current chunk.
+ * @start: The index of the first character of the chunk within the rope.
+ * @leaf: The leaf node holding the current chunk.
+ * @leaf_start: The index of the first character of the leaf within the rope.
+ * @depth: The number of nodes in the path to the leaf, or -1 if the path is
+ * longer than ROPE_ITER_DEPTH.
+ * @path: The nodes along the path from the root to the leaf, not including
+ * the leaf itself.
+ * @steps: The child taken at each node of the path, which is 0 for left and 1
+ * for right in the binary layout, and the index of the child in the B-tree
+ * layout.
+ * @decoded: The codepoints of the current leaf, if ROPE_UTF8 is defined.
+ * @bytes: The UTF-8 text of the current chunk, if ROPE_UTF8 is defined.
+ * @size: The number of bytes in the current chunk, if ROPE_UTF8 is defined.
+ * @decode: Whether leaves are decoded as the iterator reaches them, if
+ * ROPE_UTF8 is defined, which rope_iter_init() sets.
+ *
+ * This struct is meant to be declared on the stack and filled in with
+ * rope_iter_init(), after which the chunks of text hold the text of the rope
+ * in order, with each chunk lying within a single leaf. The iterator keeps the
+ * path to the current leaf so that stepping to the next or previous leaf does
+ * not descend from the root, unless the rope is too deep for the path to fit,
+ * in which case the leaf is found by its index instead. Leaves stored as UTF-8
+ * are decoded into the iterator as it reaches them, unless decode is cleared
+ * after rope_iter_init(), in which case only the UTF-8 of each chunk may be
+ * read instead of its codepoints. No memory is allocated and no reference
+ * counts are changed, so the rope must not be freed or edited in place while
+ * it is being iterated over.
+ */
+typedef struct RopeIter {
+  struct RopeNode *root;
+  const uint32_t *chunk;
+  int len;
+  int start;
+  struct RopeNode *leaf;
+  int leaf_start;
+  int depth;
+  struct RopeNode *path[ROPE_ITER_DEPTH];
+  int steps[ROPE_ITER_DEPTH];
+#ifdef ROPE_UTF8
+  uint32_t decoded[LEAF_WEIGHT];
+  const char *bytes;
+  int size;
+  bool decode;
+#endif
+} RopeIter;
+
+/**
+ * struct RopeFinger - Remembers the leaf of the last edit made to a rope.
+ *
+ * @root: The root node of the rope, or NULL if the finger is not in a rope.
+ * @leaf: The leaf node that the last edit was made in.
+ * @start: The index of the first character of the leaf within the rope.
+ * @pending: The change in the length of the leaf that has not yet been added
+ * to the nodes above it.
+ * @pending_summary: The change in the summary of the leaf that has not yet
+ * been added to the nodes above it.
+ *
+ * This struct is meant to be kept alongside a rope that is being edited at a
+ * cursor, so that edits at or next to the previous edit go straight to the
+ * leaf instead of descending from the root. The finger does not hold a
+ * reference to the rope. A zero-initialized finger is not in any rope.
+ */
+typedef struct RopeFinger {
+  struct RopeNode *root;
+  struct RopeNode *leaf;
+  int start;
+  int pending;
+  RopeSummary pending_summary;
+} RopeFinger;
+
+/**
+ * struct RopeChange - Describes a range of text that differs between ropes.
+ *
+ * @old_start: The index of the first character of the range in the old rope.
+ * @old_len: The number of characters of the range in the old rope.
+ * @new_start: The index of the first character of the range in the new rope.
+ * @new_len: The number of characters that replace it in the new rope.
+ *
+ * This struct is returned by rope_diff() for each range of the old rope that
+ * was replaced by a range of the new rope. An insertion has an old length of
+ * zero and a deletion has a new length of zero.
+ */
+typedef struct RopeChange {
+  int old_start;
+  int old_len;
+  int new_start;
+  int new_len;
+} RopeChange;
+
+#ifndef ROPE_BTREE
+
 /**
  * rope_set() - Helper function to set properties of a rope node.
  *
@@ -60,9 +374,11 @@ typedef struct RopeIndex {
  *
  * This is a helper function to batch set multiple properties of a node at once.
  * If the left or the right child nodes that are passed in are not NULL, this will
- * also increment their respective reference counts by 1.
+ * also increment their respective reference counts by 1. The total length,
+ * summary and height of the node are calculated from its children, or from
+ * its weight and value if it is a leaf.
  */
-void rope_set(RopeNode *node, int w, int refc, uint32_t *val, RopeNode *l, RopeNode *r);
+void rope_set(RopeNode *node, int w, int refc, ROPE_UNIT *val, RopeNode *l, RopeNode *r);
 
 /**
  * rope_merge() - Merges a list of nodes into a binary tree.
@@ -70,13 +386,52 @@ void rope_set(RopeNode *node, int w, int refc, uint32_t *val, RopeNode *l, RopeN
  * @nodes: A heap-allocated array of rope nodes.
  * @length: Number of nodes in the array.
  *
- * This function takes in an array of rope nodes and recursively merges
- * them until a rope binary tree is formed. It then returns the root of the
- * rope, and will free the passed in node array itself. This function returns
- * NULL if it fails. For error information, use SDL_GetError().
+ * This function takes in an array of rope nodes and merges them bottom up,
+ * one level at a time within the array itself, until a rope binary tree is
+ * formed. Nodes are merged pairwise, and if a level has an odd number of
+ * nodes, the last three are merged together so that the heights of any two
+ * siblings never differ by more than one. All of the parent nodes are
+ * allocated up front with pool_alloc_many(). The nodes passed in should all
+ * have the same height, except for the last node, which may be one taller.
+ * It then returns the root of the rope, and will free the passed in node
+ * array itself. This function returns NULL if it fails. For error
+ * information, use SDL_GetError().
  */
 RopeNode *rope_merge(RopeNode **nodes, int length);
 
+#ifdef ROPE_INTERN
+
+/**
+ * rope_rehash() - Recomputes the hash of the text of a leaf.
+ *
+ * @leaf: The leaf to hash.
+ *
+ * This function sets the hash of a leaf from its text. rope_set() already
+ * does this for a leaf given its text, so it only needs to be called after
+ * the text of a leaf is set some other way.
+ */
+void rope_rehash(RopeNode *leaf);
+
+/**
+ * rope_intern() - Shares a leaf with every other leaf holding the same text.
+ *
+ * @leaf: The leaf to intern, whose reference is taken over.
+ *
+ * This function looks the leaf up by the hash of its text in a table of
+ * interned leaves. If an interned leaf holds the same text, the given leaf is
+ * dereferenced and the interned one is returned with an added reference.
+ * Otherwise, the leaf is added to the table and returned, unless another leaf
+ * with the same hash is already in it. A leaf is taken out of the table when
+ * it is freed, so the table does not hold references. If ROPE_ATOMIC is
+ * defined, a leaf that is waiting for rope_reclaim() is replaced in the table
+ * by the given leaf instead of being shared.
+ */
+RopeNode *rope_intern(RopeNode *leaf);
+
+#endif // ROPE_INTERN
+
+#endif // ROPE_BTREE
+
 /**
  * rope_build() - Builds a rope given an array of text.
  *
@@ -84,14 +439,75 @@ RopeNode *rope_merge(RopeNode **nodes, int length);
  * @length: The length of the array.
  *
  * This function takes in an array of unicode codepoints and creates a
- * rope, returning a pointer to the root node of that rope. It first creates
- * an array of leaves representing the text, and then recursively calls
- * rope_merge() to build the rope. The rope must be freed using rope_free()
- * when it is no longer used. This function returns NULL if it fails.
- * For error information, use SDL_GetError().
+ * rope, returning a pointer to the root node of that rope. It is the same as
+ * calling rope_build_threads() with one thread for each logical CPU core, so
+ * text shorter than ROPE_BUILD_MIN_TEXT is built on the calling thread. The
+ * rope must be freed using rope_deref() when it is no longer used. Every
+ * empty rope is the same shared node, which is never freed, so building an
+ * empty rope does not allocate. This function returns NULL if it fails. For
+ * error information, use SDL_GetError().
  */
 RopeNode *rope_build(uint32_t *text, int length);
 
+// Determines the fewest codepoints that rope_build_threads() gives to each
+// thread, so that small ropes are built without starting any threads.
+#define ROPE_BUILD_MIN_TEXT (1 << 20)
+
+// Determines the most threads that rope_build_threads() uses.
+#define ROPE_BUILD_MAX_THREADS 64
+
+/**
+ * rope_build_threads() - Builds a rope from an array of text on many threads.
+ *
+ * @text: The array of unicode codepoints representing text.
+ * @length: The length of the array.
+ * @threads: The most threads to use, or 0 for one per logical CPU core.
+ *
+ * This function builds the same rope as rope_build(), splitting the text
+ * between up to the given number of threads, including the calling thread.
+ * Every node and leaf of the rope is first allocated from the pool on the
+ * calling thread in one batch with pool_alloc_many(), so the pool is never
+ * used by the other threads. Each thread then copies its share of the text
+ * into the leaves and joins them into subtrees bottom up, and the calling
+ * thread joins the subtrees into the root. The tree has the same shape no
+ * matter how many threads build it. If a thread cannot be started, its share
+ * is built on the calling thread instead. If ROPE_INTERN is defined, this is
+ * rope_build(), which builds the leaves one at a time on the calling thread
+ * and interns each with rope_intern(). This function returns NULL if it
+ * fails. For error information, use SDL_GetError().
+ */
+#ifdef ROPE_INTERN
+#define rope_build_threads(text, length, threads) rope_build(text, length)
+#else
+RopeNode *rope_build_threads(uint32_t *text, int length, int threads);
+#endif
+
+// Determines how many bytes of a file rope_map() decodes at a time when leaves
+// are stored as codepoints.
+#define ROPE_MAP_CHUNK (16 * 1024 * 1024)
+
+/**
+ * rope_map() - Builds a rope holding the text of a UTF-8 file.
+ *
+ * @path: The path of the file.
+ *
+ * This function maps the file into memory read-only and builds a rope of its
+ * text. If ROPE_UTF8 is defined, each leaf points into the mapping rather than
+ * holding a copy of its text, so opening a file copies none of it, and only
+ * the leaves created by edits own their text. The file is still read once to
+ * count the characters and lines of each leaf, after which its pages are
+ * dropped from memory until they are read again. Bytes that are not valid
+ * UTF-8 are replaced with U+FFFD, in leaves that own their text. Otherwise,
+ * the file is decoded ROPE_MAP_CHUNK bytes at a time straight from the mapping
+ * and built with rope_build(), and the mapping is dropped before returning.
+ * The file must not be changed while the rope is in use. This function
+ * returns NULL if it fails, or if the file is too large to be held in a rope.
+ * For error information, use SDL_GetError().
+ */
+RopeNode *rope_map(const char *path);
+
+#ifndef ROPE_BTREE
+
 /**
  * rope_collect() - Collects all of the leaves of a rope.
  *
@@ -104,6 +520,8 @@ RopeNode *rope_build(uint32_t *text, int length);
  */
 RopeNode **rope_collect(RopeNode *root);
 
+#endif // ROPE_BTREE
+
 /**
  * rope_text() - Collects all of the text of a rope.
  *
@@ -111,21 +529,212 @@ RopeNode **rope_collect(RopeNode *root);
  *
  * This function takes in a pointer to the root of a rope and returns
  * a dynamic array of unicode codepoints representing all of the text stored
- * in the leaves of the rope in order.
+ * in the leaves of the rope in order. The array is allocated once at the
+ * length of the rope, and the text of each leaf is copied in with a RopeIter.
  */
 uint32_t *rope_text(RopeNode *root);
 
+/**
+ * rope_iter_init() - Starts iterating over a rope at the given index.
+ *
+ * @iter: The iterator to initialize.
+ * @root: The root node of the rope.
+ * @index: The index of the character to start at, which may be the length of
+ * the rope to start at the end.
+ *
+ * This function descends to the leaf holding the character at the index, and
+ * sets the current chunk to the text of that leaf from the index onwards. If
+ * the index is the length of the rope, the current chunk is empty, and
+ * rope_iter_prev() can be used to iterate backwards from the end. This
+ * function returns false if the index is not within the rope. For error
+ * information, use SDL_GetError().
+ */
+bool rope_iter_init(RopeIter *iter, RopeNode *root, int index);
+
+/**
+ * rope_iter_next() - Steps an iterator to the next chunk of text.
+ *
+ * @iter: The iterator to step.
+ *
+ * This function sets the current chunk to the text that follows it, which is
+ * either the rest of the current leaf or the whole of the next leaf. It
+ * returns false, leaving the iterator unchanged, if the current chunk is at
+ * the end of the rope.
+ */
+bool rope_iter_next(RopeIter *iter);
+
+/**
+ * rope_iter_prev() - Steps an iterator to the previous chunk of text.
+ *
+ * @iter: The iterator to step.
+ *
+ * This function sets the current chunk to the text that comes before it,
+ * which is either the start of the current leaf or the whole of the previous
+ * leaf. It returns false, leaving the iterator unchanged, if the current chunk
+ * is at the start of the rope.
+ */
+bool rope_iter_prev(RopeIter *iter);
+
+/**
+ * rope_copy_out() - Copies a range of the text of a rope into a buffer.
+ *
+ * @root: The root node of the rope.
+ * @start: The index of the first character of the range.
+ * @len: The number of characters in the range.
+ * @dst: The buffer to copy into, which must hold at least len codepoints.
+ *
+ * This function descends the rope once to the start of the range with a
+ * RopeIter, and then copies the text of each leaf in the range into the
+ * buffer with memcpy, without allocating any memory. This function returns
+ * false if the range is not within the rope. For error information, use
+ * SDL_GetError().
+ */
+bool rope_copy_out(RopeNode *root, int start, int len, uint32_t *dst);
+
+/**
+ * rope_copy_out_utf8() - Copies a range of the text of a rope as UTF-8.
+ *
+ * @root: The root node of the rope.
+ * @start: The index of the first character of the range.
+ * @len: The number of characters in the range.
+ * @dst: The buffer to copy into, which must hold at least 4 * len bytes.
+ *
+ * This function copies a range of text in the same way as rope_copy_out(),
+ * encoding each codepoint as UTF-8 as it is copied. Codepoints that cannot be
+ * encoded are replaced with U+FFFD. The text is not null terminated. This
+ * function returns the number of bytes written, or -1 if the range is not
+ * within the rope. For error information, use SDL_GetError().
+ */
+int rope_copy_out_utf8(RopeNode *root, int start, int len, char *dst);
+
+/**
+ * rope_ref() - Increments the reference count of a node.
+ *
+ * @node: The rope node to reference.
+ *
+ * This function adds a reference to a node that the caller can already reach
+ * through a reference it holds, such as the root of a rope it owns or any node
+ * below it. If ROPE_ATOMIC is defined, the increment is atomic but relaxed,
+ * since a node that is already referenced cannot be freed in the meantime. To
+ * take a reference to a rope published by another thread, use rope_acquire().
+ */
+static inline void rope_ref(RopeNode *node)
+{
+#ifdef ROPE_ATOMIC
+  atomic_fetch_add_explicit(&node->ref_count, 1, memory_order_relaxed);
+#else
+  node->ref_count++;
+#endif
+}
+
+// Determines how many dead nodes rope_deref() frees before returning.
+#define ROPE_FREE_BATCH 64
+
 /**
  * rope_deref() - Decrements the reference count of a node.
  *
  * @node: The rope node to dereference.
  *
  * This function decrements the reference count of a node by 1. If the
- * reference count of the node reaches zero, then it will free that node and
- * attempt to dereference its children. If NULL is passed, nothing will happen.
+ * reference count of the node reaches zero, then the node is pushed onto a
+ * stack of dead nodes. Freeing a dead node returns it and its text to the
+ * pool and dereferences its children, pushing any that die in turn, so freeing
+ * a rope of any depth uses constant stack space. Only the first
+ * ROPE_FREE_BATCH dead nodes are freed before this function returns, which is
+ * enough to free the nodes replaced by an edit, and the rest are left for
+ * later calls and rope_reclaim(). This keeps dropping a large rope from
+ * stalling a frame. If ROPE_ATOMIC is defined, the decrement is atomic, and a
+ * node whose count reaches zero is only pushed onto a list of retired nodes,
+ * which is safe to do from any thread. The node and its children are then
+ * freed by rope_reclaim(). If NULL is passed, nothing will happen.
  */
 void rope_deref(RopeNode *node);
 
+/**
+ * struct RopeShared - Publishes the latest version of a rope to other threads.
+ *
+ * @root: The root of the published rope, which holds a reference of its own,
+ * or NULL if nothing has been published yet.
+ *
+ * This struct lets one editing thread hand snapshots of a rope to any number
+ * of reading threads when ROPE_ATOMIC is defined. The editing thread keeps
+ * editing its own ropes, publishing a new version with rope_publish() whenever
+ * it wants readers to see it, and readers take a reference to the latest
+ * version with rope_acquire(). A rope that is published or held by a reader
+ * is shared, so the editing thread never edits it in place.
+ */
+typedef struct RopeShared {
+#ifdef ROPE_ATOMIC
+  _Atomic(RopeNode*) root;
+#else
+  RopeNode *root;
+#endif
+} RopeShared;
+
+// Determines the most threads that may call rope_acquire().
+#define ROPE_MAX_READERS 64
+
+/**
+ * rope_publish() - Publishes a new version of a rope.
+ *
+ * @shared: The RopeShared struct to publish through.
+ * @root: The root node of the rope to publish, or NULL to unpublish.
+ *
+ * This function adds a reference to the rope for the RopeShared struct, and
+ * replaces the previously published rope, dereferencing it. It must only be
+ * called by the thread that edits the rope.
+ */
+void rope_publish(RopeShared *shared, RopeNode *root);
+
+/**
+ * rope_acquire() - Takes a reference to the published version of a rope.
+ *
+ * @shared: The RopeShared struct to read from.
+ *
+ * This function returns the rope most recently published through the
+ * RopeShared struct, with a reference added that the caller must release with
+ * rope_deref() once it is done reading. It may be called from any thread while
+ * the editing thread keeps editing and publishing. While the reference is
+ * being taken, the root is protected by a hazard pointer owned by the calling
+ * thread, so it cannot be freed by rope_reclaim() even if it is replaced and
+ * dereferenced at the same moment. Reading threads may only use functions
+ * that do not allocate nodes, such as rope_index(), rope_length(),
+ * rope_text(), rope_copy_out() and a RopeIter. This function returns NULL if
+ * nothing is published, or if more than ROPE_MAX_READERS threads have called
+ * it. For error information, use SDL_GetError().
+ */
+RopeNode *rope_acquire(RopeShared *shared);
+
+/**
+ * rope_reclaim() - Frees the dead nodes left by rope_deref().
+ *
+ * @budget: The most time to spend in nanoseconds, or 0 to free every node.
+ *
+ * This function frees the nodes left by rope_deref() on any thread, and
+ * dereferences their children, freeing any that die in turn, until none are
+ * left or the budget runs out. Nodes that another thread is taking a
+ * reference to in rope_acquire() are kept for a later call. The pool is not
+ * thread-safe, so this function must be called regularly by the thread that
+ * edits the rope, such as once per frame with a budget that fits in the
+ * frame. This function returns true if every dead node has been freed.
+ */
+bool rope_reclaim(uint64_t budget);
+
+/**
+ * rope_unique_bytes() - Measures the memory that only a rope holds.
+ *
+ * @root: The root node of the rope.
+ *
+ * This function returns the number of bytes of nodes and leaf text that
+ * dereferencing the root for the last time would free, by descending from the
+ * root through the nodes with a single reference. Nodes shared with other
+ * ropes are not descended into, so the time taken is proportional to the
+ * nodes counted. The text of leaves that point into a mapped file is not
+ * counted. Nodes that were dereferenced but not yet freed by rope_reclaim()
+ * still count as references to their children.
+ */
+long rope_unique_bytes(RopeNode *root);
+
 /**
  * rope_arr_free() - Frees an array of RopeNode pointers.
  *
@@ -143,21 +752,262 @@ void rope_arr_free(RopeNode **arr, int length);
  *
  * @root: The root node of the rope.
  *
- * This function returns the total length of all the text in the rope
- * by recursively adding the weights of the nodes down the right spine
- * of the rope.
+ * This function returns the total length of all the text in the rope,
+ * which is stored in the root node.
  */
 int rope_length(RopeNode *root);
 
+/**
+ * rope_summarize() - Computes the summary of an array of text.
+ *
+ * @text: The array of unicode codepoints.
+ * @length: The length of the array.
+ *
+ * This function returns the metrics of the text, in the same form as they are
+ * kept for the nodes of a rope. It takes O(n) time.
+ */
+RopeSummary rope_summarize(const uint32_t *text, int length);
+
+/**
+ * rope_summarize_utf8() - Computes the summary of some UTF-8 text.
+ *
+ * @text: The UTF-8 text, which must be valid.
+ * @bytes: The number of bytes of text.
+ * @length: Where to store the number of codepoints in the text, if not NULL.
+ *
+ * This function returns the metrics of the text in the same way as
+ * rope_summarize(), but counts them from the UTF-8 bytes without decoding
+ * them. It takes O(n) time.
+ */
+RopeSummary rope_summarize_utf8(const char *text, int bytes, int *length);
+
+/**
+ * rope_encode_utf8() - Encodes an array of text as UTF-8.
+ *
+ * @text: The array of unicode codepoints.
+ * @length: The length of the array.
+ * @dst: The buffer to write into, which must hold at least 4 * length bytes.
+ *
+ * This function encodes each codepoint as UTF-8, replacing surrogates and
+ * codepoints above U+10FFFF with U+FFFD. The text is not null terminated. This
+ * function returns the number of bytes written.
+ */
+int rope_encode_utf8(const uint32_t *text, int length, char *dst);
+
+/**
+ * rope_decode_utf8() - Decodes UTF-8 text into an array of codepoints.
+ *
+ * @text: The UTF-8 text.
+ * @bytes: The number of bytes of text.
+ * @dst: The array to write into.
+ * @capacity: The number of codepoints the array holds, which at least bytes
+ * codepoints always fit in.
+ *
+ * This function decodes the text into unicode codepoints, replacing each
+ * byte that does not start a valid sequence with U+FFFD. Overlong sequences,
+ * surrogates and codepoints above U+10FFFF are not valid. Decoding stops once
+ * the array is full. This function returns the number of codepoints written.
+ */
+int rope_decode_utf8(const char *text, int bytes, uint32_t *dst, int capacity);
+
+/**
+ * rope_kernels() - Limits the instruction sets used to scan text.
+ *
+ * @limit: The widest instruction set that may be used.
+ *
+ * The functions that scan text, namely rope_summarize(),
+ * rope_summarize_utf8(), rope_encode_utf8() and rope_decode_utf8(), along with
+ * building, copying and iterating over ropes, use SSE2 or AVX2 when the CPU
+ * has them, which is checked at runtime, and plain C otherwise. This function
+ * sets the widest instruction set they may use, which is meant for
+ * benchmarks to compare them, and returns the widest one that they will
+ * actually use on this CPU. It must not be called while other threads are
+ * scanning text.
+ */
+RopeKernels rope_kernels(RopeKernels limit);
+
+/**
+ * rope_find() - Finds the first occurrence of some text in a rope.
+ *
+ * @root: The root node of the rope.
+ * @needle: The array of unicode codepoints to search for.
+ * @len: The length of the array, which must be at least 1.
+ * @from: The index at or after which the occurrence must start.
+ *
+ * This function searches the text of the rope one chunk at a time with a
+ * rope iterator, so the text is never copied out of the rope. The end of the
+ * text searched so far, one unit shorter than the needle, is kept between
+ * chunks, so that occurrences spanning leaves are found. Leaves stored as
+ * UTF-8 are searched for the needle encoded as UTF-8, without decoding them.
+ * Within a chunk, the search uses SSE2 or AVX2 to compare the first and last
+ * units of the needle at several positions at once when the CPU has them, and
+ * the Horspool algorithm otherwise. This function returns the index of the
+ * occurrence, or -1 if there is none. If the index is not within the rope, the
+ * needle is empty, or memory runs out, it returns -2. For error information,
+ * use SDL_GetError().
+ */
+int rope_find(RopeNode *root, const uint32_t *needle, int len, int from);
+
+/**
+ * rope_rfind() - Finds the last occurrence of some text in a rope.
+ *
+ * @root: The root node of the rope.
+ * @needle: The array of unicode codepoints to search for.
+ * @len: The length of the array, which must be at least 1.
+ * @from: The index at or before which the occurrence must start.
+ *
+ * This function searches the text of the rope backwards from the index, in the
+ * same way as rope_find() does forwards. It returns the index of the
+ * occurrence, or -1 if there is none. If the index is not within the rope, the
+ * needle is empty, or memory runs out, it returns -2. For error information,
+ * use SDL_GetError().
+ */
+int rope_rfind(RopeNode *root, const uint32_t *needle, int len, int from);
+
+/**
+ * rope_find_all() - Finds every occurrence of some text in a rope.
+ *
+ * @root: The root node of the rope.
+ * @needle: The array of unicode codepoints to search for.
+ * @len: The length of the array, which must be at least 1.
+ * @matches: The dynamic array to append the index of each occurrence to.
+ *
+ * This function searches the whole text of the rope in a single pass, in the
+ * same way as rope_find(), and appends the indices of the occurrences in
+ * order. Occurrences that overlap the one before them are skipped, so that
+ * all of the occurrences can be replaced. The array must be freed with
+ * arrfree(). This function returns the number of occurrences found, or -1 if
+ * the needle is empty or memory runs out. For error information, use
+ * SDL_GetError().
+ */
+int rope_find_all(RopeNode *root, const uint32_t *needle, int len, int **matches);
+
+/**
+ * rope_summary() - Returns the summary of the text in the rope.
+ *
+ * @root: The root node of the rope.
+ *
+ * This function returns the metrics of all the text in the rope, such as its
+ * size in UTF-8 bytes, which are stored in the root node.
+ */
+RopeSummary rope_summary(RopeNode *root);
+
+/**
+ * rope_measure() - Measures the text before an index by a metric.
+ *
+ * @root: The root node of the rope.
+ * @metric: The metric to measure.
+ * @index: The index of the character, or the length of the rope.
+ *
+ * This function returns the metric of the text before the index, such as the
+ * UTF-8 byte offset or the line of the character. It descends a single path
+ * from the root, adding up the summaries of the subtrees to the left of it,
+ * and only scans the text of the leaf at the end, so it takes O(log n) time.
+ * This function returns -1 if the index is outside of the rope. For error
+ * information, use SDL_GetError().
+ */
+int rope_measure(RopeNode *root, RopeMetric metric, int index);
+
+/**
+ * rope_seek() - Finds the index where the text reaches a measure.
+ *
+ * @root: The root node of the rope.
+ * @metric: The metric to seek by.
+ * @value: The measure of the text before the index to find.
+ *
+ * This function returns the smallest index such that the text before it
+ * measures at least the value, which is the inverse of rope_measure(). A
+ * UTF-8 or UTF-16 offset in the middle of a codepoint is rounded up to the
+ * index after it, and seeking to a number of newlines gives the index just
+ * after the last of them. Like rope_measure(), it takes O(log n) time. This
+ * function returns -1 if the value is more than the measure of the whole
+ * rope. For error information, use SDL_GetError().
+ */
+int rope_seek(RopeNode *root, RopeMetric metric, int value);
+
+/**
+ * rope_newlines() - Returns the number of newlines in the rope.
+ *
+ * @root: The root node of the rope.
+ *
+ * This function returns the number of newline characters in the rope, which
+ * is stored in the summary of the root node. The rope has one more line than
+ * it has newlines, where the last line is the text after the last newline.
+ */
+int rope_newlines(RopeNode *root);
+
+/**
+ * rope_line_start() - Finds the index of the start of a line.
+ *
+ * @root: The root node of the rope.
+ * @line: The line to find (zero-indexed).
+ *
+ * This function returns the index of the first character of the line, which
+ * is the index just after the newline that ends the line before it. For an
+ * empty line, this is the index of its own newline, or the length of the
+ * rope for an empty last line. It seeks to the line with rope_seek(), so it
+ * takes O(log n) time. This function returns -1 if the line is not in the
+ * rope. For error information, use SDL_GetError().
+ */
+int rope_line_start(RopeNode *root, int line);
+
+/**
+ * rope_line_at() - Finds the line that holds an index.
+ *
+ * @root: The root node of the rope.
+ * @index: The index of the character, or the length of the rope.
+ *
+ * This function returns the line that holds the character at the index,
+ * which is the number of newlines before it. A newline belongs to the line
+ * that it ends. It measures the newlines before the index with
+ * rope_measure(), so it takes O(log n) time. This function returns -1 if the
+ * index is outside of the rope. For error information, use SDL_GetError().
+ */
+int rope_line_at(RopeNode *root, int index);
+
+/**
+ * rope_equal() - Checks whether two ropes hold the same text.
+ *
+ * @a: The root node of the first rope.
+ * @b: The root node of the second rope.
+ *
+ * This function compares the lengths and summaries of the ropes, and then
+ * their text. If ROPE_INTERN is defined, the text is compared through the
+ * hashes kept in the roots, which takes O(1) time, and two ropes with
+ * different text are reported equal with a chance of about one in 2^61.
+ * Otherwise, the text is compared a chunk at a time, which takes O(n) time.
+ */
+bool rope_equal(RopeNode *a, RopeNode *b);
+
+/**
+ * rope_diff() - Finds the ranges of text that differ between two ropes.
+ *
+ * @old_root: The root node of the old version of the rope.
+ * @new_root: The root node of the new version of the rope.
+ * @changes: The dynamic array to append the changes to.
+ *
+ * This function compares two versions of a rope by the nodes they share
+ * rather than by their text. Since nodes are immutable once shared, a subtree
+ * that is in both ropes holds the same text in both and is skipped without
+ * being read. The longest node reached in either rope is taken first, and is
+ * either found in the other rope or replaced by its children, so only the
+ * nodes along the paths to the edits are visited. The text of the ropes is
+ * only compared at the ends of each changed range, to trim the characters that
+ * did not change. This takes O(k log n) time for k changes, rather than the
+ * O(n) time of comparing the text. The changes are appended in order, and must
+ * be freed with arrfree(). This function returns the number of changes found.
+ */
+int rope_diff(RopeNode *old_root, RopeNode *new_root, RopeChange **changes);
+
 /**
  * rope_height() - Returns the height of the rope.
  *
  * @root: The root node of the rope.
  * @curr_height: The starting height of the rope.
  *
- * This function returns the total height of the rope by recursively
- * calling itself on subtrees. To find the total height without any
- * previous offset, pass 0 to curr_height.
+ * This function returns the total height of the rope added to the given
+ * offset, using the height stored in the root node. To find the total height
+ * without any previous offset, pass 0 to curr_height.
  */
 int rope_height(RopeNode *root, int curr_height);
 
@@ -168,8 +1018,17 @@ int rope_height(RopeNode *root, int curr_height);
  * @second: The root node of the second rope.
  *
  * This function concatenates two ropes together by assigning them as
- * the left and right subtrees of a new root node. This function returns
- * NULl if it fails. For error information, use SDL_GetError().
+ * the left and right subtrees of a new root node. If the heights of the two
+ * ropes differ by more than ROPE_BALANCE, the shorter rope is instead joined
+ * into the matching subtree along the spine of the taller rope, and the nodes
+ * along that path are rotated to restore balance, in the same way as an AVL
+ * tree. This keeps the height of the rope logarithmic in its length no matter
+ * the order of edits. If the last leaf of the first rope and the first leaf
+ * of the second rope fit in LEAF_WEIGHT codepoints together, they are first
+ * coalesced into a single leaf, so that ropes built up from small edits do
+ * not end up with one leaf per edit. Neither rope is modified, and new nodes
+ * are created for the rebuilt paths. This function returns NULL if it fails.
+ * For error information, use SDL_GetError().
  */
 RopeNode *rope_concat(RopeNode *first, RopeNode *second);
 
@@ -196,12 +1055,15 @@ RopeIndex rope_index(RopeNode *root, int index);
  *
  * This function splits an existing rope at the point after the character
  * pointed to by the index. If the index points to a character in the
- * middle of a leaf node, two new leaf nodes will be created. This function
- * returns an array consisting of two elements, pointers to the two new
- * split ropes. It is guaranteed that if the array is not NULL, then the values
- * inside of the array will not be NULL. Empty ropes will be created with
- * rope_build(). This function returns NULL if it fails. For error information,
- * use SDL_GetError().
+ * middle of a leaf node, two new leaf nodes will be created. The rope is
+ * descended iteratively, collecting the subtrees on either side of the path,
+ * which are then concatenated back onto the two halves of the leaf from the
+ * bottom up, in the same way as rope_substr(). This function returns an array
+ * consisting of two elements, pointers to the two new split ropes. It is
+ * guaranteed that if the array is not NULL, then the values inside of the
+ * array will not be NULL. Empty ropes will be created with rope_build(). This
+ * function returns NULL if it fails. For error information, use
+ * SDL_GetError().
  */
 RopeNode **rope_split(RopeNode *root, int index);
 
@@ -215,12 +1077,149 @@ RopeNode **rope_split(RopeNode *root, int index);
  * This function inserts a character represented by a unicode codepoint
  * into a rope after the point denoted by the given index. It splits the
  * rope into two new ropes at the index, and then does two concatenation
- * operates to insert the new character. The function then returns a
- * pointer to the root node. This function returns NULL if it fails. For
- * error information, use SDL_GetError().
+ * operates to insert the new character. If the caller holds the only
+ * reference to the rope, and no node along the path to the character is
+ * shared, the character is instead inserted into its leaf in place, as long as
+ * the leaf has room, and the same root is returned with an added reference. To
+ * keep an old version of a rope, hold a reference to it. The function then
+ * returns a pointer to the root node. This function returns NULL if it fails.
+ * For error information, use SDL_GetError().
  */
 RopeNode *rope_insert(RopeNode *root, uint32_t c, int idx);
 
+/**
+ * rope_insert_text() - Inserts an array of text into a rope at the given index.
+ *
+ * @root: The root node of the rope.
+ * @text: The array of unicode codepoints representing text.
+ * @len: The length of the array.
+ * @idx: The index after which to insert the text.
+ *
+ * This function inserts text into a rope after the point denoted by the given
+ * index, in the same way as rope_insert() does for a single character. The
+ * text is built into a balanced rope with rope_build(), which is then spliced
+ * in with rope_replace(), so the cost of inserting text is linear in the
+ * length of the text and logarithmic in the length of the rope. This function
+ * returns NULL if it fails. For error information, use SDL_GetError().
+ */
+RopeNode *rope_insert_text(RopeNode *root, uint32_t *text, int len, int idx);
+
+/**
+ * rope_delete() - Deletes the character at the given index from a rope.
+ *
+ * @root: The root node of the rope.
+ * @idx: The index of the character to delete.
+ *
+ * This function deletes the character at the given index, returning a new
+ * rope that shares the rest of its text with the original, as with
+ * rope_delete_range(). Like rope_insert(), a rope that is only referenced by
+ * the caller is instead modified in place when the leaf holding the character
+ * stays full enough, and the same root is returned with an added reference.
+ * This function returns NULL if it fails. For error information, use
+ * SDL_GetError().
+ */
 RopeNode *rope_delete(RopeNode *root, int idx);
 
+/**
+ * rope_substr() - Creates a rope holding a range of the text of a rope.
+ *
+ * @root: The root node of the rope.
+ * @start: The index of the first character of the range.
+ * @len: The number of characters in the range.
+ *
+ * This function returns a new rope holding the given range of text. The rope
+ * is descended once along the paths to the two ends of the range, and the
+ * subtrees between the two paths are shared with the new rope instead of being
+ * copied, so only the leaves at either end of the range have text copied out
+ * of them. The original rope is not modified. This function returns NULL if it
+ * fails, or if the range is not within the rope. For error information, use
+ * SDL_GetError().
+ */
+RopeNode *rope_substr(RopeNode *root, int start, int len);
+
+/**
+ * rope_delete_range() - Deletes a range of characters from a rope.
+ *
+ * @root: The root node of the rope.
+ * @start: The index of the first character to delete.
+ * @len: The number of characters to delete.
+ *
+ * This function returns a new rope with the given range of text removed, by
+ * cutting the rope at both ends of the range in a single pass as in
+ * rope_substr(), and concatenating the ropes before and after the range. The
+ * cost is logarithmic in the length of the rope, no matter the length of the
+ * range. This function returns NULL if it fails, or if the range is not within
+ * the rope. For error information, use SDL_GetError().
+ */
+RopeNode *rope_delete_range(RopeNode *root, int start, int len);
+
+/**
+ * rope_replace() - Replaces a range of characters in a rope with another rope.
+ *
+ * @root: The root node of the rope.
+ * @start: The index of the first character to replace.
+ * @len: The number of characters to replace.
+ * @rope: The root node of the rope to put in place of the range.
+ *
+ * This function returns a new rope with the given range of text replaced by
+ * the text of another rope, which is shared rather than copied. Neither rope
+ * is modified. Like rope_delete_range(), the cost is logarithmic in the length
+ * of the ropes. This function returns NULL if it fails, or if the range is not
+ * within the rope. For error information, use SDL_GetError().
+ */
+RopeNode *rope_replace(RopeNode *root, int start, int len, RopeNode *rope);
+
+/**
+ * rope_finger_insert() - Inserts a character into a rope using a finger.
+ *
+ * @finger: The finger to use.
+ * @root: The root node of the rope.
+ * @c: The unicode codepoint representing the character.
+ * @idx: The index after which to insert the character.
+ *
+ * This function inserts a character in the same way as rope_insert(). If the
+ * rope is only referenced by the caller and the index is within or at the end
+ * of the leaf under the finger, the character is inserted into that leaf in
+ * place without descending from the root. Only the length of the root is
+ * updated right away, and the change is added to the other nodes above the
+ * leaf once the finger moves to another leaf or is flushed. Otherwise, the
+ * finger is moved to the leaf holding the index, or flushed if the edit has
+ * to rebuild the rope. The summary of the root is also kept up to date, and
+ * the change to it is added to the other nodes in the same way. Until the
+ * finger is flushed, the rope may only be edited through the finger, read
+ * from the start with rope_text() or rope_copy_out(), or passed to
+ * rope_length(), rope_summary(), rope_newlines() and rope_deref(). This
+ * function returns NULL if it fails. For error information, use
+ * SDL_GetError().
+ */
+RopeNode *rope_finger_insert(RopeFinger *finger, RopeNode *root, uint32_t c, int idx);
+
+/**
+ * rope_finger_delete() - Deletes a character from a rope using a finger.
+ *
+ * @finger: The finger to use.
+ * @root: The root node of the rope.
+ * @idx: The index of the character to delete.
+ *
+ * This function deletes a character in the same way as rope_delete(), going
+ * straight to the leaf under the finger when it holds the character, like
+ * rope_finger_insert(). In the binary layout, the leaf keeps being edited in
+ * place until it has a single character left, since a run of deletes at a
+ * cursor usually goes on to empty it. This function returns NULL if it fails.
+ * For error information, use SDL_GetError().
+ */
+RopeNode *rope_finger_delete(RopeFinger *finger, RopeNode *root, int idx);
+
+/**
+ * rope_finger_flush() - Finishes the edits made with a finger.
+ *
+ * @finger: The finger to flush.
+ *
+ * This function adds the changes made through the finger to the nodes above
+ * its leaf, so that the rope can be used by any other function, and leaves
+ * the finger outside of any rope. It must be called before the rope the
+ * finger is in is dereferenced for the last time, or edited in any other way.
+ */
+void rope_finger_flush(RopeFinger *finger);
+
 #endif // ROPE_H
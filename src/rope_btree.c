@@ -0,0 +1,1097 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_stdinc.h>
+#include <SDL3/SDL_thread.h>
+
+#include "pool.h"
+#include "rope.h"
+#include "stb_ds.h"
+
+// The empty rope, which is shared by every empty rope. It starts with a
+// reference held by the rope module itself, so it is never freed.
+static RopeNode rope_empty = {.weight = 0, .height = 1, .ref_count = 1};
+
+// adds a summary to another, or subtracts it if the sign is -1
+static void rope_summary_add(RopeSummary *summary, RopeSummary other, int sign)
+{
+  summary->bytes += sign * other.bytes;
+  summary->newlines += sign * other.newlines;
+  summary->utf16 += sign * other.utf16;
+}
+
+// returns a metric from the summary of text of the given length
+static int rope_summary_metric(RopeSummary summary, int length, RopeMetric metric)
+{
+  switch (metric) {
+  case ROPE_BYTES: return summary.bytes;
+  case ROPE_NEWLINES: return summary.newlines;
+  case ROPE_UTF16: return summary.utf16;
+  default: return length;
+  }
+}
+
+// allocates a new empty leaf with a reference count of 1
+static RopeNode *rope_alloc(void)
+{
+  RopeNode *node = pool_alloc(sizeof(RopeNode));
+  if (node == NULL) return NULL;
+  node->weight = 0;
+  node->height = 1;
+  node->ref_count = 1;
+  node->count = 0;
+  node->summary = (RopeSummary){0};
+  return node;
+}
+
+// creates a leaf holding a copy of the text, which must fit in LEAF_WEIGHT
+static RopeNode *rope_leaf(const uint32_t *text, int length)
+{
+  RopeNode *node = rope_alloc();
+  if (node == NULL) return NULL;
+  if (length > 0) memcpy(node->value, text, length * sizeof(uint32_t));
+  node->weight = length;
+  node->count = length;
+  node->summary = rope_summarize(text, length);
+  return node;
+}
+
+// turns a block into an internal node holding the given children, which must
+// all have the same height, taking over the references the caller held to them
+static RopeNode *rope_adopt(void *block, RopeNode **children, int count)
+{
+  RopeNode *node = block;
+  node->weight = 0;
+  node->height = children[0]->height + 1;
+  node->ref_count = 1;
+  node->count = count;
+  node->summary = (RopeSummary){0};
+  for (int i = 0; i < count; i++) {
+    node->children[i] = children[i];
+    node->lengths[i] = children[i]->weight;
+    node->weight += children[i]->weight;
+    rope_summary_add(&node->summary, children[i]->summary, 1);
+  }
+  return node;
+}
+
+// creates an internal node referencing the given children, which must all
+// have the same height
+static RopeNode *rope_branch(RopeNode **children, int count)
+{
+  RopeNode *node = pool_alloc(sizeof(RopeNode));
+  if (node == NULL) return NULL;
+  for (int i = 0; i < count; i++) rope_ref(children[i]);
+  return rope_adopt(node, children, count);
+}
+
+// returns whether a node is full enough to be a child without being merged
+static bool rope_ok_child(RopeNode *node)
+{
+  if (node->height == 1) return node->count >= ROPE_MIN_LEAF;
+  return node->count >= ROPE_MIN_BRANCH;
+}
+
+// creates a node from the children of two sibling nodes, splitting it in half
+// under a new parent node if there are too many children
+static RopeNode *rope_merge_nodes(RopeNode **first, int first_count,
+                                  RopeNode **second, int second_count)
+{
+  // gather the children of both nodes in order
+  RopeNode *children[2 * ROPE_BRANCH];
+  int count = first_count + second_count;
+  memcpy(children, first, first_count * sizeof(RopeNode*));
+  memcpy(children + first_count, second, second_count * sizeof(RopeNode*));
+  if (count <= ROPE_BRANCH) return rope_branch(children, count);
+
+  // split the children into two nodes that are both full enough
+  RopeNode *halves[2] = {
+    rope_branch(children, count / 2),
+    rope_branch(children + count / 2, count - count / 2)
+  };
+  RopeNode *root = NULL;
+  if (halves[0] != NULL && halves[1] != NULL) root = rope_branch(halves, 2);
+  rope_deref(halves[0]);
+  rope_deref(halves[1]);
+  return root;
+}
+
+// creates a node from the text of two sibling leaves, splitting it in half
+// under a new parent node if there is too much text
+static RopeNode *rope_merge_leaves(RopeNode *first, RopeNode *second)
+{
+  // gather the text of both leaves in order
+  uint32_t text[2 * LEAF_WEIGHT];
+  int count = first->count + second->count;
+  memcpy(text, first->value, first->count * sizeof(uint32_t));
+  memcpy(text + first->count, second->value, second->count * sizeof(uint32_t));
+  if (count <= LEAF_WEIGHT) return rope_leaf(text, count);
+
+  // split the text into two leaves that are both full enough
+  RopeNode *halves[2] = {
+    rope_leaf(text, count / 2),
+    rope_leaf(text + count / 2, count - count / 2)
+  };
+  RopeNode *root = NULL;
+  if (halves[0] != NULL && halves[1] != NULL) root = rope_branch(halves, 2);
+  rope_deref(halves[0]);
+  rope_deref(halves[1]);
+  return root;
+}
+
+// creates a node from two sibling nodes of the same height
+static RopeNode *rope_merge_siblings(RopeNode *first, RopeNode *second)
+{
+  if (first->height == 1) return rope_merge_leaves(first, second);
+  return rope_merge_nodes(first->children, first->count,
+                          second->children, second->count);
+}
+
+// joins two non-empty ropes by descending the taller one until the heights
+// match, merging nodes that are not full enough on the way back up
+static RopeNode *rope_join(RopeNode *first, RopeNode *second)
+{
+  // ropes of the same height become siblings
+  if (first->height == second->height) {
+    if (rope_ok_child(first) && rope_ok_child(second)) {
+      return rope_branch((RopeNode*[]){first, second}, 2);
+    }
+    return rope_merge_siblings(first, second);
+  }
+
+  RopeNode *joined = NULL;
+  RopeNode *root = NULL;
+
+  // the second rope is taller, so join into its leftmost child
+  if (first->height < second->height) {
+    RopeNode **rest = second->children + 1;
+    int rest_count = second->count - 1;
+    if (first->height == second->height - 1 && rope_ok_child(first)) {
+      return rope_merge_nodes(&first, 1, second->children, second->count);
+    }
+    joined = rope_join(first, second->children[0]);
+    if (joined == NULL) return NULL;
+    if (joined->height == second->height - 1) {
+      root = rope_merge_nodes(&joined, 1, rest, rest_count);
+    } else {
+      root = rope_merge_nodes(joined->children, joined->count, rest, rest_count);
+    }
+  }
+
+  // the first rope is taller, so join into its rightmost child
+  else {
+    int rest_count = first->count - 1;
+    if (second->height == first->height - 1 && rope_ok_child(second)) {
+      return rope_merge_nodes(first->children, first->count, &second, 1);
+    }
+    joined = rope_join(first->children[rest_count], second);
+    if (joined == NULL) return NULL;
+    if (joined->height == first->height - 1) {
+      root = rope_merge_nodes(first->children, rest_count, &joined, 1);
+    } else {
+      root = rope_merge_nodes(first->children, rest_count, joined->children, joined->count);
+    }
+  }
+
+  rope_deref(joined);
+  return root;
+}
+
+// returns a run of sibling nodes as a single rope
+static RopeNode *rope_children(RopeNode **children, int count)
+{
+  if (count == 0) return rope_build(NULL, 0);
+  if (count == 1) {
+    rope_ref(children[0]);
+    return children[0];
+  }
+  return rope_branch(children, count);
+}
+
+// returns the child of an internal node containing the given position, and
+// the position of the first character of that child. A position at the end of
+// a child is contained in that child if inclusive is true, and in the next
+// child otherwise.
+static int rope_find_child(RopeNode *node, int pos, bool inclusive, int *offset)
+{
+  int i = 0;
+  *offset = 0;
+  while (i < node->count - 1) {
+    int end = *offset + node->lengths[i];
+    if (pos < end || (inclusive && pos == end)) break;
+    *offset = end;
+    i++;
+  }
+  return i;
+}
+
+// collapses internal roots that only have a single child
+static RopeNode *rope_collapse(RopeNode *root)
+{
+  while (root->height > 1 && root->count == 1) {
+    RopeNode *child = root->children[0];
+    rope_ref(child);
+    rope_deref(root);
+    root = child;
+  }
+  return root;
+}
+
+/*
+ * A share of the work of rope_build_threads(), which fills in a run of leaves.
+ */
+typedef struct RopeBuildTask {
+  const uint32_t *text;
+  int length;
+  int count;
+  void **blocks;
+  RopeNode **nodes;
+  int start;
+  int end;
+} RopeBuildTask;
+
+// runs a build task, which only writes to memory that was allocated for it
+static int rope_build_task(void *data)
+{
+  // spread the text evenly across the leaves
+  RopeBuildTask *task = data;
+  for (int i = task->start; i < task->end; i++) {
+    int start = (int)((int64_t)task->length * i / task->count);
+    int end = (int)((int64_t)task->length * (i + 1) / task->count);
+    RopeNode *leaf = task->blocks[i];
+    leaf->weight = end - start;
+    leaf->height = 1;
+    leaf->ref_count = 1;
+    leaf->count = end - start;
+    leaf->summary = rope_summarize(&task->text[start], end - start);
+    memcpy(leaf->value, &task->text[start], (end - start) * sizeof(uint32_t));
+    task->nodes[i] = leaf;
+  }
+  return 0;
+}
+
+RopeNode *rope_build(uint32_t *text, int length)
+{
+  return rope_build_threads(text, length, 0);
+}
+
+RopeNode *rope_build_threads(uint32_t *text, int length, int threads)
+{
+  // handle empty case by sharing the empty rope
+  if (length == 0) {
+    rope_ref(&rope_empty);
+    return &rope_empty;
+  }
+
+  // guard against negative length
+  if (length < 0) {
+    SDL_SetError("Cannot build a rope with negative length");
+    return NULL;
+  }
+
+  // count the leaves and the parents on each level above them, and allocate
+  // all of them up front, with the leaves first
+  int count = (length + LEAF_WEIGHT - 1) / LEAF_WEIGHT;
+  int total = count;
+  for (int level = count; level > 1; total += level) {
+    level = (level + ROPE_BRANCH - 1) / ROPE_BRANCH;
+  }
+  void **blocks = malloc(total * sizeof(void*));
+  RopeNode **nodes = malloc(count * sizeof(RopeNode*));
+  if (blocks == NULL || nodes == NULL) {
+    SDL_SetError("Failed to allocate memory in rope_build");
+    free(blocks);
+    free(nodes);
+    return NULL;
+  }
+  if (!pool_alloc_many(sizeof(RopeNode), total, blocks)) {
+    free(blocks);
+    free(nodes);
+    return NULL;
+  }
+
+  // fill in an even share of the leaves on each thread, running the first
+  // share on this thread, and any share whose thread cannot be started
+  if (threads <= 0) threads = SDL_GetNumLogicalCPUCores();
+  if (threads > ROPE_BUILD_MAX_THREADS) threads = ROPE_BUILD_MAX_THREADS;
+  int tasks = length / ROPE_BUILD_MIN_TEXT < threads ? length / ROPE_BUILD_MIN_TEXT : threads;
+  if (tasks < 1) tasks = 1;
+  RopeBuildTask task[ROPE_BUILD_MAX_THREADS];
+  SDL_Thread *thread[ROPE_BUILD_MAX_THREADS];
+  for (int i = 0; i < tasks; i++) {
+    task[i] = (RopeBuildTask){
+      .text = text, .length = length, .count = count, .blocks = blocks, .nodes = nodes,
+      .start = (int)((int64_t)count * i / tasks), .end = (int)((int64_t)count * (i + 1) / tasks),
+    };
+  }
+  for (int i = 1; i < tasks; i++) {
+    thread[i] = SDL_CreateThread(rope_build_task, "rope_build", &task[i]);
+  }
+  rope_build_task(&task[0]);
+  for (int i = 1; i < tasks; i++) {
+    if (thread[i] == NULL) rope_build_task(&task[i]);
+    else SDL_WaitThread(thread[i], NULL);
+  }
+
+  // group each level of nodes evenly under parents until one root is left
+  void **parents = blocks + count;
+  while (count > 1) {
+    int level = (count + ROPE_BRANCH - 1) / ROPE_BRANCH;
+    int start = 0;
+    for (int i = 0; i < level; i++) {
+      int end = (int)((int64_t)count * (i + 1) / level);
+      nodes[i] = rope_adopt(*parents++, &nodes[start], end - start);
+      start = end;
+    }
+    count = level;
+  }
+
+  RopeNode *root = nodes[0];
+  free(blocks);
+  free(nodes);
+  return root;
+}
+
+// descends from the root of an iterator to the leaf holding the character at
+// the index, or to the last leaf if the index is the length of the rope. The
+// height of a B-tree is well within ROPE_ITER_DEPTH, so the path always fits.
+static void rope_iter_seek(RopeIter *iter, int index)
+{
+  RopeNode *node = iter->root;
+  int start = 0;
+  iter->depth = 0;
+  while (node->height > 1) {
+    int offset;
+    int i = rope_find_child(node, index - start, false, &offset);
+    iter->path[iter->depth] = node;
+    iter->steps[iter->depth++] = i;
+    start += offset;
+    node = node->children[i];
+  }
+  iter->leaf = node;
+  iter->leaf_start = start;
+}
+
+// moves an iterator to the next or previous leaf, returning false if there is
+// none. The chunk is left for the caller to update.
+static bool rope_iter_step(RopeIter *iter, bool forward)
+{
+  // go up to the last node with a sibling on that side of the path
+  int depth = iter->depth;
+  while (depth > 0) {
+    int i = iter->steps[depth - 1];
+    if (forward ? i < iter->path[depth - 1]->count - 1 : i > 0) break;
+    depth--;
+  }
+  if (depth == 0) return false;
+  iter->steps[depth - 1] += forward ? 1 : -1;
+  iter->depth = depth;
+  RopeNode *node = iter->path[depth - 1]->children[iter->steps[depth - 1]];
+
+  // and go down the sibling to its first or last leaf
+  while (node->height > 1) {
+    int i = forward ? 0 : node->count - 1;
+    iter->path[iter->depth] = node;
+    iter->steps[iter->depth++] = i;
+    node = node->children[i];
+  }
+  iter->leaf_start += forward ? iter->leaf->weight : -node->weight;
+  iter->leaf = node;
+  return true;
+}
+
+bool rope_iter_init(RopeIter *iter, RopeNode *root, int index)
+{
+  if (index < 0 || index > root->weight) {
+    SDL_SetError("Index is outside of the rope");
+    return false;
+  }
+  iter->root = root;
+  rope_iter_seek(iter, index);
+  iter->chunk = iter->leaf->value + (index - iter->leaf_start);
+  iter->len = iter->leaf_start + iter->leaf->weight - index;
+  iter->start = index;
+  return true;
+}
+
+bool rope_iter_next(RopeIter *iter)
+{
+  // step to the rest of the current leaf, or otherwise to the next leaf
+  int end = iter->start + iter->len;
+  if (end == iter->leaf_start + iter->leaf->weight) {
+    if (!rope_iter_step(iter, true)) return false;
+    end = iter->leaf_start;
+  }
+  iter->chunk = iter->leaf->value + (end - iter->leaf_start);
+  iter->len = iter->leaf_start + iter->leaf->weight - end;
+  iter->start = end;
+  return true;
+}
+
+bool rope_iter_prev(RopeIter *iter)
+{
+  // step to the start of the current leaf, or otherwise to the previous leaf
+  int end = iter->start;
+  if (end == iter->leaf_start) {
+    if (!rope_iter_step(iter, false)) return false;
+    end = iter->leaf_start + iter->leaf->weight;
+  }
+  iter->chunk = iter->leaf->value;
+  iter->len = end - iter->leaf_start;
+  iter->start = iter->leaf_start;
+  return true;
+}
+
+uint32_t *rope_text(RopeNode *root)
+{
+  // exit if there is no rope
+  if (root == NULL) {
+    SDL_SetError("Rope does not exist");
+    return NULL;
+  }
+  if (root->weight == 0) return NULL;
+
+  RopeIter iter;
+  if (!rope_iter_init(&iter, root, 0)) return NULL;
+
+  // allocate the whole array, and copy the text of each leaf into it
+  uint32_t *text = NULL;
+  arrsetlen(text, root->weight);
+  uint32_t *dst = text;
+  do {
+    memcpy(dst, iter.chunk, iter.len * sizeof(uint32_t));
+    dst += iter.len;
+  } while (rope_iter_next(&iter));
+  return text;
+}
+
+void rope_arr_free(RopeNode **arr, int length)
+{
+  // exit if array is NULL
+  if (arr == NULL) return;
+
+  // dereference each node inside of the array and free
+  for (int i = 0; i < length; i++) {
+    rope_deref(arr[i]);
+  }
+  free(arr);
+}
+
+int rope_length(RopeNode *root)
+{
+  return root->weight;
+}
+
+int rope_measure(RopeNode *root, RopeMetric metric, int index)
+{
+  if (index < 0 || index > root->weight) {
+    SDL_SetError("Index is outside of the rope");
+    return -1;
+  }
+
+  // add up the summaries of the children passed on the way to the leaf
+  RopeNode *node = root;
+  int measure = 0;
+  while (node->height > 1) {
+    int offset;
+    int i = rope_find_child(node, index, false, &offset);
+    for (int j = 0; j < i; j++) {
+      measure += rope_summary_metric(node->children[j]->summary, node->lengths[j], metric);
+    }
+    index -= offset;
+    node = node->children[i];
+  }
+  return measure + rope_summary_metric(rope_summarize(node->value, index), index, metric);
+}
+
+int rope_seek(RopeNode *root, RopeMetric metric, int value)
+{
+  if (value < 0 || value > rope_summary_metric(root->summary, root->weight, metric)) {
+    SDL_SetError("Value is outside of the rope");
+    return -1;
+  }
+
+  // descend to the leaf where the measure reaches the value, using the
+  // summaries of the children
+  RopeNode *node = root;
+  int index = 0;
+  while (node->height > 1) {
+    int i = 0;
+    int child = rope_summary_metric(node->children[0]->summary, node->lengths[0], metric);
+    while (value > child) {
+      value -= child;
+      index += node->lengths[i];
+      i++;
+      child = rope_summary_metric(node->children[i]->summary, node->lengths[i], metric);
+    }
+    node = node->children[i];
+  }
+
+  // and measure the text of the leaf until it does
+  int i = 0;
+  while (value > 0) {
+    value -= rope_summary_metric(rope_summarize(&node->value[i], 1), 1, metric);
+    i++;
+  }
+  return index + i;
+}
+
+int rope_height(RopeNode *root, int curr_height)
+{
+  if (root == NULL) return curr_height;
+  return curr_height + root->height;
+}
+
+RopeNode *rope_concat(RopeNode *first, RopeNode *second)
+{
+  // skip if one of the ropes is empty
+  if (first->weight == 0) {
+    rope_ref(second);
+    return second;
+  } else if (second->weight == 0) {
+    rope_ref(first);
+    return first;
+  }
+  return rope_join(first, second);
+}
+
+RopeIndex rope_index(RopeNode *root, int index)
+{
+  // descend using the lengths of the children
+  RopeNode *node = root;
+  while (node->height > 1) {
+    int offset;
+    int i = rope_find_child(node, index, false, &offset);
+    node = node->children[i];
+    index -= offset;
+  }
+
+  RopeIndex idx = {
+    .node = node,
+    .c = node->value[index],
+    .n_idx = index
+  };
+  return idx;
+}
+
+// splits a rope so that the first rope holds the first count characters
+static bool rope_split_at(RopeNode *root, int count, RopeNode **first, RopeNode **second)
+{
+  *first = NULL;
+  *second = NULL;
+
+  // splitting at either end shares the whole rope
+  if (count <= 0 || count >= root->weight) {
+    RopeNode *empty = rope_build(NULL, 0);
+    if (empty == NULL) return false;
+    rope_ref(root);
+    *first = count <= 0 ? empty : root;
+    *second = count <= 0 ? root : empty;
+    return true;
+  }
+
+  // split the text of a leaf into two new leaves
+  if (root->height == 1) {
+    *first = rope_leaf(root->value, count);
+    *second = rope_leaf(root->value + count, root->weight - count);
+    return *first != NULL && *second != NULL;
+  }
+
+  // split the child containing the split point and join the halves with the
+  // siblings on either side
+  int offset;
+  int i = rope_find_child(root, count, false, &offset);
+  if (count == offset) {
+    *first = rope_children(root->children, i);
+    *second = rope_children(root->children + i, root->count - i);
+    return *first != NULL && *second != NULL;
+  }
+  RopeNode *halves[2];
+  if (!rope_split_at(root->children[i], count - offset, &halves[0], &halves[1])) {
+    rope_deref(halves[0]);
+    rope_deref(halves[1]);
+    return false;
+  }
+  RopeNode *before = rope_children(root->children, i);
+  RopeNode *after = rope_children(root->children + i + 1, root->count - i - 1);
+  if (before != NULL && after != NULL) {
+    *first = rope_concat(before, halves[0]);
+    *second = rope_concat(halves[1], after);
+  }
+  rope_deref(before);
+  rope_deref(after);
+  rope_deref(halves[0]);
+  rope_deref(halves[1]);
+  return *first != NULL && *second != NULL;
+}
+
+RopeNode **rope_split(RopeNode *root, int index)
+{
+  // allocate memory for new root pointers
+  RopeNode **new_roots = malloc(2 * sizeof(RopeNode*));
+  if (new_roots == NULL) {
+    SDL_SetError("Failed to allocate memory during rope_split");
+    return NULL;
+  }
+
+  // split after the index and remove any single child roots
+  if (!rope_split_at(root, index + 1, &new_roots[0], &new_roots[1])) {
+    rope_deref(new_roots[0]);
+    rope_deref(new_roots[1]);
+    free(new_roots);
+    return NULL;
+  }
+  new_roots[0] = rope_collapse(new_roots[0]);
+  new_roots[1] = rope_collapse(new_roots[1]);
+  return new_roots;
+}
+
+// cuts a rope before the positions start and end, storing the ropes before,
+// between and after them in out. The middle rope is split off of the rest of
+// the rope after the first cut, so only the nodes along the two paths are
+// rebuilt, and the subtrees between them are shared.
+static bool rope_slice(RopeNode *root, int start, int end, RopeNode **out)
+{
+  RopeNode *rest = NULL;
+  out[1] = out[2] = NULL;
+  bool ok = rope_split_at(root, start, &out[0], &rest) &&
+            rope_split_at(rest, end - start, &out[1], &out[2]);
+  rope_deref(rest);
+  for (int i = 0; i < 3; i++) {
+    if (ok) {
+      out[i] = rope_collapse(out[i]);
+    } else {
+      rope_deref(out[i]);
+    }
+  }
+  return ok;
+}
+
+// checks that a range lies within a rope
+static bool rope_check_range(RopeNode *root, int start, int len)
+{
+  if (start < 0 || len < 0 || start > root->weight - len) {
+    SDL_SetError("Range is outside of the rope");
+    return false;
+  }
+  return true;
+}
+
+bool rope_copy_out(RopeNode *root, int start, int len, uint32_t *dst)
+{
+  if (!rope_check_range(root, start, len)) return false;
+  if (len == 0) return true;
+
+  // copy each chunk until the range runs out
+  RopeIter iter;
+  if (!rope_iter_init(&iter, root, start)) return false;
+  while (true) {
+    int count = iter.len < len ? iter.len : len;
+    memcpy(dst, iter.chunk, count * sizeof(uint32_t));
+    dst += count;
+    len -= count;
+    if (len == 0 || !rope_iter_next(&iter)) return true;
+  }
+}
+
+int rope_copy_out_utf8(RopeNode *root, int start, int len, char *dst)
+{
+  if (!rope_check_range(root, start, len)) return -1;
+  if (len == 0) return 0;
+
+  // encode each chunk until the range runs out
+  RopeIter iter;
+  if (!rope_iter_init(&iter, root, start)) return -1;
+  char *end = dst;
+  while (true) {
+    int count = iter.len < len ? iter.len : len;
+    end += rope_encode_utf8(iter.chunk, count, end);
+    len -= count;
+    if (len == 0 || !rope_iter_next(&iter)) return (int)(end - dst);
+  }
+}
+
+RopeNode *rope_substr(RopeNode *root, int start, int len)
+{
+  RopeNode *out[3];
+  if (!rope_check_range(root, start, len)) return NULL;
+  if (!rope_slice(root, start, start + len, out)) return NULL;
+  rope_deref(out[0]);
+  rope_deref(out[2]);
+  return out[1];
+}
+
+RopeNode *rope_replace(RopeNode *root, int start, int len, RopeNode *rope)
+{
+  // cut out the range
+  RopeNode *out[3];
+  if (!rope_check_range(root, start, len)) return NULL;
+  if (!rope_slice(root, start, start + len, out)) return NULL;
+  rope_deref(out[1]);
+
+  // concatenate (before + rope + after)
+  RopeNode *new_rope = rope_concat(out[0], rope);
+  if (new_rope != NULL) {
+    RopeNode *prev = new_rope;
+    new_rope = rope_concat(prev, out[2]);
+    rope_deref(prev);
+  }
+  rope_deref(out[0]);
+  rope_deref(out[2]);
+  return new_rope;
+}
+
+RopeNode *rope_delete_range(RopeNode *root, int start, int len)
+{
+  RopeNode *out[3];
+  if (!rope_check_range(root, start, len)) return NULL;
+  if (!rope_slice(root, start, start + len, out)) return NULL;
+  RopeNode *new_rope = rope_concat(out[0], out[2]);
+  for (int i = 0; i < 3; i++) rope_deref(out[i]);
+  return new_rope;
+}
+
+// replaces the child at the given index with new children, and stores the new
+// node in out[0], along with its new right sibling in out[1] if there were too
+// many children. Returns the number of nodes created, or 0 if it fails.
+static int rope_replace_child(RopeNode *node, int i, RopeNode **replace, int replace_count,
+                              RopeNode **out)
+{
+  // gather the children with the replacement in place
+  RopeNode *children[ROPE_BRANCH + 1];
+  int count = 0;
+  for (int j = 0; j < i; j++) children[count++] = node->children[j];
+  for (int j = 0; j < replace_count; j++) children[count++] = replace[j];
+  for (int j = i + 1; j < node->count; j++) children[count++] = node->children[j];
+
+  // split the node in half if it has too many children
+  if (count <= ROPE_BRANCH) {
+    out[0] = rope_branch(children, count);
+    return out[0] == NULL ? 0 : 1;
+  }
+  out[0] = rope_branch(children, count / 2);
+  out[1] = rope_branch(children + count / 2, count - count / 2);
+  if (out[0] == NULL || out[1] == NULL) {
+    rope_deref(out[0]);
+    rope_deref(out[1]);
+    return 0;
+  }
+  return 2;
+}
+
+// inserts a character before the given position in a node, and stores the new
+// node in out[0], along with its new right sibling in out[1] if the node had
+// to be split. Returns the number of nodes created, or 0 if it fails.
+static int rope_insert_at(RopeNode *node, int pos, uint32_t c, RopeNode **out)
+{
+  out[0] = NULL;
+  out[1] = NULL;
+
+  // copy the text of a leaf with the character inserted
+  if (node->height == 1) {
+    uint32_t text[LEAF_WEIGHT + 1];
+    memcpy(text, node->value, pos * sizeof(uint32_t));
+    text[pos] = c;
+    memcpy(text + pos + 1, node->value + pos, (node->count - pos) * sizeof(uint32_t));
+    int count = node->count + 1;
+    if (count <= LEAF_WEIGHT) {
+      out[0] = rope_leaf(text, count);
+      return out[0] == NULL ? 0 : 1;
+    }
+
+    // split the leaf in half if it is full
+    out[0] = rope_leaf(text, count / 2);
+    out[1] = rope_leaf(text + count / 2, count - count / 2);
+    if (out[0] == NULL || out[1] == NULL) {
+      rope_deref(out[0]);
+      rope_deref(out[1]);
+      return 0;
+    }
+    return 2;
+  }
+
+  // insert into the child containing the position, preferring to append to the
+  // end of a child over prepending to the start of the next one
+  int offset;
+  int i = rope_find_child(node, pos, true, &offset);
+  RopeNode *replace[2];
+  int replace_count = rope_insert_at(node->children[i], pos - offset, c, replace);
+  if (replace_count == 0) return 0;
+  int count = rope_replace_child(node, i, replace, replace_count, out);
+  for (int j = 0; j < replace_count; j++) rope_deref(replace[j]);
+  return count;
+}
+
+// returns the leaf holding the given position, with positions at the end of a
+// child handled as in rope_find_child(), and stores the offset into the leaf.
+// Returns NULL if any node along the path is shared.
+static RopeNode *rope_owned_leaf(RopeNode *root, int pos, bool inclusive, int *offset)
+{
+  RopeNode *node = root;
+  while (node->ref_count == 1 && node->height > 1) {
+    int start;
+    node = node->children[rope_find_child(node, pos, inclusive, &start)];
+    pos -= start;
+  }
+  if (node->ref_count != 1) return NULL;
+  *offset = pos;
+  return node;
+}
+
+// adds to the lengths of the nodes along the path to the given position, and
+// to the length of the leaf at the end of it. The summary of the inserted or
+// deleted text is added to or subtracted from their summaries, following the
+// sign of the change in length.
+static void rope_resize_path(RopeNode *root, int pos, bool inclusive, int delta,
+                             RopeSummary change)
+{
+  int sign = delta < 0 ? -1 : 1;
+  RopeNode *node = root;
+  while (node->height > 1) {
+    int start;
+    int i = rope_find_child(node, pos, inclusive, &start);
+    node->weight += delta;
+    node->lengths[i] += delta;
+    rope_summary_add(&node->summary, change, sign);
+    pos -= start;
+    node = node->children[i];
+  }
+  node->weight += delta;
+  node->count += delta;
+  rope_summary_add(&node->summary, change, sign);
+}
+
+RopeNode *rope_insert(RopeNode *root, uint32_t c, int idx)
+{
+  // insert into the leaf in place if nothing else can see the rope, and the
+  // leaf has room
+  int offset;
+  RopeNode *leaf = rope_owned_leaf(root, idx + 1, true, &offset);
+  if (leaf != NULL && leaf->count < LEAF_WEIGHT) {
+    memmove(leaf->value + offset + 1, leaf->value + offset,
+            (leaf->count - offset) * sizeof(uint32_t));
+    leaf->value[offset] = c;
+    rope_resize_path(root, idx + 1, true, 1, rope_summarize(&c, 1));
+    rope_ref(root);
+    return root;
+  }
+
+  // insert the character and add a new root if the old root was split
+  RopeNode *out[2];
+  int count = rope_insert_at(root, idx + 1, c, out);
+  if (count == 0) return NULL;
+  if (count == 1) return out[0];
+  RopeNode *new_root = rope_branch(out, 2);
+  rope_deref(out[0]);
+  rope_deref(out[1]);
+  return new_root;
+}
+
+RopeNode *rope_insert_text(RopeNode *root, uint32_t *text, int len, int idx)
+{
+  // single characters can be inserted in place
+  if (len == 1) return rope_insert(root, text[0], idx);
+
+  // build a balanced rope from the text and splice it in after the index
+  RopeNode *insert = rope_build(text, len);
+  if (insert == NULL) return NULL;
+  RopeNode *new_rope = rope_replace(root, idx + 1, 0, insert);
+  rope_deref(insert);
+  return new_rope;
+}
+
+// removes the character at the given position in a node, returning the new
+// node, which will be an empty leaf if it has no text left
+static RopeNode *rope_delete_at(RopeNode *node, int pos)
+{
+  // copy the text of a leaf without the character
+  if (node->height == 1) {
+    RopeNode *leaf = rope_leaf(node->value, pos);
+    if (leaf == NULL) return NULL;
+    memcpy(leaf->value + pos, node->value + pos + 1,
+           (node->count - pos - 1) * sizeof(uint32_t));
+    leaf->count = leaf->weight = node->count - 1;
+    leaf->summary = node->summary;
+    rope_summary_add(&leaf->summary, rope_summarize(&node->value[pos], 1), -1);
+    return leaf;
+  }
+
+  // delete from the child containing the position
+  int offset;
+  int i = rope_find_child(node, pos, false, &offset);
+  RopeNode *child = rope_delete_at(node->children[i], pos - offset);
+  if (child == NULL) return NULL;
+
+  // drop the child entirely if it is empty
+  if (child->weight == 0) {
+    rope_deref(child);
+    if (node->count == 1) return rope_build(NULL, 0);
+    RopeNode *out[2];
+    rope_replace_child(node, i, NULL, 0, out);
+    return out[0];
+  }
+
+  // keep the child if it is still full enough, or has no siblings to merge with
+  if (rope_ok_child(child) || node->count == 1) {
+    RopeNode *out[2];
+    int count = rope_replace_child(node, i, &child, 1, out);
+    rope_deref(child);
+    return count == 0 ? NULL : out[0];
+  }
+
+  // otherwise merge the child with a neighbouring sibling, which replaces the
+  // two siblings with either one or two new children
+  int first = i > 0 ? i - 1 : i;
+  RopeNode *pair[2] = {node->children[first], node->children[first + 1]};
+  pair[i - first] = child;
+  RopeNode *merged = rope_merge_siblings(pair[0], pair[1]);
+  rope_deref(child);
+  if (merged == NULL) return NULL;
+  RopeNode *children[ROPE_BRANCH];
+  int count = 0;
+  for (int j = 0; j < first; j++) children[count++] = node->children[j];
+  if (merged->height == node->height - 1) {
+    children[count++] = merged;
+  } else {
+    children[count++] = merged->children[0];
+    children[count++] = merged->children[1];
+  }
+  for (int j = first + 2; j < node->count; j++) children[count++] = node->children[j];
+  RopeNode *new_node = rope_branch(children, count);
+  rope_deref(merged);
+  return new_node;
+}
+
+RopeNode *rope_delete(RopeNode *root, int idx)
+{
+  // remove from the leaf in place if nothing else can see the rope, and the
+  // leaf would still be full enough
+  int offset;
+  RopeNode *leaf = rope_owned_leaf(root, idx, false, &offset);
+  if (leaf != NULL && leaf->count > (leaf == root ? 1 : ROPE_MIN_LEAF)) {
+    RopeSummary change = rope_summarize(&leaf->value[offset], 1);
+    memmove(leaf->value + offset, leaf->value + offset + 1,
+            (leaf->count - offset - 1) * sizeof(uint32_t));
+    rope_resize_path(root, idx, false, -1, change);
+    rope_ref(root);
+    return root;
+  }
+
+  RopeNode *new_root = rope_delete_at(root, idx);
+  if (new_root == NULL) return NULL;
+  return rope_collapse(new_root);
+}
+
+void rope_finger_flush(RopeFinger *finger)
+{
+  // add the pending change to the ancestors of the leaf by descending to the
+  // start of the leaf using the lengths from before the change. The weight and
+  // summary of the root are kept up to date, and are left alone.
+  RopeNode *root = finger->root;
+  RopeSummary change = finger->pending_summary;
+  if (root != NULL && (finger->pending != 0 || change.bytes != 0 || change.newlines != 0 ||
+                       change.utf16 != 0)) {
+    RopeNode *node = root;
+    int pos = finger->start;
+    while (node->height > 1) {
+      int start;
+      int i = rope_find_child(node, pos, false, &start);
+      if (node != root) {
+        node->weight += finger->pending;
+        rope_summary_add(&node->summary, change, 1);
+      }
+      node->lengths[i] += finger->pending;
+      pos -= start;
+      node = node->children[i];
+    }
+  }
+  finger->root = NULL;
+  finger->leaf = NULL;
+  finger->start = 0;
+  finger->pending = 0;
+  finger->pending_summary = (RopeSummary){0};
+}
+
+// moves a finger to the leaf holding the given position in a rope, flushing
+// it first if it was in a different leaf. Returns false if the leaf is shared.
+static bool rope_finger_seek(RopeFinger *finger, RopeNode *root, int pos, bool end)
+{
+  // stay in the current leaf if it still holds the position
+  if (finger->root == root && root->ref_count == 1 && pos >= finger->start &&
+      pos < finger->start + finger->leaf->count + end) {
+    return true;
+  }
+
+  // otherwise descend from the root
+  rope_finger_flush(finger);
+  int offset;
+  RopeNode *leaf = rope_owned_leaf(root, pos, end, &offset);
+  if (leaf == NULL || leaf->count == 0) return false;
+  finger->root = root;
+  finger->leaf = leaf;
+  finger->start = pos - offset;
+  return true;
+}
+
+RopeNode *rope_finger_insert(RopeFinger *finger, RopeNode *root, uint32_t c, int idx)
+{
+  // insert into the leaf under the finger in place if it has room
+  if (rope_finger_seek(finger, root, idx + 1, true)) {
+    RopeNode *leaf = finger->leaf;
+    int offset = idx + 1 - finger->start;
+    if (leaf->count < LEAF_WEIGHT) {
+      RopeSummary change = rope_summarize(&c, 1);
+      memmove(leaf->value + offset + 1, leaf->value + offset,
+              (leaf->count - offset) * sizeof(uint32_t));
+      leaf->value[offset] = c;
+      leaf->count++;
+      leaf->weight++;
+      rope_summary_add(&leaf->summary, change, 1);
+      if (leaf != root) {
+        root->weight++;
+        rope_summary_add(&root->summary, change, 1);
+        finger->pending++;
+        rope_summary_add(&finger->pending_summary, change, 1);
+      }
+      rope_ref(root);
+      return root;
+    }
+  }
+
+  // otherwise fall back to rebuilding the path
+  rope_finger_flush(finger);
+  return rope_insert(root, c, idx);
+}
+
+RopeNode *rope_finger_delete(RopeFinger *finger, RopeNode *root, int idx)
+{
+  // remove from the leaf under the finger in place if it stays full enough
+  if (rope_finger_seek(finger, root, idx, false)) {
+    RopeNode *leaf = finger->leaf;
+    int offset = idx - finger->start;
+    if (leaf->count > (leaf == root ? 1 : ROPE_MIN_LEAF)) {
+      RopeSummary change = rope_summarize(&leaf->value[offset], 1);
+      memmove(leaf->value + offset, leaf->value + offset + 1,
+              (leaf->count - offset - 1) * sizeof(uint32_t));
+      leaf->count--;
+      leaf->weight--;
+      rope_summary_add(&leaf->summary, change, -1);
+      if (leaf != root) {
+        root->weight--;
+        rope_summary_add(&root->summary, change, -1);
+        finger->pending--;
+        rope_summary_add(&finger->pending_summary, change, -1);
+      }
+      rope_ref(root);
+      return root;
+    }
+  }
+
+  // otherwise fall back to rebuilding the path
+  rope_finger_flush(finger);
+  return rope_delete(root, idx);
+}
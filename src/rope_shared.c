@@ -0,0 +1,669 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef ROPE_UTF8
+#include <sys/mman.h>
+#endif
+
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_timer.h>
+
+#include "pool.h"
+#include "rope.h"
+#include "stb_ds.h"
+
+// Determines how many nodes rope_reclaim() frees between checks of the time.
+#define ROPE_RECLAIM_CHECK 64
+
+// The dead nodes that are safe to free, as a stack that is only used by the
+// thread that edits ropes, so a large rope is freed a few nodes at a time.
+static RopeNode **dead = NULL;
+
+// The number of nodes freed so far, which bounds how many are freed at once.
+static long freed = 0;
+
+static void rope_free(RopeNode *node);
+#ifdef ROPE_ATOMIC
+static bool rope_ref_live(RopeNode *node);
+#endif
+
+#ifdef ROPE_INTERN
+
+// The interned leaves, keyed by the hash of their text, which do not hold
+// references to the leaves.
+static struct {
+  uint64_t key;
+  RopeNode *value;
+} *interned = NULL;
+
+// returns the number of bytes of text in a leaf
+static size_t rope_leaf_size(RopeNode *leaf)
+{
+#ifdef ROPE_UTF8
+  return leaf->summary.bytes;
+#else
+  return leaf->weight * sizeof(uint32_t);
+#endif
+}
+
+RopeNode *rope_intern(RopeNode *leaf)
+{
+  RopeNode *found = hmget(interned, leaf->hash);
+  if (found == NULL) {
+    hmput(interned, leaf->hash, leaf);
+    return leaf;
+  }
+  if (found != leaf && found->weight == leaf->weight &&
+      rope_leaf_size(found) == rope_leaf_size(leaf) &&
+      memcmp(found->value, leaf->value, rope_leaf_size(leaf)) == 0) {
+#ifdef ROPE_ATOMIC
+    // a retired leaf stays in the table until it is reclaimed, so the new
+    // leaf takes its place rather than reviving it
+    if (!rope_ref_live(found)) {
+      hmput(interned, leaf->hash, leaf);
+      return leaf;
+    }
+#else
+    rope_ref(found);
+#endif
+    rope_deref(leaf);
+    return found;
+  }
+  return leaf;
+}
+
+#endif // ROPE_INTERN
+
+#ifdef ROPE_ATOMIC
+
+// The dead nodes waiting for rope_reclaim(), which any thread can push onto,
+// linked together through their retired field.
+static _Atomic(RopeNode*) retired;
+
+// The root that each reading thread is taking a reference to, and whether each
+// hazard pointer has been claimed by a thread.
+static _Atomic(RopeNode*) hazards[ROPE_MAX_READERS];
+static atomic_bool claimed[ROPE_MAX_READERS];
+static _Thread_local int hazard = -1;
+
+// The retired nodes that rope_reclaim() has taken off the list, but not yet
+// checked against the hazard pointers.
+static RopeNode *unscanned = NULL;
+
+// pushes a dead node onto the retired list
+static void rope_retire(RopeNode *node)
+{
+  RopeNode *head = atomic_load_explicit(&retired, memory_order_relaxed);
+  do {
+    node->retired = head;
+  } while (!atomic_compare_exchange_weak_explicit(&retired, &head, node, memory_order_release,
+                                                  memory_order_relaxed));
+}
+
+// adds a reference to a node unless its reference count has already reached
+// zero, in which case it is about to be retired
+static bool rope_ref_live(RopeNode *node)
+{
+  int count = atomic_load_explicit(&node->ref_count, memory_order_relaxed);
+  while (count > 0) {
+    if (atomic_compare_exchange_weak_explicit(&node->ref_count, &count, count + 1,
+                                              memory_order_acquire, memory_order_relaxed)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void rope_deref(RopeNode *node)
+{
+  if (node == NULL) return;
+  if (atomic_fetch_sub_explicit(&node->ref_count, 1, memory_order_acq_rel) == 1) {
+    rope_retire(node);
+  }
+}
+
+void rope_publish(RopeShared *shared, RopeNode *root)
+{
+  if (root != NULL) rope_ref(root);
+  rope_deref(atomic_exchange_explicit(&shared->root, root, memory_order_acq_rel));
+}
+
+RopeNode *rope_acquire(RopeShared *shared)
+{
+  // claim a hazard pointer the first time this thread reads
+  for (int i = 0; hazard < 0 && i < ROPE_MAX_READERS; i++) {
+    bool expected = false;
+    if (atomic_compare_exchange_strong(&claimed[i], &expected, true)) hazard = i;
+  }
+  if (hazard < 0) {
+    SDL_SetError("Too many threads are reading ropes");
+    return NULL;
+  }
+
+  // protect the root, and only take a reference once it is known to have
+  // still been published after it was protected, so that rope_reclaim() will
+  // see the hazard pointer before freeing it
+  RopeNode *root = atomic_load(&shared->root);
+  while (root != NULL) {
+    atomic_store(&hazards[hazard], root);
+    if (atomic_load(&shared->root) == root && rope_ref_live(root)) {
+      // the root may have been replaced before the reference was taken,
+      // leaving the editing thread free to edit it in place, so keep it only
+      // if it is still published now that it is shared
+      if (atomic_load(&shared->root) == root) break;
+      rope_deref(root);
+    }
+    root = atomic_load(&shared->root);
+  }
+  atomic_store_explicit(&hazards[hazard], NULL, memory_order_release);
+  if (root == NULL) SDL_SetError("No rope has been published");
+  return root;
+}
+
+// moves some retired nodes onto the stack of dead nodes, except for those
+// that a reader is taking a reference to, which are added to the kept list
+static RopeNode *rope_scan(RopeNode *kept)
+{
+  if (unscanned == NULL) {
+    unscanned = atomic_exchange_explicit(&retired, NULL, memory_order_acquire);
+  }
+  if (unscanned == NULL) return kept;
+
+  // find the protected roots only after taking the nodes, so that a root
+  // retired after this point is left for the next scan
+  RopeNode *protected[ROPE_MAX_READERS];
+  int count = 0;
+  for (int i = 0; i < ROPE_MAX_READERS; i++) {
+    RopeNode *root = atomic_load(&hazards[i]);
+    if (root != NULL) protected[count++] = root;
+  }
+
+  // check only a few nodes at a time, so that scanning a large rope is spread
+  // over calls to rope_reclaim() like freeing it is
+  for (int i = 0; i < ROPE_RECLAIM_CHECK && unscanned != NULL; i++) {
+    RopeNode *node = unscanned;
+    unscanned = node->retired;
+    bool keep = false;
+    for (int j = 0; j < count && !keep; j++) keep = protected[j] == node;
+    if (keep) {
+      node->retired = kept;
+      kept = node;
+    } else {
+      arrput(dead, node);
+    }
+  }
+  return kept;
+}
+
+// dereferences the child of a dead node, which is retired if it dies, since a
+// reader may be taking a reference to it
+static void rope_release(RopeNode *node)
+{
+  rope_deref(node);
+}
+
+#else
+
+// dereferences the child of a dead node, freeing it right away if it is a
+// leaf, or pushing it onto the dead nodes otherwise, so that no node is freed
+// recursively
+static void rope_release(RopeNode *node)
+{
+  if (node == NULL || --node->ref_count != 0) return;
+  if (node->height == 1) {
+    rope_free(node);
+  } else {
+    arrput(dead, node);
+  }
+}
+
+void rope_deref(RopeNode *node)
+{
+  rope_release(node);
+  long stop = freed + ROPE_FREE_BATCH;
+  while (freed < stop && arrlen(dead) > 0) rope_free(arrpop(dead));
+}
+
+void rope_publish(RopeShared *shared, RopeNode *root)
+{
+  if (root != NULL) rope_ref(root);
+  rope_deref(shared->root);
+  shared->root = root;
+}
+
+RopeNode *rope_acquire(RopeShared *shared)
+{
+  if (shared->root == NULL) {
+    SDL_SetError("No rope has been published");
+    return NULL;
+  }
+  rope_ref(shared->root);
+  return shared->root;
+}
+
+#endif // ROPE_ATOMIC
+
+#ifdef ROPE_UTF8
+
+// releases the reference a leaf held to a mapped file, unmapping the file
+// along with its last leaf
+static void rope_unmap(RopeMap *map)
+{
+  if (--map->ref_count > 0) return;
+  munmap((void*)map->data, map->size);
+  free(map);
+}
+
+#endif // ROPE_UTF8
+
+// frees a dead node, releasing its children
+static void rope_free(RopeNode *node)
+{
+#ifdef ROPE_BTREE
+  if (node->height > 1) {
+    for (int i = 0; i < node->count; i++) rope_release(node->children[i]);
+  }
+#else
+#ifdef ROPE_INTERN
+  if (node->left == NULL && node->right == NULL && hmget(interned, node->hash) == node) {
+    (void)hmdel(interned, node->hash);
+  }
+#endif
+#ifdef ROPE_UTF8
+  if (node->map != NULL) {
+    rope_unmap(node->map);
+  } else {
+    pool_free(node->value, node->summary.bytes);
+  }
+#else
+  pool_free(node->value, node->weight * sizeof(uint32_t));
+#endif
+  rope_release(node->left);
+  rope_release(node->right);
+#endif
+  pool_free(node, sizeof(RopeNode));
+  freed++;
+}
+
+bool rope_reclaim(uint64_t budget)
+{
+  uint64_t start = budget > 0 ? SDL_GetTicksNS() : 0;
+  bool done = true;
+#ifdef ROPE_ATOMIC
+  // nodes that a reader is taking a reference to, which are retired again
+  RopeNode *kept = NULL;
+#endif
+
+  for (long check = freed + ROPE_RECLAIM_CHECK;;) {
+#ifdef ROPE_ATOMIC
+    // freeing a node retires any of its children that die with it, so scan
+    // again whenever the dead nodes run out
+    if (arrlen(dead) == 0) {
+      if (unscanned == NULL && atomic_load(&retired) == NULL) break;
+      kept = rope_scan(kept);
+      continue;
+    }
+#else
+    if (arrlen(dead) == 0) break;
+#endif
+    rope_free(arrpop(dead));
+
+    // stop once the time is up, leaving the rest for the next call
+    if (budget > 0 && freed >= check) {
+      if (SDL_GetTicksNS() - start >= budget) {
+        done = arrlen(dead) == 0;
+        break;
+      }
+      check = freed + ROPE_RECLAIM_CHECK;
+    }
+  }
+
+#ifdef ROPE_ATOMIC
+  if (kept != NULL) done = false;
+  while (kept != NULL) {
+    RopeNode *next = kept->retired;
+    rope_retire(kept);
+    kept = next;
+  }
+  if (unscanned != NULL || atomic_load(&retired) != NULL) done = false;
+#endif
+  return done;
+}
+
+long rope_unique_bytes(RopeNode *root)
+{
+  long bytes = 0;
+  RopeNode **stack = NULL;
+  if (root->ref_count == 1) arrput(stack, root);
+  while (arrlen(stack) > 0) {
+    RopeNode *node = arrpop(stack);
+    bytes += sizeof(RopeNode);
+#ifdef ROPE_BTREE
+    if (node->height > 1) {
+      for (int i = 0; i < node->count; i++) {
+        if (node->children[i]->ref_count == 1) arrput(stack, node->children[i]);
+      }
+    }
+#else
+    if (node->left == NULL && node->right == NULL) {
+#ifdef ROPE_UTF8
+      if (node->map == NULL) bytes += node->summary.bytes;
+#else
+      bytes += node->weight * sizeof(uint32_t);
+#endif
+    }
+    if (node->left != NULL && node->left->ref_count == 1) arrput(stack, node->left);
+    if (node->right != NULL && node->right->ref_count == 1) arrput(stack, node->right);
+#endif
+  }
+  arrfree(stack);
+  return bytes;
+}
+
+RopeSummary rope_summary(RopeNode *root)
+{
+  return root->summary;
+}
+
+int rope_newlines(RopeNode *root)
+{
+  return root->summary.newlines;
+}
+
+int rope_line_start(RopeNode *root, int line)
+{
+  if (line < 0 || line > root->summary.newlines) {
+    SDL_SetError("Line is outside of the rope");
+    return -1;
+  }
+  return rope_seek(root, ROPE_NEWLINES, line);
+}
+
+int rope_line_at(RopeNode *root, int index)
+{
+  return rope_measure(root, ROPE_NEWLINES, index);
+}
+
+bool rope_equal(RopeNode *a, RopeNode *b)
+{
+  if (a == b) return true;
+  RopeSummary x = rope_summary(a);
+  RopeSummary y = rope_summary(b);
+  if (rope_length(a) != rope_length(b) || x.bytes != y.bytes || x.newlines != y.newlines) {
+    return false;
+  }
+#ifdef ROPE_INTERN
+  return a->hash == b->hash && a->scale == b->scale;
+#else
+  // compare as much text at a time as the chunks of both ropes hold
+  RopeIter p;
+  RopeIter q;
+  if (rope_length(a) == 0) return true;
+  rope_iter_init(&p, a, 0);
+  rope_iter_init(&q, b, 0);
+  int i = 0;
+  int j = 0;
+  while (true) {
+    if (i == p.len) {
+      if (!rope_iter_next(&p)) break;
+      i = 0;
+    }
+    if (j == q.len) {
+      if (!rope_iter_next(&q)) break;
+      j = 0;
+    }
+    int n = p.len - i < q.len - j ? p.len - i : q.len - j;
+    if (memcmp(p.chunk + i, q.chunk + j, n * sizeof(uint32_t)) != 0) return false;
+    i += n;
+    j += n;
+  }
+  return true;
+#endif
+}
+
+// Determines the most children that a node can have.
+#ifdef ROPE_BTREE
+#define ROPE_DIFF_CHILDREN ROPE_BRANCH
+#else
+#define ROPE_DIFF_CHILDREN 2
+#endif
+
+// A node reached by rope_diff(), keyed by its address in the map of the rope
+// it was reached in, along with where it was listed if it is shared.
+typedef struct RopeDiffNode {
+  RopeNode *key;
+  int value;
+  int index;
+} RopeDiffNode;
+
+// What rope_diff() has found out about a node.
+enum {
+  // the node has been reached but not yet taken off the heap, or it is a leaf
+  // that is not in the other rope
+  ROPE_DIFF_REACHED,
+  // the node is not in the other rope, so its children were reached instead
+  ROPE_DIFF_SPLIT,
+  // the node is in both ropes, so its text is the same in both
+  ROPE_DIFF_SHARED,
+};
+
+// A node on the heap of rope_diff(), in one rope or the other.
+typedef struct RopeDiffItem {
+  RopeNode *node;
+  int length;
+  bool old;
+} RopeDiffItem;
+
+// A range of a rope that rope_diff() found to be either shared or changed.
+typedef struct RopeDiffRange {
+  RopeNode *node;
+  int start;
+  int length;
+  bool shared;
+} RopeDiffRange;
+
+// stores the children of a node in order, returning how many there are, which
+// is 0 for a leaf
+static int rope_node_children(RopeNode *node, RopeNode **children)
+{
+#ifdef ROPE_BTREE
+  if (node->height == 1) return 0;
+  for (int i = 0; i < node->count; i++) children[i] = node->children[i];
+  return node->count;
+#else
+  int count = 0;
+  if (node->left != NULL) children[count++] = node->left;
+  if (node->right != NULL) children[count++] = node->right;
+  return count;
+#endif
+}
+
+// pushes a node onto the heap of rope_diff(), which keeps the longest node on
+// top, unless it has already been reached in its rope
+static void rope_diff_push(RopeDiffItem **heap, RopeDiffNode **map, RopeNode *node, bool old)
+{
+  if (hmgeti(*map, node) >= 0) return;
+  hmputs(*map, ((RopeDiffNode){node, ROPE_DIFF_REACHED, -1}));
+  RopeDiffItem item = {node, rope_length(node), old};
+  int i = (int)arrlen(*heap);
+  arrput(*heap, item);
+  while (i > 0 && (*heap)[(i - 1) / 2].length < item.length) {
+    (*heap)[i] = (*heap)[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  (*heap)[i] = item;
+}
+
+// pops the longest node off the heap of rope_diff()
+static RopeDiffItem rope_diff_pop(RopeDiffItem *heap)
+{
+  RopeDiffItem top = heap[0];
+  RopeDiffItem last = arrpop(heap);
+  int count = (int)arrlen(heap);
+  int i = 0;
+  for (int child = 1; child < count; child = 2 * i + 1) {
+    if (child + 1 < count && heap[child + 1].length > heap[child].length) child++;
+    if (heap[child].length <= last.length) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  if (count > 0) heap[i] = last;
+  return top;
+}
+
+// lists the ranges of a rope in order, descending into the nodes that were
+// split and numbering the shared nodes in the map by where they are listed
+static RopeDiffRange *rope_diff_ranges(RopeNode *root, RopeDiffNode *map)
+{
+  RopeDiffRange *ranges = NULL;
+  RopeNode **stack = NULL;
+  RopeNode *children[ROPE_DIFF_CHILDREN];
+  int start = 0;
+  arrput(stack, root);
+  while (arrlen(stack) > 0) {
+    RopeNode *node = arrpop(stack);
+    RopeDiffNode *entry = hmgetp(map, node);
+    if (entry->value == ROPE_DIFF_SPLIT) {
+      for (int i = rope_node_children(node, children) - 1; i >= 0; i--) arrput(stack, children[i]);
+      continue;
+    }
+    int length = rope_length(node);
+    if (length == 0) continue;
+    bool shared = entry->value == ROPE_DIFF_SHARED;
+    if (shared) entry->index = (int)arrlen(ranges);
+    arrput(ranges, ((RopeDiffRange){node, start, length, shared}));
+    start += length;
+  }
+  arrfree(stack);
+  return ranges;
+}
+
+// returns how many codepoints two ropes have in common from the given indices
+// onwards, or up to them if back is set, counting no more than max
+static int rope_diff_common(RopeNode *a, int i, RopeNode *b, int j, int max, bool back)
+{
+  RopeIter x;
+  RopeIter y;
+  int common = 0;
+  rope_iter_init(&x, a, i);
+  rope_iter_init(&y, b, j);
+  if (back && (!rope_iter_prev(&x) || !rope_iter_prev(&y))) return 0;
+  int at_x = back ? i - x.start : 0;
+  int at_y = back ? j - y.start : 0;
+  while (common < max) {
+    // step to the next chunk of whichever iterator ran out
+    if (back ? at_x == 0 : at_x == x.len) {
+      if (!(back ? rope_iter_prev(&x) : rope_iter_next(&x))) break;
+      at_x = back ? x.len : 0;
+    }
+    if (back ? at_y == 0 : at_y == y.len) {
+      if (!(back ? rope_iter_prev(&y) : rope_iter_next(&y))) break;
+      at_y = back ? y.len : 0;
+    }
+    uint32_t c = back ? x.chunk[at_x - 1] : x.chunk[at_x];
+    uint32_t d = back ? y.chunk[at_y - 1] : y.chunk[at_y];
+    if (c != d) break;
+    at_x += back ? -1 : 1;
+    at_y += back ? -1 : 1;
+    common++;
+  }
+  return common;
+}
+
+// appends a change, leaving out the text at either end that did not change
+static void rope_diff_change(RopeChange **changes, RopeNode *old_root, RopeNode *new_root,
+                             RopeChange change)
+{
+  int max = change.old_len < change.new_len ? change.old_len : change.new_len;
+  int head = rope_diff_common(old_root, change.old_start, new_root, change.new_start, max, false);
+  int tail = rope_diff_common(old_root, change.old_start + change.old_len, new_root,
+                              change.new_start + change.new_len, max - head, true);
+  change.old_start += head;
+  change.new_start += head;
+  change.old_len -= head + tail;
+  change.new_len -= head + tail;
+  if (change.old_len > 0 || change.new_len > 0) arrput(*changes, change);
+}
+
+// returns whether the walk of rope_diff() should pass over a range of the old
+// rope rather than one of the new rope, when they cannot be matched up. When
+// both are shared nodes that were moved, the one whose match is closer is kept
+// so that the text between is all that is reported as changed.
+static bool rope_diff_skip_old(RopeDiffRange *a, RopeDiffRange *b, RopeDiffNode **maps, int i,
+                               int j)
+{
+  if (!a->shared) return true;
+  if (!b->shared) return false;
+  int ahead_a = hmgetp(maps[0], a->node)->index - j;
+  int ahead_b = hmgetp(maps[1], b->node)->index - i;
+  if (ahead_a < 0) return true;
+  if (ahead_b < 0) return false;
+  return ahead_b <= ahead_a;
+}
+
+int rope_diff(RopeNode *old_root, RopeNode *new_root, RopeChange **changes)
+{
+  int count = (int)arrlen(*changes);
+  if (old_root == new_root) return 0;
+
+  // take the longest node reached in either rope, which is shared if it has
+  // been reached in the other too, and split it otherwise. A node that is in
+  // both ropes has the same length in both, and every node longer than it has
+  // been split by the time it is taken, so it has always been reached in both.
+  RopeDiffNode *maps[2] = {NULL, NULL};
+  RopeDiffItem *heap = NULL;
+  RopeNode *children[ROPE_DIFF_CHILDREN];
+  rope_diff_push(&heap, &maps[1], old_root, true);
+  rope_diff_push(&heap, &maps[0], new_root, false);
+  while (arrlen(heap) > 0) {
+    RopeDiffItem item = rope_diff_pop(heap);
+    RopeDiffNode *own = hmgetp(maps[item.old], item.node);
+    RopeDiffNode *other = hmgetp_null(maps[!item.old], item.node);
+    if (other != NULL && other->value != ROPE_DIFF_SPLIT) {
+      own->value = ROPE_DIFF_SHARED;
+      other->value = ROPE_DIFF_SHARED;
+      continue;
+    }
+    int n = rope_node_children(item.node, children);
+    if (n == 0) continue;
+    own->value = ROPE_DIFF_SPLIT;
+    for (int i = 0; i < n; i++) rope_diff_push(&heap, &maps[item.old], children[i], item.old);
+  }
+  arrfree(heap);
+
+  // walk the ranges of both ropes in order, matching up their shared nodes
+  RopeDiffRange *old_ranges = rope_diff_ranges(old_root, maps[1]);
+  RopeDiffRange *new_ranges = rope_diff_ranges(new_root, maps[0]);
+  RopeChange change = {0};
+  int i = 0;
+  int j = 0;
+  while (i < arrlen(old_ranges) || j < arrlen(new_ranges)) {
+    RopeDiffRange *a = i < arrlen(old_ranges) ? &old_ranges[i] : NULL;
+    RopeDiffRange *b = j < arrlen(new_ranges) ? &new_ranges[j] : NULL;
+    if (a != NULL && b != NULL && a->shared && b->shared && a->node == b->node) {
+      if (change.old_len > 0 || change.new_len > 0) {
+        rope_diff_change(changes, old_root, new_root, change);
+      }
+      change = (RopeChange){a->start + a->length, 0, b->start + b->length, 0};
+      i++;
+      j++;
+    } else if (b == NULL || (a != NULL && rope_diff_skip_old(a, b, maps, i, j))) {
+      change.old_len += a->length;
+      i++;
+    } else {
+      change.new_len += b->length;
+      j++;
+    }
+  }
+  if (change.old_len > 0 || change.new_len > 0) {
+    rope_diff_change(changes, old_root, new_root, change);
+  }
+  arrfree(old_ranges);
+  arrfree(new_ranges);
+  hmfree(maps[0]);
+  hmfree(maps[1]);
+  return (int)arrlen(*changes) - count;
+}
@@ -0,0 +1,1121 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_error.h>
+#include <SDL3/SDL_intrin.h>
+
+#include "pool.h"
+#include "rope.h"
+#include "stb_ds.h"
+
+// Determines the shortest text that vectors are used for, since checking
+// which instruction sets the CPU has costs more than scanning a few characters.
+#define ROPE_VECTOR_MIN 64
+
+// The widest instruction set that the kernels may use, set by rope_kernels().
+static RopeKernels kernels_limit = ROPE_KERNELS_AVX2;
+
+// The state of a search for a needle in the units that leaves store text in,
+// with the Horspool shift for each value of the low byte of a unit, both
+// forwards and backwards. The window holds the text around the boundary
+// between chunks, and is followed by the needle as UTF-8 if ROPE_UTF8 is
+// defined.
+typedef struct RopeSearch {
+  const ROPE_UNIT *needle;
+  int len;
+  RopeKernels kernel;
+  int skip[256];
+  int skip_back[256];
+  ROPE_UNIT *window;
+} RopeSearch;
+
+// returns the widest instruction set to scan text of the given length with
+static RopeKernels rope_kernel(int length)
+{
+  if (length < ROPE_VECTOR_MIN) return ROPE_KERNELS_SCALAR;
+#ifdef SDL_AVX2_INTRINSICS
+  if (kernels_limit >= ROPE_KERNELS_AVX2 && SDL_HasAVX2()) return ROPE_KERNELS_AVX2;
+#endif
+#ifdef SDL_SSE2_INTRINSICS
+  if (kernels_limit >= ROPE_KERNELS_SSE2 && SDL_HasSSE2()) return ROPE_KERNELS_SSE2;
+#endif
+  return ROPE_KERNELS_SCALAR;
+}
+
+RopeKernels rope_kernels(RopeKernels limit)
+{
+  kernels_limit = limit;
+  return rope_kernel(ROPE_VECTOR_MIN);
+}
+
+// adds the metrics of codepoints to a summary one at a time
+static void rope_summarize_scalar(const uint32_t *text, int length, RopeSummary *summary)
+{
+  for (int i = 0; i < length; i++) {
+    uint32_t c = text[i];
+    summary->bytes += c < 0x80 ? 1 : c < 0x800 ? 2 : c < 0x10000 ? 3 : 4;
+    summary->newlines += c == '\n';
+    summary->utf16 += c < 0x10000 ? 1 : 2;
+  }
+}
+
+// adds the metrics of UTF-8 bytes to a summary one at a time, returning the
+// number of codepoints they start
+static int rope_summarize_utf8_scalar(const uint8_t *text, int bytes, RopeSummary *summary)
+{
+  int length = 0;
+  for (int i = 0; i < bytes; i++) {
+    uint8_t b = text[i];
+    length += (b & 0xc0) != 0x80;
+    summary->newlines += b == '\n';
+    summary->utf16 += b >= 0xf0;
+  }
+  summary->bytes += bytes;
+  summary->utf16 += length;
+  return length;
+}
+
+// encodes a codepoint as UTF-8, returning the number of bytes written
+static int rope_encode_char(uint32_t c, uint8_t *dst)
+{
+  if (c < 0x80) {
+    dst[0] = (uint8_t)c;
+    return 1;
+  }
+  if (c < 0x800) {
+    dst[0] = (uint8_t)(0xc0 | c >> 6);
+    dst[1] = (uint8_t)(0x80 | (c & 0x3f));
+    return 2;
+  }
+  if ((c >= 0xd800 && c < 0xe000) || c > 0x10ffff) c = 0xfffd;
+  if (c < 0x10000) {
+    dst[0] = (uint8_t)(0xe0 | c >> 12);
+    dst[1] = (uint8_t)(0x80 | (c >> 6 & 0x3f));
+    dst[2] = (uint8_t)(0x80 | (c & 0x3f));
+    return 3;
+  }
+  dst[0] = (uint8_t)(0xf0 | c >> 18);
+  dst[1] = (uint8_t)(0x80 | (c >> 12 & 0x3f));
+  dst[2] = (uint8_t)(0x80 | (c >> 6 & 0x3f));
+  dst[3] = (uint8_t)(0x80 | (c & 0x3f));
+  return 4;
+}
+
+// decodes the codepoint at the start of some UTF-8 text, storing the number of
+// bytes it takes up in units. Overlong sequences, surrogates, codepoints above
+// U+10FFFF and sequences cut short decode to U+FFFD, taking up a single byte.
+static uint32_t rope_decode_char(const uint8_t *src, int bytes, int *units)
+{
+  uint32_t c = src[0];
+  int count = c < 0x80 ? 1 : c < 0xc2 ? 0 : c < 0xe0 ? 2 : c < 0xf0 ? 3 : c < 0xf5 ? 4 : 0;
+  *units = 1;
+  if (count == 1) return c;
+  if (count == 0 || count > bytes) return 0xfffd;
+  c &= 0x7f >> count;
+  for (int i = 1; i < count; i++) {
+    if ((src[i] & 0xc0) != 0x80) return 0xfffd;
+    c = c << 6 | (src[i] & 0x3f);
+  }
+  if ((count == 3 && c < 0x800) || (count == 4 && c < 0x10000) ||
+      (c >= 0xd800 && c < 0xe000) || c > 0x10ffff) {
+    return 0xfffd;
+  }
+  *units = count;
+  return c;
+}
+
+// returns the first position at which the needle occurs in the text, or -1,
+// shifting the needle along by the last unit under it
+static int rope_search_scalar(const RopeSearch *search, const ROPE_UNIT *text, int n)
+{
+  int len = search->len;
+  ROPE_UNIT last = search->needle[len - 1];
+  for (int i = 0; i + len <= n;) {
+    ROPE_UNIT c = text[i + len - 1];
+    if (c == last && memcmp(text + i, search->needle, (len - 1) * sizeof(ROPE_UNIT)) == 0) {
+      return i;
+    }
+    i += search->skip[c & 0xff];
+  }
+  return -1;
+}
+
+// returns the last position at which the needle occurs in the text, or -1,
+// shifting the needle back by the first unit under it
+static int rope_search_back_scalar(const RopeSearch *search, const ROPE_UNIT *text, int n)
+{
+  int len = search->len;
+  ROPE_UNIT first = search->needle[0];
+  for (int i = n - len; i >= 0;) {
+    ROPE_UNIT c = text[i];
+    if (c == first &&
+        memcmp(text + i + 1, search->needle + 1, (len - 1) * sizeof(ROPE_UNIT)) == 0) {
+      return i;
+    }
+    i -= search->skip_back[c & 0xff];
+  }
+  return -1;
+}
+
+#if defined(SDL_SSE2_INTRINSICS) || defined(SDL_AVX2_INTRINSICS)
+
+// returns the number of trailing zero bits of a nonzero mask
+static int rope_trailing_zeros(uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctz(mask);
+#else
+  int count = 0;
+  for (; (mask & 1) == 0; mask >>= 1) count++;
+  return count;
+#endif
+}
+
+// returns the index of the highest set bit of a nonzero mask
+static int rope_highest_bit(uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return 31 - __builtin_clz(mask);
+#else
+  int index = 31;
+  for (; (mask & 0x80000000u) == 0; mask <<= 1) index--;
+  return index;
+#endif
+}
+
+// returns whether the needle occurs at a position whose first and last units
+// are already known to match
+static bool rope_search_rest(const RopeSearch *search, const ROPE_UNIT *text)
+{
+  return search->len <= 2 ||
+         memcmp(text + 1, search->needle + 1, (search->len - 2) * sizeof(ROPE_UNIT)) == 0;
+}
+
+#endif
+
+#ifdef SDL_SSE2_INTRINSICS
+
+// returns the sum of the lanes of a vector of 32-bit integers
+static int rope_sum_sse2(__m128i v)
+{
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4e));
+  v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+  return _mm_cvtsi128_si32(v);
+}
+
+// adds the metrics of codepoints to a summary 4 at a time, returning the
+// number of codepoints scanned. Codepoints are flipped by their top bit so
+// that signed comparisons order them as unsigned. Each comparison is -1 in
+// the lanes where it holds, so the counts are kept as negatives.
+static int rope_summarize_sse2(const uint32_t *text, int length, RopeSummary *summary)
+{
+  __m128i sign = _mm_set1_epi32(INT32_MIN);
+  __m128i two = _mm_set1_epi32(INT32_MIN + 0x7f);
+  __m128i three = _mm_set1_epi32(INT32_MIN + 0x7ff);
+  __m128i four = _mm_set1_epi32(INT32_MIN + 0xffff);
+  __m128i newline = _mm_set1_epi32('\n');
+  __m128i wide = _mm_setzero_si128();
+  __m128i wider = _mm_setzero_si128();
+  __m128i pairs = _mm_setzero_si128();
+  __m128i lines = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 4 <= length; i += 4) {
+    __m128i c = _mm_loadu_si128((const __m128i*)(text + i));
+    __m128i biased = _mm_xor_si128(c, sign);
+    wide = _mm_add_epi32(wide, _mm_cmpgt_epi32(biased, two));
+    wider = _mm_add_epi32(wider, _mm_cmpgt_epi32(biased, three));
+    pairs = _mm_add_epi32(pairs, _mm_cmpgt_epi32(biased, four));
+    lines = _mm_add_epi32(lines, _mm_cmpeq_epi32(c, newline));
+  }
+  int astral = -rope_sum_sse2(pairs);
+  summary->bytes += i - rope_sum_sse2(wide) - rope_sum_sse2(wider) + astral;
+  summary->newlines -= rope_sum_sse2(lines);
+  summary->utf16 += i + astral;
+  return i;
+}
+
+// returns the sum of the bytes of a vector of byte counts
+static int rope_sum_bytes_sse2(__m128i v)
+{
+  v = _mm_sad_epu8(v, _mm_setzero_si128());
+  return _mm_cvtsi128_si32(v) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(v, v));
+}
+
+// adds the metrics of UTF-8 bytes to a summary 16 at a time, returning the
+// number of bytes scanned and storing the number of codepoints they start in
+// length. The counts are kept in bytes, which are added up before they can
+// overflow.
+static int rope_summarize_utf8_sse2(const uint8_t *text, int bytes, RopeSummary *summary,
+                                    int *length)
+{
+  __m128i continuation = _mm_set1_epi8(-65);
+  __m128i newline = _mm_set1_epi8('\n');
+  __m128i four = _mm_set1_epi8((char)0xf0);
+  int i = 0;
+  while (i + 16 <= bytes) {
+    __m128i leads = _mm_setzero_si128();
+    __m128i lines = _mm_setzero_si128();
+    __m128i pairs = _mm_setzero_si128();
+    for (int run = 0; run < 255 && i + 16 <= bytes; run++, i += 16) {
+      __m128i b = _mm_loadu_si128((const __m128i*)(text + i));
+      leads = _mm_sub_epi8(leads, _mm_cmpgt_epi8(b, continuation));
+      lines = _mm_sub_epi8(lines, _mm_cmpeq_epi8(b, newline));
+      pairs = _mm_sub_epi8(pairs, _mm_cmpeq_epi8(_mm_max_epu8(b, four), b));
+    }
+    int count = rope_sum_bytes_sse2(leads);
+    *length += count;
+    summary->newlines += rope_sum_bytes_sse2(lines);
+    summary->utf16 += count + rope_sum_bytes_sse2(pairs);
+  }
+  summary->bytes += i;
+  return i;
+}
+
+// encodes codepoints 16 at a time by packing them into bytes, keeping as
+// many as are ASCII before encoding the rest of a run of other characters one
+// at a time. Returns the number of codepoints encoded and stores the number of
+// bytes written in end.
+static int rope_encode_sse2(const uint32_t *text, int length, uint8_t *dst, int *end)
+{
+  __m128i high = _mm_set1_epi32(~0x7f);
+  __m128i zero = _mm_setzero_si128();
+  int out = 0;
+  int i = 0;
+  while (i + 16 <= length) {
+    const __m128i *src = (const __m128i*)(text + i);
+    __m128i a = _mm_loadu_si128(src);
+    __m128i b = _mm_loadu_si128(src + 1);
+    __m128i c = _mm_loadu_si128(src + 2);
+    __m128i d = _mm_loadu_si128(src + 3);
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+    _mm_storeu_si128((__m128i*)(dst + out), packed);
+
+    // pack the lanes that are ASCII into a mask in the same way
+    __m128i ab = _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(a, high), zero),
+                                 _mm_cmpeq_epi32(_mm_and_si128(b, high), zero));
+    __m128i cd = _mm_packs_epi32(_mm_cmpeq_epi32(_mm_and_si128(c, high), zero),
+                                 _mm_cmpeq_epi32(_mm_and_si128(d, high), zero));
+    int other = ~_mm_movemask_epi8(_mm_packs_epi16(ab, cd)) & 0xffff;
+    int ascii = other == 0 ? 16 : rope_trailing_zeros(other);
+    out += ascii;
+    i += ascii;
+    while (ascii < 16 && i < length && text[i] >= 0x80) {
+      out += rope_encode_char(text[i++], dst + out);
+    }
+  }
+  *end = out;
+  return i;
+}
+
+// decodes UTF-8 16 bytes at a time by widening them into codepoints, keeping
+// as many as are ASCII before decoding the rest of a run of other characters
+// one at a time. Every codepoint of a vector is written, so this stops while
+// the array still has room for all of them. Returns the number of bytes
+// decoded and stores the number of codepoints written in end.
+static int rope_decode_sse2(const uint8_t *text, int bytes, uint32_t *dst, int capacity,
+                            int *end)
+{
+  __m128i zero = _mm_setzero_si128();
+  int out = 0;
+  int i = 0;
+  while (i + 16 <= bytes && out + 16 <= capacity) {
+    __m128i b = _mm_loadu_si128((const __m128i*)(text + i));
+    __m128i low = _mm_unpacklo_epi8(b, zero);
+    __m128i high = _mm_unpackhi_epi8(b, zero);
+    __m128i *codepoints = (__m128i*)(dst + out);
+    _mm_storeu_si128(codepoints, _mm_unpacklo_epi16(low, zero));
+    _mm_storeu_si128(codepoints + 1, _mm_unpackhi_epi16(low, zero));
+    _mm_storeu_si128(codepoints + 2, _mm_unpacklo_epi16(high, zero));
+    _mm_storeu_si128(codepoints + 3, _mm_unpackhi_epi16(high, zero));
+
+    int other = _mm_movemask_epi8(b);
+    int ascii = other == 0 ? 16 : rope_trailing_zeros(other);
+    out += ascii;
+    i += ascii;
+    while (ascii < 16 && i < bytes && out < capacity && text[i] >= 0x80) {
+      int units;
+      dst[out++] = rope_decode_char(text + i, bytes - i, &units);
+      i += units;
+    }
+  }
+  *end = out;
+  return i;
+}
+
+// the number of units of text in an SSE2 vector
+#define ROPE_LANES_SSE2 (16 / (int)sizeof(ROPE_UNIT))
+
+// returns a mask with a bit set for each unit of a vector that equals a unit
+static uint32_t rope_equal_sse2(__m128i v, ROPE_UNIT c)
+{
+#ifdef ROPE_UTF8
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8((char)c)));
+#else
+  return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, _mm_set1_epi32((int)c))));
+#endif
+}
+
+// returns the first position at which the needle occurs in the text, or -1,
+// comparing the first and last units of the needle at a vector of positions at
+// once and only comparing the rest where both match
+static int rope_search_sse2(const RopeSearch *search, const ROPE_UNIT *text, int n)
+{
+  int len = search->len;
+  int i = 0;
+  for (; i + len - 1 + ROPE_LANES_SSE2 <= n; i += ROPE_LANES_SSE2) {
+    uint32_t mask =
+      rope_equal_sse2(_mm_loadu_si128((const __m128i*)(text + i)), search->needle[0]) &
+      rope_equal_sse2(_mm_loadu_si128((const __m128i*)(text + i + len - 1)),
+                      search->needle[len - 1]);
+    for (; mask != 0; mask &= mask - 1) {
+      int j = rope_trailing_zeros(mask);
+      if (rope_search_rest(search, text + i + j)) return i + j;
+    }
+  }
+  int found = rope_search_scalar(search, text + i, n - i);
+  return found < 0 ? -1 : i + found;
+}
+
+// returns the last position at which the needle occurs in the text, or -1, in
+// the same way as rope_search_sse2()
+static int rope_search_back_sse2(const RopeSearch *search, const ROPE_UNIT *text, int n)
+{
+  int len = search->len;
+  int i = n - len - (ROPE_LANES_SSE2 - 1);
+  for (; i >= 0; i -= ROPE_LANES_SSE2) {
+    uint32_t mask =
+      rope_equal_sse2(_mm_loadu_si128((const __m128i*)(text + i)), search->needle[0]) &
+      rope_equal_sse2(_mm_loadu_si128((const __m128i*)(text + i + len - 1)),
+                      search->needle[len - 1]);
+    while (mask != 0) {
+      int j = rope_highest_bit(mask);
+      if (rope_search_rest(search, text + i + j)) return i + j;
+      mask &= ~(1u << j);
+    }
+  }
+  return rope_search_back_scalar(search, text, i + (ROPE_LANES_SSE2 - 1) + len);
+}
+
+#endif // SDL_SSE2_INTRINSICS
+
+#ifdef SDL_AVX2_INTRINSICS
+
+// returns the sum of the lanes of a vector of 32-bit integers
+SDL_TARGETING("avx2") static int rope_sum_avx2(__m256i v)
+{
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+  return _mm_cvtsi128_si32(half);
+}
+
+// adds the metrics of codepoints to a summary 8 at a time, in the same way as
+// rope_summarize_sse2()
+SDL_TARGETING("avx2") static int rope_summarize_avx2(const uint32_t *text, int length,
+                                                     RopeSummary *summary)
+{
+  __m256i sign = _mm256_set1_epi32(INT32_MIN);
+  __m256i two = _mm256_set1_epi32(INT32_MIN + 0x7f);
+  __m256i three = _mm256_set1_epi32(INT32_MIN + 0x7ff);
+  __m256i four = _mm256_set1_epi32(INT32_MIN + 0xffff);
+  __m256i newline = _mm256_set1_epi32('\n');
+  __m256i wide = _mm256_setzero_si256();
+  __m256i wider = _mm256_setzero_si256();
+  __m256i pairs = _mm256_setzero_si256();
+  __m256i lines = _mm256_setzero_si256();
+  int i = 0;
+  for (; i + 8 <= length; i += 8) {
+    __m256i c = _mm256_loadu_si256((const __m256i*)(text + i));
+    __m256i biased = _mm256_xor_si256(c, sign);
+    wide = _mm256_add_epi32(wide, _mm256_cmpgt_epi32(biased, two));
+    wider = _mm256_add_epi32(wider, _mm256_cmpgt_epi32(biased, three));
+    pairs = _mm256_add_epi32(pairs, _mm256_cmpgt_epi32(biased, four));
+    lines = _mm256_add_epi32(lines, _mm256_cmpeq_epi32(c, newline));
+  }
+  int astral = -rope_sum_avx2(pairs);
+  summary->bytes += i - rope_sum_avx2(wide) - rope_sum_avx2(wider) + astral;
+  summary->newlines -= rope_sum_avx2(lines);
+  summary->utf16 += i + astral;
+  return i;
+}
+
+// returns the sum of the bytes of a vector of byte counts
+SDL_TARGETING("avx2") static int rope_sum_bytes_avx2(__m256i v)
+{
+  v = _mm256_sad_epu8(v, _mm256_setzero_si256());
+  return rope_sum_avx2(v);
+}
+
+// adds the metrics of UTF-8 bytes to a summary 32 at a time, in the same way
+// as rope_summarize_utf8_sse2()
+SDL_TARGETING("avx2") static int rope_summarize_utf8_avx2(const uint8_t *text, int bytes,
+                                                          RopeSummary *summary, int *length)
+{
+  __m256i continuation = _mm256_set1_epi8(-65);
+  __m256i newline = _mm256_set1_epi8('\n');
+  __m256i four = _mm256_set1_epi8((char)0xf0);
+  int i = 0;
+  while (i + 32 <= bytes) {
+    __m256i leads = _mm256_setzero_si256();
+    __m256i lines = _mm256_setzero_si256();
+    __m256i pairs = _mm256_setzero_si256();
+    for (int run = 0; run < 255 && i + 32 <= bytes; run++, i += 32) {
+      __m256i b = _mm256_loadu_si256((const __m256i*)(text + i));
+      leads = _mm256_sub_epi8(leads, _mm256_cmpgt_epi8(b, continuation));
+      lines = _mm256_sub_epi8(lines, _mm256_cmpeq_epi8(b, newline));
+      pairs = _mm256_sub_epi8(pairs, _mm256_cmpeq_epi8(_mm256_max_epu8(b, four), b));
+    }
+    int count = rope_sum_bytes_avx2(leads);
+    *length += count;
+    summary->newlines += rope_sum_bytes_avx2(lines);
+    summary->utf16 += count + rope_sum_bytes_avx2(pairs);
+  }
+  summary->bytes += i;
+  return i;
+}
+
+// encodes codepoints 32 at a time, in the same way as rope_encode_sse2()
+SDL_TARGETING("avx2") static int rope_encode_avx2(const uint32_t *text, int length,
+                                                  uint8_t *dst, int *end)
+{
+  __m256i high = _mm256_set1_epi32(~0x7f);
+  __m256i zero = _mm256_setzero_si256();
+  // packing works within each half of a vector, so the dwords of the packed
+  // bytes come out as the low and high halves of each input in turn
+  __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  int out = 0;
+  int i = 0;
+  while (i + 32 <= length) {
+    const __m256i *src = (const __m256i*)(text + i);
+    __m256i a = _mm256_loadu_si256(src);
+    __m256i b = _mm256_loadu_si256(src + 1);
+    __m256i c = _mm256_loadu_si256(src + 2);
+    __m256i d = _mm256_loadu_si256(src + 3);
+    __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+    _mm256_storeu_si256((__m256i*)(dst + out), _mm256_permutevar8x32_epi32(packed, order));
+
+    __m256i ab = _mm256_packs_epi32(_mm256_cmpeq_epi32(_mm256_and_si256(a, high), zero),
+                                    _mm256_cmpeq_epi32(_mm256_and_si256(b, high), zero));
+    __m256i cd = _mm256_packs_epi32(_mm256_cmpeq_epi32(_mm256_and_si256(c, high), zero),
+                                    _mm256_cmpeq_epi32(_mm256_and_si256(d, high), zero));
+    __m256i mask = _mm256_permutevar8x32_epi32(_mm256_packs_epi16(ab, cd), order);
+    uint32_t other = ~(uint32_t)_mm256_movemask_epi8(mask);
+    int ascii = other == 0 ? 32 : rope_trailing_zeros(other);
+    out += ascii;
+    i += ascii;
+    while (ascii < 32 && i < length && text[i] >= 0x80) {
+      out += rope_encode_char(text[i++], dst + out);
+    }
+  }
+  *end = out;
+  return i;
+}
+
+// decodes UTF-8 32 bytes at a time, in the same way as rope_decode_sse2()
+SDL_TARGETING("avx2") static int rope_decode_avx2(const uint8_t *text, int bytes,
+                                                  uint32_t *dst, int capacity, int *end)
+{
+  int out = 0;
+  int i = 0;
+  while (i + 32 <= bytes && out + 32 <= capacity) {
+    __m256i *codepoints = (__m256i*)(dst + out);
+    for (int j = 0; j < 4; j++) {
+      __m128i eight = _mm_loadl_epi64((const __m128i*)(text + i + j * 8));
+      _mm256_storeu_si256(codepoints + j, _mm256_cvtepu8_epi32(eight));
+    }
+
+    uint32_t other = (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)(text + i)));
+    int ascii = other == 0 ? 32 : rope_trailing_zeros(other);
+    out += ascii;
+    i += ascii;
+    while (ascii < 32 && i < bytes && out < capacity && text[i] >= 0x80) {
+      int units;
+      dst[out++] = rope_decode_char(text + i, bytes - i, &units);
+      i += units;
+    }
+  }
+  *end = out;
+  return i;
+}
+
+// the number of units of text in an AVX2 vector
+#define ROPE_LANES_AVX2 (32 / (int)sizeof(ROPE_UNIT))
+
+// returns a mask with a bit set for each unit of a vector that equals a unit
+SDL_TARGETING("avx2") static uint32_t rope_equal_avx2(__m256i v, ROPE_UNIT c)
+{
+#ifdef ROPE_UTF8
+  return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8((char)c)));
+#else
+  return (uint32_t)_mm256_movemask_ps(
+    _mm256_castsi256_ps(_mm256_cmpeq_epi32(v, _mm256_set1_epi32((int)c))));
+#endif
+}
+
+// returns the first position at which the needle occurs in the text, or -1, in
+// the same way as rope_search_sse2() but with vectors twice as wide
+SDL_TARGETING("avx2") static int rope_search_avx2(const RopeSearch *search,
+                                                  const ROPE_UNIT *text, int n)
+{
+  int len = search->len;
+  int i = 0;
+  for (; i + len - 1 + ROPE_LANES_AVX2 <= n; i += ROPE_LANES_AVX2) {
+    uint32_t mask =
+      rope_equal_avx2(_mm256_loadu_si256((const __m256i*)(text + i)), search->needle[0]) &
+      rope_equal_avx2(_mm256_loadu_si256((const __m256i*)(text + i + len - 1)),
+                      search->needle[len - 1]);
+    for (; mask != 0; mask &= mask - 1) {
+      int j = rope_trailing_zeros(mask);
+      if (rope_search_rest(search, text + i + j)) return i + j;
+    }
+  }
+  int found = rope_search_scalar(search, text + i, n - i);
+  return found < 0 ? -1 : i + found;
+}
+
+// returns the last position at which the needle occurs in the text, or -1, in
+// the same way as rope_search_back_sse2() but with vectors twice as wide
+SDL_TARGETING("avx2") static int rope_search_back_avx2(const RopeSearch *search,
+                                                       const ROPE_UNIT *text, int n)
+{
+  int len = search->len;
+  int i = n - len - (ROPE_LANES_AVX2 - 1);
+  for (; i >= 0; i -= ROPE_LANES_AVX2) {
+    uint32_t mask =
+      rope_equal_avx2(_mm256_loadu_si256((const __m256i*)(text + i)), search->needle[0]) &
+      rope_equal_avx2(_mm256_loadu_si256((const __m256i*)(text + i + len - 1)),
+                      search->needle[len - 1]);
+    while (mask != 0) {
+      int j = rope_highest_bit(mask);
+      if (rope_search_rest(search, text + i + j)) return i + j;
+      mask &= ~(1u << j);
+    }
+  }
+  return rope_search_back_scalar(search, text, i + (ROPE_LANES_AVX2 - 1) + len);
+}
+
+#endif // SDL_AVX2_INTRINSICS
+
+RopeSummary rope_summarize(const uint32_t *text, int length)
+{
+  RopeSummary summary = {0};
+  int done = 0;
+  switch (rope_kernel(length)) {
+#ifdef SDL_AVX2_INTRINSICS
+  case ROPE_KERNELS_AVX2:
+    done = rope_summarize_avx2(text, length, &summary);
+    break;
+#endif
+#ifdef SDL_SSE2_INTRINSICS
+  case ROPE_KERNELS_SSE2:
+    done = rope_summarize_sse2(text, length, &summary);
+    break;
+#endif
+  default:
+    break;
+  }
+  rope_summarize_scalar(text + done, length - done, &summary);
+  return summary;
+}
+
+RopeSummary rope_summarize_utf8(const char *text, int bytes, int *length)
+{
+  const uint8_t *src = (const uint8_t*)text;
+  RopeSummary summary = {0};
+  int count = 0;
+  int done = 0;
+  switch (rope_kernel(bytes)) {
+#ifdef SDL_AVX2_INTRINSICS
+  case ROPE_KERNELS_AVX2:
+    done = rope_summarize_utf8_avx2(src, bytes, &summary, &count);
+    break;
+#endif
+#ifdef SDL_SSE2_INTRINSICS
+  case ROPE_KERNELS_SSE2:
+    done = rope_summarize_utf8_sse2(src, bytes, &summary, &count);
+    break;
+#endif
+  default:
+    break;
+  }
+  count += rope_summarize_utf8_scalar(src + done, bytes - done, &summary);
+  if (length != NULL) *length = count;
+  return summary;
+}
+
+int rope_encode_utf8(const uint32_t *text, int length, char *dst)
+{
+  uint8_t *out = (uint8_t*)dst;
+  int written = 0;
+  int done = 0;
+  switch (rope_kernel(length)) {
+#ifdef SDL_AVX2_INTRINSICS
+  case ROPE_KERNELS_AVX2:
+    done = rope_encode_avx2(text, length, out, &written);
+    break;
+#endif
+#ifdef SDL_SSE2_INTRINSICS
+  case ROPE_KERNELS_SSE2:
+    done = rope_encode_sse2(text, length, out, &written);
+    break;
+#endif
+  default:
+    break;
+  }
+  for (int i = done; i < length; i++) written += rope_encode_char(text[i], out + written);
+  return written;
+}
+
+int rope_decode_utf8(const char *text, int bytes, uint32_t *dst, int capacity)
+{
+  const uint8_t *src = (const uint8_t*)text;
+  int written = 0;
+  int done = 0;
+  switch (rope_kernel(bytes)) {
+#ifdef SDL_AVX2_INTRINSICS
+  case ROPE_KERNELS_AVX2:
+    done = rope_decode_avx2(src, bytes, dst, capacity, &written);
+    break;
+#endif
+#ifdef SDL_SSE2_INTRINSICS
+  case ROPE_KERNELS_SSE2:
+    done = rope_decode_sse2(src, bytes, dst, capacity, &written);
+    break;
+#endif
+  default:
+    break;
+  }
+  while (done < bytes && written < capacity) {
+    int units;
+    dst[written++] = rope_decode_char(src + done, bytes - done, &units);
+    done += units;
+  }
+  return written;
+}
+
+// returns the first position at which the needle occurs in the text, or -1
+static int rope_search(const RopeSearch *search, const ROPE_UNIT *text, int n)
+{
+  switch (n < ROPE_VECTOR_MIN ? ROPE_KERNELS_SCALAR : search->kernel) {
+#ifdef SDL_AVX2_INTRINSICS
+  case ROPE_KERNELS_AVX2:
+    return rope_search_avx2(search, text, n);
+#endif
+#ifdef SDL_SSE2_INTRINSICS
+  case ROPE_KERNELS_SSE2:
+    return rope_search_sse2(search, text, n);
+#endif
+  default:
+    return rope_search_scalar(search, text, n);
+  }
+}
+
+// returns the last position at which the needle occurs in the text, or -1
+static int rope_search_back(const RopeSearch *search, const ROPE_UNIT *text, int n)
+{
+  switch (n < ROPE_VECTOR_MIN ? ROPE_KERNELS_SCALAR : search->kernel) {
+#ifdef SDL_AVX2_INTRINSICS
+  case ROPE_KERNELS_AVX2:
+    return rope_search_back_avx2(search, text, n);
+#endif
+#ifdef SDL_SSE2_INTRINSICS
+  case ROPE_KERNELS_SSE2:
+    return rope_search_back_sse2(search, text, n);
+#endif
+  default:
+    return rope_search_back_scalar(search, text, n);
+  }
+}
+
+// prepares a search for a needle, allocating the window that holds the
+// len - 1 units on either side of a boundary between chunks
+static bool rope_search_init(RopeSearch *search, const uint32_t *needle, int len)
+{
+  if (len < 1) {
+    SDL_SetError("Needle is empty");
+    return false;
+  }
+#ifdef ROPE_UTF8
+  // leaves are searched as UTF-8 without being decoded, so the needle is
+  // encoded the same way into the end of the window
+  search->window = malloc(3 * 4 * (size_t)len);
+  if (search->window == NULL) {
+    SDL_SetError("Failed to allocate memory for search");
+    return false;
+  }
+  uint8_t *encoded = search->window + 2 * 4 * len;
+  len = rope_encode_utf8(needle, len, (char*)encoded);
+  search->needle = encoded;
+#else
+  search->window = NULL;
+  if (len > 1) {
+    search->window = malloc(2 * (len - 1) * sizeof(uint32_t));
+    if (search->window == NULL) {
+      SDL_SetError("Failed to allocate memory for search");
+      return false;
+    }
+  }
+  search->needle = needle;
+#endif
+  search->len = len;
+  search->kernel = rope_kernel(ROPE_VECTOR_MIN);
+  for (int i = 0; i < 256; i++) {
+    search->skip[i] = len;
+    search->skip_back[i] = len;
+  }
+  for (int i = 0; i < len - 1; i++) search->skip[search->needle[i] & 0xff] = len - 1 - i;
+  for (int i = len - 1; i > 0; i--) search->skip_back[search->needle[i] & 0xff] = i;
+  return true;
+}
+
+// starts an iterator at an index for a search, which reads the UTF-8 of
+// leaves without decoding it if ROPE_UTF8 is defined
+static bool rope_search_iter(RopeIter *iter, RopeNode *root, int index)
+{
+  if (!rope_iter_init(iter, root, index)) return false;
+#ifdef ROPE_UTF8
+  iter->decode = false;
+#endif
+  return true;
+}
+
+// returns the units of the chunk an iterator is at, storing how many there are
+static const ROPE_UNIT *rope_search_chunk(const RopeIter *iter, int *n)
+{
+#ifdef ROPE_UTF8
+  *n = iter->size;
+  return (const uint8_t*)iter->bytes;
+#else
+  *n = iter->len;
+  return iter->chunk;
+#endif
+}
+
+// returns the number of codepoints in some units of text
+static int rope_search_length(const ROPE_UNIT *text, int n)
+{
+#ifdef ROPE_UTF8
+  int length = 0;
+  for (int i = 0; i < n; i++) length += (text[i] & 0xc0) != 0x80;
+  return length;
+#else
+  (void)text;
+  return n;
+#endif
+}
+
+// finds the occurrences of the needle from where an iterator starts, in order.
+// If matches is NULL, this stops at the first one, and otherwise it appends
+// every one that does not overlap the one before it. Returns the index of the
+// first occurrence, or -1 if there is none.
+static int rope_search_forward(RopeSearch *search, RopeIter *iter, int **matches)
+{
+  int len = search->len;
+  int carry = 0;
+  int at = 0;
+  int next = 0;
+  int first = -1;
+  do {
+    int n;
+    const ROPE_UNIT *chunk = rope_search_chunk(iter, &n);
+
+    // search for occurrences that start before the chunk and end in it, using
+    // the end of the text before the chunk followed by its start
+    int head = n < len - 1 ? n : len - 1;
+    if (carry > 0 && head > 0) {
+      memcpy(search->window + carry, chunk, head * sizeof(ROPE_UNIT));
+      int size = carry + head < carry - 1 + len ? carry + head : carry - 1 + len;
+      for (int offset = next - (at - carry) > 0 ? next - (at - carry) : 0; offset < carry;) {
+        int found = rope_search(search, search->window + offset, size - offset);
+        if (found < 0) break;
+        offset += found;
+        int index = iter->start - rope_search_length(search->window + offset, carry - offset);
+        if (first < 0) first = index;
+        if (matches == NULL) return first;
+        arrput(*matches, index);
+        next = at - carry + offset + len;
+        offset += len;
+      }
+    }
+
+    // search for occurrences that start in the chunk, counting the codepoints
+    // before each one from the one before it unless there is a unit for each
+    bool counting = n != iter->len;
+    int counted = 0;
+    int index = iter->start;
+    for (int offset = next - at > 0 ? next - at : 0; offset + len <= n;) {
+      int found = rope_search(search, chunk + offset, n - offset);
+      if (found < 0) break;
+      offset += found;
+      index += counting ? rope_search_length(chunk + counted, offset - counted)
+                        : offset - counted;
+      counted = offset;
+      if (first < 0) first = index;
+      if (matches == NULL) return first;
+      arrput(*matches, index);
+      next = at + offset + len;
+      offset += len;
+    }
+
+    // keep the last len - 1 units of the text for the next chunk
+    at += n;
+    int keep = carry + n < len - 1 ? carry + n : len - 1;
+    if (keep == 0) {
+      continue;
+    } else if (n >= keep) {
+      memcpy(search->window, chunk + n - keep, keep * sizeof(ROPE_UNIT));
+    } else {
+      memmove(search->window, search->window + carry - (keep - n),
+              (keep - n) * sizeof(ROPE_UNIT));
+      memcpy(search->window + keep - n, chunk, n * sizeof(ROPE_UNIT));
+    }
+    carry = keep;
+  } while (rope_iter_next(iter));
+  return first;
+}
+
+int rope_find(RopeNode *root, const uint32_t *needle, int len, int from)
+{
+  RopeSearch search;
+  RopeIter iter;
+  if (!rope_search_iter(&iter, root, from)) return -2;
+  if (!rope_search_init(&search, needle, len)) return -2;
+  int found = rope_search_forward(&search, &iter, NULL);
+  free(search.window);
+  return found;
+}
+
+int rope_rfind(RopeNode *root, const uint32_t *needle, int len, int from)
+{
+  RopeSearch search;
+  RopeIter iter;
+  int length = rope_length(root);
+  if (from < 0 || from > length) {
+    SDL_SetError("Index is outside of the rope");
+    return -2;
+  }
+  if (!rope_search_init(&search, needle, len)) return -2;
+
+  // search the text before the end of the last occurrence that could start at
+  // the index, keeping the first units of the text after each chunk in the
+  // second half of the window
+  rope_search_iter(&iter, root, from > length - len ? length : from + len);
+  len = search.len;
+  ROPE_UNIT *after = len > 1 ? search.window + len - 1 : NULL;
+  int carry = 0;
+  int found = -1;
+  while (found < 0 && rope_iter_prev(&iter)) {
+    int n;
+    const ROPE_UNIT *chunk = rope_search_chunk(&iter, &n);
+
+    // search for occurrences that start in the chunk and end after it
+    int tail = n < len - 1 ? n : len - 1;
+    if (carry > 0 && tail > 0) {
+      memcpy(after - tail, chunk + n - tail, tail * sizeof(ROPE_UNIT));
+      int size = tail + carry < tail - 1 + len ? tail + carry : tail - 1 + len;
+      int offset = rope_search_back(&search, after - tail, size);
+      if (offset >= 0) found = iter.start + rope_search_length(chunk, n - tail + offset);
+    }
+
+    // search for occurrences within the chunk
+    if (found < 0) {
+      int offset = rope_search_back(&search, chunk, n);
+      if (offset >= 0) found = iter.start + rope_search_length(chunk, offset);
+    }
+
+    // keep the first len - 1 units of the text for the previous chunk
+    int keep = n + carry < len - 1 ? n + carry : len - 1;
+    if (keep == 0) continue;
+    if (n < keep) memmove(after + n, after, (keep - n) * sizeof(ROPE_UNIT));
+    memcpy(after, chunk, (n < keep ? n : keep) * sizeof(ROPE_UNIT));
+    carry = keep;
+  }
+  free(search.window);
+  return found;
+}
+
+int rope_find_all(RopeNode *root, const uint32_t *needle, int len, int **matches)
+{
+  RopeSearch search;
+  RopeIter iter;
+  rope_search_iter(&iter, root, 0);
+  if (!rope_search_init(&search, needle, len)) return -1;
+  int count = (int)arrlen(*matches);
+  rope_search_forward(&search, &iter, matches);
+  free(search.window);
+  return (int)arrlen(*matches) - count;
+}
+
+#ifdef ROPE_UTF8
+
+// returns the number of bytes at the start of some UTF-8 text that hold up to
+// LEAF_WEIGHT whole characters in at most four times as many bytes, storing
+// whether they are all valid
+static int rope_map_span(const uint8_t *src, size_t rest, bool *valid)
+{
+  int max = rest < 4 * LEAF_WEIGHT ? (int)rest : 4 * LEAF_WEIGHT;
+  int at = 0;
+  int count = 0;
+  *valid = true;
+  while (at < max && count < LEAF_WEIGHT) {
+    // skip over ASCII text a word at a time
+    if (at + 8 <= max && count + 8 <= LEAF_WEIGHT) {
+      uint64_t word;
+      memcpy(&word, src + at, sizeof(word));
+      if ((word & 0x8080808080808080ull) == 0) {
+        at += 8;
+        count += 8;
+        continue;
+      }
+    }
+    int units;
+    uint32_t c = rope_decode_char(src + at, rest - at < 4 ? (int)(rest - at) : 4, &units);
+    if (at + units > max) break;
+    if (c == 0xfffd && units == 1) *valid = false;
+    at += units;
+    count++;
+  }
+  return at;
+}
+
+// builds a rope out of leaves pointing into a mapped file
+static RopeNode *rope_map_leaves(const char *data, size_t size)
+{
+  RopeMap *map = malloc(sizeof(RopeMap));
+  RopeNode **leaves = malloc((size / LEAF_WEIGHT + 1) * sizeof(RopeNode*));
+  if (map == NULL || leaves == NULL) {
+    SDL_SetError("Failed to allocate memory in rope_map");
+    free(map);
+    free(leaves);
+    munmap((void*)data, size);
+    return NULL;
+  }
+  *map = (RopeMap){.data = data, .size = size, .ref_count = 1};
+
+  // cut the file into leaves of LEAF_WEIGHT characters, copying only the text
+  // that is not valid UTF-8, which is decoded into leaves of its own
+  madvise((void*)data, size, MADV_SEQUENTIAL);
+  int count = 0;
+  for (size_t at = 0; at < size;) {
+    bool valid;
+    const char *span = data + at;
+    int bytes = rope_map_span((const uint8_t*)span, size - at, &valid);
+    RopeNode *leaf;
+    if (valid) {
+      leaf = pool_alloc(sizeof(RopeNode));
+      if (leaf == NULL) {
+        SDL_SetError("Failed to allocate memory for leaf");
+      } else {
+        int weight;
+        RopeSummary summary = rope_summarize_utf8(span, bytes, &weight);
+        rope_set(leaf, weight, 1, NULL, NULL, NULL);
+        leaf->value = (ROPE_UNIT*)span;
+        leaf->summary = summary;
+#ifdef ROPE_INTERN
+        rope_rehash(leaf);
+#endif
+        leaf->map = map;
+        map->ref_count++;
+      }
+    } else {
+      uint32_t text[LEAF_WEIGHT];
+      leaf = rope_build(text, rope_decode_utf8(span, bytes, text, LEAF_WEIGHT));
+    }
+    if (leaf == NULL) {
+      rope_arr_free(leaves, count);
+      leaves = NULL;
+      break;
+    }
+    leaves[count++] = leaf;
+    at += bytes;
+  }
+
+  // drop the pages that were read from memory until they are read again
+  RopeNode *root = NULL;
+  if (leaves != NULL) root = count == 1 ? leaves[0] : rope_merge(leaves, count);
+  if (count == 1) free(leaves);
+  madvise((void*)data, size, MADV_DONTNEED);
+  madvise((void*)data, size, MADV_RANDOM);
+  if (--map->ref_count == 0) {
+    munmap((void*)data, size);
+    free(map);
+  }
+  return root;
+}
+
+#else
+
+// builds a rope out of the text of a mapped file, decoding it a chunk at a time
+static RopeNode *rope_map_decode(const char *data, size_t size)
+{
+  size_t chunk = size < ROPE_MAP_CHUNK ? size : ROPE_MAP_CHUNK;
+  uint32_t *text = malloc(chunk * sizeof(uint32_t));
+  RopeNode *root = text == NULL ? NULL : rope_build(NULL, 0);
+  if (text == NULL) SDL_SetError("Failed to allocate memory in rope_map");
+  madvise((void*)data, size, MADV_SEQUENTIAL);
+  for (size_t at = 0; root != NULL && at < size;) {
+    // end the chunk before any character that it would cut in two
+    size_t end = size - at > chunk ? at + chunk : size;
+    for (int i = 0; i < 3 && end < size && ((uint8_t)data[end] & 0xc0) == 0x80; i++) end--;
+    int length = rope_decode_utf8(data + at, (int)(end - at), text, (int)(end - at));
+    RopeNode *part = rope_build(text, length);
+    RopeNode *joined = part == NULL ? NULL : rope_concat(root, part);
+    rope_deref(root);
+    rope_deref(part);
+    root = joined;
+    at = end;
+  }
+  free(text);
+  munmap((void*)data, size);
+  return root;
+}
+
+#endif // ROPE_UTF8
+
+RopeNode *rope_map(const char *path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    SDL_SetError("Failed to open %s: %s", path, strerror(errno));
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    SDL_SetError("Failed to read %s: %s", path, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  if (st.st_size > INT_MAX) {
+    SDL_SetError("File is too large to be held in a rope");
+    close(fd);
+    return NULL;
+  }
+
+  // an empty file cannot be mapped, and is the empty rope
+  size_t size = (size_t)st.st_size;
+  if (size == 0) {
+    close(fd);
+    return rope_build(NULL, 0);
+  }
+  void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    SDL_SetError("Failed to map %s: %s", path, strerror(errno));
+    return NULL;
+  }
+#ifdef ROPE_UTF8
+  return rope_map_leaves(data, size);
+#else
+  return rope_map_decode(data, size);
+#endif
+}
@@ -0,0 +1,103 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <SDL3/SDL_error.h>
+
+#include "rope.h"
+#include "storage.h"
+
+Storage *storage_init(StorageType type, RopeNode *root)
+{
+  if (root == NULL) {
+    SDL_SetError("Rope does not exist");
+    return NULL;
+  }
+  switch (type) {
+  case STORAGE_ROPE:
+    return storage_rope(root);
+  case STORAGE_GAP:
+    return storage_gap(root);
+  }
+  SDL_SetError("Unknown kind of storage");
+  return NULL;
+}
+
+void storage_free(Storage *storage)
+{
+  if (storage == NULL) return;
+  storage->ops->free(storage);
+}
+
+bool storage_insert(Storage *storage, uint32_t *text, int len, int pos)
+{
+  if (pos < 0 || pos > storage->length || len < 0) {
+    SDL_SetError("Index is outside of the text");
+    return false;
+  }
+  if (len == 0) return true;
+  return storage->ops->insert(storage, text, len, pos);
+}
+
+bool storage_delete(Storage *storage, int pos, int len)
+{
+  if (pos < 0 || len < 0 || len > storage->length - pos) {
+    SDL_SetError("Range is outside of the text");
+    return false;
+  }
+  if (len == 0) return true;
+  return storage->ops->delete(storage, pos, len);
+}
+
+uint32_t storage_index(Storage *storage, int pos)
+{
+  if (pos < 0 || pos >= storage->length) {
+    SDL_SetError("Index is outside of the text");
+    return 0;
+  }
+  return storage->ops->index(storage, pos);
+}
+
+bool storage_iter_init(StorageIter *iter, Storage *storage, int pos)
+{
+  if (pos < 0 || pos >= storage->length) {
+    SDL_SetError("Index is outside of the text");
+    return false;
+  }
+  iter->storage = storage;
+  storage->ops->iter_init(iter, storage, pos);
+  return true;
+}
+
+bool storage_iter_next(StorageIter *iter)
+{
+  return iter->storage->ops->iter_next(iter);
+}
+
+bool storage_copy_out(Storage *storage, int start, int len, uint32_t *dst)
+{
+  if (start < 0 || len < 0 || len > storage->length - start) {
+    SDL_SetError("Range is outside of the text");
+    return false;
+  }
+  if (len == 0) return true;
+  return storage->ops->copy_out(storage, start, len, dst);
+}
+
+int storage_line_start(Storage *storage, int line)
+{
+  if (line < 0 || line > storage->newlines) {
+    SDL_SetError("Line is outside of the text");
+    return -1;
+  }
+  return storage->ops->line_start(storage, line);
+}
+
+RopeNode *storage_snapshot(Storage *storage)
+{
+  return storage->ops->snapshot(storage);
+}
+
+long storage_bytes(Storage *storage)
+{
+  return storage->ops->bytes(storage);
+}
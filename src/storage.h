@@ -0,0 +1,250 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rope.h"
+
+struct Storage;
+
+typedef enum {
+  STORAGE_ROPE,
+  STORAGE_GAP,
+} StorageType;
+
+/**
+ * struct StorageIter - Iterates over the text of a storage one chunk at a time.
+ *
+ * @chunk: The codepoints of the current chunk.
+ * @len: The number of codepoints in the current chunk.
+ * @start: The index of the first character of the chunk within the text.
+ * @storage: The storage being iterated over.
+ * @rope: The iterator over the rope, if the storage is a rope.
+ *
+ * This struct is meant to be declared on the stack and filled in with
+ * storage_iter_init(), in the same way as a RopeIter. The chunks of a rope are
+ * the chunks of its leaves, and a gap buffer has at most two chunks, the text
+ * before the gap and the text after it. The storage must not be edited while
+ * it is being iterated over.
+ */
+typedef struct StorageIter {
+  const uint32_t *chunk;
+  int len;
+  int start;
+  struct Storage *storage;
+  RopeIter rope;
+} StorageIter;
+
+/**
+ * struct StorageOps - Holds the functions implementing a kind of storage.
+ *
+ * Each kind of storage fills in one of these with its own functions, which
+ * are called through the storage functions below with the same arguments. The
+ * arguments are checked before they are passed on.
+ */
+typedef struct StorageOps {
+  bool (*insert)(struct Storage *storage, uint32_t *text, int len, int pos);
+  bool (*delete)(struct Storage *storage, int pos, int len);
+  uint32_t (*index)(struct Storage *storage, int pos);
+  void (*iter_init)(StorageIter *iter, struct Storage *storage, int pos);
+  bool (*iter_next)(StorageIter *iter);
+  bool (*copy_out)(struct Storage *storage, int start, int len, uint32_t *dst);
+  int (*line_start)(struct Storage *storage, int line);
+  RopeNode *(*snapshot)(struct Storage *storage);
+  long (*bytes)(struct Storage *storage);
+  void (*free)(struct Storage *storage);
+} StorageOps;
+
+/**
+ * struct Storage - Holds the text of a document being edited.
+ *
+ * @ops: The functions implementing the kind of storage.
+ * @type: The kind of storage.
+ * @length: The number of characters in the text.
+ * @newlines: The number of newlines in the text.
+ *
+ * This struct is the part shared by every kind of storage, which each keep
+ * their own state after it. The rope is persistent, so every edit costs
+ * O(log n) and a snapshot is free, which suits large files. The gap buffer
+ * keeps the text in one array with a gap at the last edit, so edits next to
+ * each other only move the characters between them, which suits small files
+ * edited in one place at a time. A storage is made with storage_init() and
+ * edited only through the storage functions.
+ */
+typedef struct Storage {
+  const StorageOps *ops;
+  StorageType type;
+  int length;
+  int newlines;
+} Storage;
+
+/**
+ * storage_init() - Creates a storage holding the text of a rope.
+ *
+ * @type: The kind of storage to create.
+ * @root: The root node of the rope holding the starting text.
+ *
+ * This function creates a storage of the given kind holding the text of the
+ * rope. The rope is not modified, and the caller keeps its reference to it.
+ * This function returns NULL if it fails. For error information, use
+ * SDL_GetError().
+ */
+Storage *storage_init(StorageType type, RopeNode *root);
+
+/**
+ * storage_rope() - Creates a storage that keeps its text in a rope.
+ *
+ * @root: The root node of the rope holding the starting text.
+ *
+ * This function creates a storage that shares the rope, and edits it with
+ * the rope functions. Single characters are inserted and deleted through a
+ * RopeFinger, so a run of typing at a cursor edits the newest leaf in place
+ * until a snapshot shares it. This function returns NULL if it fails. For
+ * error information, use SDL_GetError().
+ */
+Storage *storage_rope(RopeNode *root);
+
+/**
+ * storage_gap() - Creates a storage that keeps its text in a gap buffer.
+ *
+ * @root: The root node of the rope holding the starting text.
+ *
+ * This function creates a storage that copies the text of the rope into one
+ * array, with a gap at the end of it, and keeps an array of the index of each
+ * newline. Edits move the gap to where they are made and then fill or widen
+ * it, so their cost is the distance from the last edit, however long the
+ * text is. The rope is kept as the last snapshot.
+ * This function returns NULL if it fails. For error information, use
+ * SDL_GetError().
+ */
+Storage *storage_gap(RopeNode *root);
+
+/**
+ * storage_free() - Frees a storage.
+ *
+ * @storage: The storage to free.
+ *
+ * This function frees the storage along with its text. Snapshots taken from
+ * it keep their own references and stay valid. If NULL is passed, nothing
+ * will happen.
+ */
+void storage_free(Storage *storage);
+
+/**
+ * storage_insert() - Inserts text into a storage.
+ *
+ * @storage: The storage to edit.
+ * @text: The array of unicode codepoints to insert.
+ * @len: The length of the array.
+ * @pos: The index the first character will have, from 0 up to the length of
+ * the text.
+ *
+ * This function inserts the text before the character at the given index,
+ * or at the end of the text if the index is its length. It returns true on
+ * success and false on failure. For error information, use SDL_GetError().
+ */
+bool storage_insert(Storage *storage, uint32_t *text, int len, int pos);
+
+/**
+ * storage_delete() - Deletes a range of text from a storage.
+ *
+ * @storage: The storage to edit.
+ * @pos: The index of the first character to delete.
+ * @len: The number of characters to delete.
+ *
+ * This function deletes the given range of text. It returns true on success
+ * and false on failure, or if the range is not within the text. For error
+ * information, use SDL_GetError().
+ */
+bool storage_delete(Storage *storage, int pos, int len);
+
+/**
+ * storage_index() - Gets a character from a storage.
+ *
+ * @storage: The storage to read.
+ * @pos: The index of the character.
+ *
+ * This function returns the unicode codepoint of the character at the given
+ * index, or 0 if the index is outside of the text. For error information, use
+ * SDL_GetError().
+ */
+uint32_t storage_index(Storage *storage, int pos);
+
+/**
+ * storage_iter_init() - Starts iterating over a storage.
+ *
+ * @iter: The iterator to fill in.
+ * @storage: The storage to iterate over.
+ * @pos: The index of the character to start from.
+ *
+ * This function fills in the iterator so that its first chunk starts with
+ * the character at the given index. It returns false if the index is outside
+ * of the text. For error information, use SDL_GetError().
+ */
+bool storage_iter_init(StorageIter *iter, Storage *storage, int pos);
+
+/**
+ * storage_iter_next() - Moves an iterator to the next chunk.
+ *
+ * @iter: The iterator to move.
+ *
+ * This function moves the iterator to the chunk after the current one. It
+ * returns false once there are no more chunks, leaving the iterator as it is.
+ */
+bool storage_iter_next(StorageIter *iter);
+
+/**
+ * storage_copy_out() - Copies a range of text out of a storage.
+ *
+ * @storage: The storage to read.
+ * @start: The index of the first character to copy.
+ * @len: The number of characters to copy.
+ * @dst: The array to copy into, which must hold at least len codepoints.
+ *
+ * This function copies the given range of text into the array. It returns
+ * true on success and false if the range is not within the text. For error
+ * information, use SDL_GetError().
+ */
+bool storage_copy_out(Storage *storage, int start, int len, uint32_t *dst);
+
+/**
+ * storage_line_start() - Finds the index of the start of a line.
+ *
+ * @storage: The storage to read.
+ * @line: The line to find (zero-indexed).
+ *
+ * This function returns the index of the first character of the line, in
+ * the same way as rope_line_start(). It returns -1 if the line is not in the
+ * text. For error information, use SDL_GetError().
+ */
+int storage_line_start(Storage *storage, int line);
+
+/**
+ * storage_snapshot() - Takes a snapshot of the text of a storage.
+ *
+ * @storage: The storage to snapshot.
+ *
+ * This function returns a rope holding the current text, which later edits
+ * to the storage do not change. The caller owns a reference to the rope and
+ * releases it with rope_deref(). A rope storage returns its own rope. A gap
+ * buffer builds only the range it changed since its last snapshot, and puts
+ * it in place of that range in the last snapshot with rope_replace(), so
+ * snapshots share the rest of their text. This function returns NULL if it
+ * fails. For error information, use SDL_GetError().
+ */
+RopeNode *storage_snapshot(Storage *storage);
+
+/**
+ * storage_bytes() - Measures the memory held by a storage.
+ *
+ * @storage: The storage to measure.
+ *
+ * This function returns the number of bytes the storage holds outside of the
+ * nodes of ropes, which pool_stats() counts instead. For a rope storage, this
+ * is only the storage itself, and for a gap buffer it also counts the array,
+ * gap included, and the array of newlines.
+ */
+long storage_bytes(Storage *storage);
+
+#endif // STORAGE_H
@@ -0,0 +1,284 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL3/SDL_error.h>
+
+#include "rope.h"
+#include "stb_ds.h"
+#include "storage.h"
+
+// Determines the size of the gap left after the text whenever it has to grow.
+#define STORAGE_GAP_MIN 256
+
+/**
+ * struct GapStorage - Holds the text of a storage in a gap buffer.
+ *
+ * @base: The part shared by every kind of storage.
+ * @text: The array holding the text, with the gap in the middle of it.
+ * @capacity: The number of codepoints the array can hold, gap included.
+ * @gap_start: The index in the array of the first codepoint of the gap.
+ * @gap_end: The index in the array of the first codepoint after the gap.
+ * @breaks: A dynamic array of the index of each newline within the text,
+ * where newlines after the gap are counted back from the end of the text, so
+ * that edits at the gap do not have to shift them.
+ * @gap_break: The number of newlines before the gap.
+ * @last: The root node of the rope of the last snapshot.
+ * @last_length: The length of the text at the last snapshot.
+ * @head: The number of characters at the start of the text that are the same
+ * as in the last snapshot.
+ * @tail: The number of characters at the end of the text that are the same
+ * as in the last snapshot.
+ */
+typedef struct GapStorage {
+  Storage base;
+  uint32_t *text;
+  int capacity;
+  int gap_start;
+  int gap_end;
+  int *breaks;
+  int gap_break;
+  RopeNode *last;
+  int last_length;
+  int head;
+  int tail;
+} GapStorage;
+
+// moves the gap so that it starts at the given index in the text, along with
+// the newlines it moves over
+static void storage_gap_move(GapStorage *gs, int pos)
+{
+  int length = gs->base.length;
+  if (pos < gs->gap_start) {
+    int n = gs->gap_start - pos;
+    memmove(gs->text + gs->gap_end - n, gs->text + pos, n * sizeof(uint32_t));
+    gs->gap_start -= n;
+    gs->gap_end -= n;
+    while (gs->gap_break > 0 && gs->breaks[gs->gap_break - 1] >= pos) {
+      gs->breaks[--gs->gap_break] -= length;
+    }
+  } else if (pos > gs->gap_start) {
+    int n = pos - gs->gap_start;
+    memmove(gs->text + gs->gap_start, gs->text + gs->gap_end, n * sizeof(uint32_t));
+    gs->gap_start += n;
+    gs->gap_end += n;
+    while (gs->gap_break < arrlen(gs->breaks) && gs->breaks[gs->gap_break] + length < pos) {
+      gs->breaks[gs->gap_break++] += length;
+    }
+  }
+}
+
+// grows the array until the gap holds at least the given number of codepoints,
+// at least doubling it so that typing takes amortized constant time
+static bool storage_gap_reserve(GapStorage *gs, int len)
+{
+  if (gs->gap_end - gs->gap_start >= len) return true;
+  int capacity = gs->base.length + len + STORAGE_GAP_MIN;
+  if (capacity < 2 * gs->capacity) capacity = 2 * gs->capacity;
+  uint32_t *text = realloc(gs->text, capacity * sizeof(uint32_t));
+  if (text == NULL) {
+    SDL_SetError("Failed to allocate memory for gap buffer");
+    return false;
+  }
+  int after = gs->capacity - gs->gap_end;
+  memmove(text + capacity - after, text + gs->gap_end, after * sizeof(uint32_t));
+  gs->text = text;
+  gs->gap_end = capacity - after;
+  gs->capacity = capacity;
+  return true;
+}
+
+static bool storage_gap_insert(Storage *storage, uint32_t *text, int len, int pos)
+{
+  GapStorage *gs = (GapStorage*)storage;
+  if (!storage_gap_reserve(gs, len)) return false;
+  storage_gap_move(gs, pos);
+  memcpy(gs->text + gs->gap_start, text, len * sizeof(uint32_t));
+  gs->gap_start += len;
+
+  // add the newlines of the text before the gap
+  int count = 0;
+  for (int i = 0; i < len; i++) count += text[i] == '\n';
+  if (count > 0) {
+    arrinsn(gs->breaks, gs->gap_break, count);
+    for (int i = 0; i < len; i++) {
+      if (text[i] == '\n') gs->breaks[gs->gap_break++] = pos + i;
+    }
+  }
+
+  // the text before and after the insert is unchanged
+  if (gs->head > pos) gs->head = pos;
+  if (gs->tail > storage->length - pos) gs->tail = storage->length - pos;
+  storage->length += len;
+  storage->newlines += count;
+  return true;
+}
+
+static bool storage_gap_delete(Storage *storage, int pos, int len)
+{
+  GapStorage *gs = (GapStorage*)storage;
+  storage_gap_move(gs, pos);
+  gs->gap_end += len;
+
+  // drop the newlines within the range, which are the first ones after the gap
+  int count = 0;
+  while (gs->gap_break + count < arrlen(gs->breaks) &&
+         gs->breaks[gs->gap_break + count] + storage->length < pos + len) {
+    count++;
+  }
+  if (count > 0) arrdeln(gs->breaks, gs->gap_break, count);
+
+  if (gs->head > pos) gs->head = pos;
+  if (gs->tail > storage->length - pos - len) gs->tail = storage->length - pos - len;
+  storage->length -= len;
+  storage->newlines -= count;
+  return true;
+}
+
+static uint32_t storage_gap_index(Storage *storage, int pos)
+{
+  GapStorage *gs = (GapStorage*)storage;
+  return gs->text[pos < gs->gap_start ? pos : pos + gs->gap_end - gs->gap_start];
+}
+
+static void storage_gap_iter_init(StorageIter *iter, Storage *storage, int pos)
+{
+  GapStorage *gs = (GapStorage*)storage;
+  iter->start = pos;
+  if (pos < gs->gap_start) {
+    iter->chunk = gs->text + pos;
+    iter->len = gs->gap_start - pos;
+  } else {
+    iter->chunk = gs->text + pos + gs->gap_end - gs->gap_start;
+    iter->len = storage->length - pos;
+  }
+}
+
+static bool storage_gap_iter_next(StorageIter *iter)
+{
+  // the only chunk that can follow another is the text after the gap
+  GapStorage *gs = (GapStorage*)iter->storage;
+  if (iter->start >= gs->gap_start || gs->gap_start == gs->base.length) return false;
+  iter->chunk = gs->text + gs->gap_end;
+  iter->len = gs->base.length - gs->gap_start;
+  iter->start = gs->gap_start;
+  return true;
+}
+
+static bool storage_gap_copy_out(Storage *storage, int start, int len, uint32_t *dst)
+{
+  GapStorage *gs = (GapStorage*)storage;
+  int before = gs->gap_start - start;
+  if (before > len) before = len;
+  if (before > 0) {
+    memcpy(dst, gs->text + start, before * sizeof(uint32_t));
+  } else {
+    before = 0;
+  }
+  int from = start + before + gs->gap_end - gs->gap_start;
+  memcpy(dst + before, gs->text + from, (len - before) * sizeof(uint32_t));
+  return true;
+}
+
+static int storage_gap_line_start(Storage *storage, int line)
+{
+  GapStorage *gs = (GapStorage*)storage;
+  if (line == 0) return 0;
+  if (line > gs->gap_break) return gs->breaks[line - 1] + storage->length + 1;
+  return gs->breaks[line - 1] + 1;
+}
+
+static RopeNode *storage_gap_snapshot(Storage *storage)
+{
+  // share the last snapshot if nothing has changed since it was taken
+  GapStorage *gs = (GapStorage*)storage;
+  int old_len = gs->last_length - gs->head - gs->tail;
+  int new_len = storage->length - gs->head - gs->tail;
+  if (old_len < 0 || (old_len == 0 && new_len == 0)) {
+    rope_ref(gs->last);
+    return gs->last;
+  }
+
+  // otherwise build the changed range, after moving the gap out of it, and
+  // put it in place of the range it replaces in the last snapshot
+  storage_gap_move(gs, gs->head + new_len);
+  RopeNode *piece = rope_build(gs->text + gs->head, new_len);
+  if (piece == NULL) return NULL;
+  RopeNode *root = rope_replace(gs->last, gs->head, old_len, piece);
+  rope_deref(piece);
+  if (root == NULL) return NULL;
+  rope_deref(gs->last);
+  gs->last = root;
+  gs->last_length = storage->length;
+  gs->head = storage->length;
+  gs->tail = storage->length;
+  rope_ref(root);
+  return root;
+}
+
+static long storage_gap_bytes(Storage *storage)
+{
+  GapStorage *gs = (GapStorage*)storage;
+  return sizeof(GapStorage) + (long)gs->capacity * sizeof(uint32_t) +
+         (long)arrcap(gs->breaks) * sizeof(int);
+}
+
+static void storage_gap_free(Storage *storage)
+{
+  GapStorage *gs = (GapStorage*)storage;
+  free(gs->text);
+  arrfree(gs->breaks);
+  rope_deref(gs->last);
+  free(gs);
+}
+
+static const StorageOps storage_gap_ops = {
+  .insert = storage_gap_insert,
+  .delete = storage_gap_delete,
+  .index = storage_gap_index,
+  .iter_init = storage_gap_iter_init,
+  .iter_next = storage_gap_iter_next,
+  .copy_out = storage_gap_copy_out,
+  .line_start = storage_gap_line_start,
+  .snapshot = storage_gap_snapshot,
+  .bytes = storage_gap_bytes,
+  .free = storage_gap_free,
+};
+
+Storage *storage_gap(RopeNode *root)
+{
+  GapStorage *gs = malloc(sizeof(GapStorage));
+  int length = rope_length(root);
+  uint32_t *text = malloc((length + STORAGE_GAP_MIN) * sizeof(uint32_t));
+  if (gs == NULL || text == NULL) {
+    SDL_SetError("Failed to allocate memory for gap buffer");
+    free(gs);
+    free(text);
+    return NULL;
+  }
+  *gs = (GapStorage){
+    .base = {.ops = &storage_gap_ops, .type = STORAGE_GAP, .length = length},
+    .text = text,
+    .capacity = length + STORAGE_GAP_MIN,
+    .gap_start = length,
+    .gap_end = length + STORAGE_GAP_MIN,
+    .last = root,
+    .last_length = length,
+    .head = length,
+    .tail = length,
+  };
+  rope_ref(root);
+
+  // copy the text in before the gap, and find its newlines
+  if (length > 0 && !rope_copy_out(root, 0, length, text)) {
+    storage_gap_free(&gs->base);
+    return NULL;
+  }
+  for (int i = 0; i < length; i++) {
+    if (text[i] == '\n') arrput(gs->breaks, i);
+  }
+  gs->base.newlines = arrlen(gs->breaks);
+  gs->gap_break = arrlen(gs->breaks);
+  return &gs->base;
+}
@@ -0,0 +1,149 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <SDL3/SDL_error.h>
+
+#include "rope.h"
+#include "storage.h"
+
+/**
+ * struct RopeStorage - Holds the text of a storage in a rope.
+ *
+ * @base: The part shared by every kind of storage.
+ * @root: The root node of the rope, which the storage holds a reference to.
+ * @finger: The finger used to insert and delete single characters.
+ */
+typedef struct RopeStorage {
+  Storage base;
+  RopeNode *root;
+  RopeFinger finger;
+} RopeStorage;
+
+// replaces the rope with a new version of it, and updates the length and
+// newlines from it
+static void storage_rope_set(RopeStorage *rs, RopeNode *root)
+{
+  rope_deref(rs->root);
+  rs->root = root;
+  rs->base.length = rope_length(root);
+  rs->base.newlines = rope_newlines(root);
+}
+
+// returns the rope of the storage, after finishing any edits made through the
+// finger so that it can be passed to any rope function
+static RopeNode *storage_rope_root(Storage *storage)
+{
+  RopeStorage *rs = (RopeStorage*)storage;
+  rope_finger_flush(&rs->finger);
+  return rs->root;
+}
+
+static bool storage_rope_insert(Storage *storage, uint32_t *text, int len, int pos)
+{
+  RopeStorage *rs = (RopeStorage*)storage;
+  RopeNode *root;
+  if (len == 1) {
+    root = rope_finger_insert(&rs->finger, rs->root, text[0], pos - 1);
+  } else {
+    root = rope_insert_text(storage_rope_root(storage), text, len, pos - 1);
+  }
+  if (root == NULL) return false;
+  storage_rope_set(rs, root);
+  return true;
+}
+
+static bool storage_rope_delete(Storage *storage, int pos, int len)
+{
+  RopeStorage *rs = (RopeStorage*)storage;
+  RopeNode *root;
+  if (len == 1) {
+    root = rope_finger_delete(&rs->finger, rs->root, pos);
+  } else {
+    root = rope_delete_range(storage_rope_root(storage), pos, len);
+  }
+  if (root == NULL) return false;
+  storage_rope_set(rs, root);
+  return true;
+}
+
+static uint32_t storage_rope_index(Storage *storage, int pos)
+{
+  return rope_index(storage_rope_root(storage), pos).c;
+}
+
+static void storage_rope_iter_init(StorageIter *iter, Storage *storage, int pos)
+{
+  rope_iter_init(&iter->rope, storage_rope_root(storage), pos);
+  iter->chunk = iter->rope.chunk;
+  iter->len = iter->rope.len;
+  iter->start = iter->rope.start;
+}
+
+static bool storage_rope_iter_next(StorageIter *iter)
+{
+  if (!rope_iter_next(&iter->rope)) return false;
+  iter->chunk = iter->rope.chunk;
+  iter->len = iter->rope.len;
+  iter->start = iter->rope.start;
+  return true;
+}
+
+static bool storage_rope_copy_out(Storage *storage, int start, int len, uint32_t *dst)
+{
+  return rope_copy_out(storage_rope_root(storage), start, len, dst);
+}
+
+static int storage_rope_line_start(Storage *storage, int line)
+{
+  return rope_line_start(storage_rope_root(storage), line);
+}
+
+static RopeNode *storage_rope_snapshot(Storage *storage)
+{
+  // the rope is persistent, so sharing it is enough. The next edit copies the
+  // path it changes instead of editing the shared nodes in place.
+  RopeNode *root = storage_rope_root(storage);
+  rope_ref(root);
+  return root;
+}
+
+static long storage_rope_bytes(Storage *storage)
+{
+  (void)storage;
+  return sizeof(RopeStorage);
+}
+
+static void storage_rope_free(Storage *storage)
+{
+  rope_deref(storage_rope_root(storage));
+  free(storage);
+}
+
+static const StorageOps storage_rope_ops = {
+  .insert = storage_rope_insert,
+  .delete = storage_rope_delete,
+  .index = storage_rope_index,
+  .iter_init = storage_rope_iter_init,
+  .iter_next = storage_rope_iter_next,
+  .copy_out = storage_rope_copy_out,
+  .line_start = storage_rope_line_start,
+  .snapshot = storage_rope_snapshot,
+  .bytes = storage_rope_bytes,
+  .free = storage_rope_free,
+};
+
+Storage *storage_rope(RopeNode *root)
+{
+  RopeStorage *rs = malloc(sizeof(RopeStorage));
+  if (rs == NULL) {
+    SDL_SetError("Failed to allocate memory for storage");
+    return NULL;
+  }
+  rope_ref(root);
+  rs->base = (Storage){.ops = &storage_rope_ops, .type = STORAGE_ROPE};
+  rs->root = NULL;
+  rs->finger = (RopeFinger){0};
+  storage_rope_set(rs, root);
+  return &rs->base;
+}